@@ -0,0 +1,87 @@
+# Runs the kernels in this directory through the compilers and the offline
+# interpreters and prints a table of dynamic counts, one row per kernel and
+# mode, for tracking the quality of the generated code over time.
+#
+#   ir-raw  gen_ir -fno-optimize, run with run_ir
+#   ir      gen_ir, run with run_ir
+#   mips    gen_oc, run with run_mips
+#
+# Every kernel reads <kernel>.in and must print <kernel>.out in all modes.
+# Options given as -f<name> are passed on to gen_ir and gen_oc.
+import sys
+import os
+import re
+import json
+import argparse
+import subprocess
+import tempfile
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+COLUMNS = ['kernel', 'mode', 'instructions', 'loads', 'stores', 'calls', 'cycles']
+STAT = re.compile(r'(instructions|loads|stores|calls|cycles): (\d+)')
+
+def run(cmd, stdin=None):
+    p = subprocess.run(cmd, stdin=stdin, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    return p.returncode, p.stdout.decode('utf-8'), p.stderr.decode('utf-8')
+
+def measure(bin_dir, kernel, mode, flags, tmp):
+    src = os.path.join(BENCH_DIR, kernel + '.c')
+    if mode == 'mips':
+        out = os.path.join(tmp, kernel + '.s')
+        compile_cmd = [os.path.join(bin_dir, 'gen_oc')] + flags + [src, out]
+        run_cmd = [os.path.join(bin_dir, 'run_mips'), '-n', out]
+    else:
+        out = os.path.join(tmp, kernel + '.ir')
+        extra = ['-fno-optimize'] if mode == 'ir-raw' else []
+        compile_cmd = [os.path.join(bin_dir, 'gen_ir')] + flags + extra + [src, out]
+        run_cmd = [os.path.join(bin_dir, 'run_ir'), out]
+    code, stdout, stderr = run(compile_cmd)
+    if code != 0 or stdout.startswith('Error'):
+        return None, 'compile failed: ' + (stderr or stdout).strip()
+    with open(os.path.join(BENCH_DIR, kernel + '.in')) as fin:
+        code, stdout, stderr = run(run_cmd, stdin=fin)
+    if code != 0:
+        return None, stderr.strip()
+    with open(os.path.join(BENCH_DIR, kernel + '.out')) as f:
+        if stdout != f.read():
+            return None, 'wrong output'
+    row = {'kernel': kernel, 'mode': mode}
+    for name, value in STAT.findall(stderr):
+        row.setdefault(name, int(value))
+    return row, None
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Measure the generated code of the bench kernels.')
+    parser.add_argument('-b', '--bin', default='out', help='directory of gen_ir, gen_oc, run_ir and run_mips')
+    parser.add_argument('-o', '--output', help='write the table to this file instead of stdout')
+    parser.add_argument('--json', action='store_true', help='one JSON object per row instead of tab-separated columns')
+    parser.add_argument('kernels', nargs='*', help='kernels to run (default: all)')
+    args, flags = parser.parse_known_args()
+    bad = [f for f in flags if not f.startswith('-f')]
+    if bad:
+        parser.error('unrecognized arguments: ' + ' '.join(bad))
+
+    kernels = args.kernels or sorted(f[:-2] for f in os.listdir(BENCH_DIR) if f.endswith('.c'))
+    rows = []
+    ret_val = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for kernel in kernels:
+            for mode in ['ir-raw', 'ir', 'mips']:
+                row, error = measure(args.bin, kernel, mode, flags, tmp)
+                if row is None:
+                    print('Fail: {} ({}): {}'.format(kernel, mode, error), file=sys.stderr)
+                    ret_val = 1
+                else:
+                    rows.append(row)
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.json:
+        for row in rows:
+            out.write(json.dumps({c: row.get(c) for c in COLUMNS}) + '\n')
+    else:
+        out.write('\t'.join(COLUMNS) + '\n')
+        for row in rows:
+            out.write('\t'.join('-' if row.get(c) is None else str(row[c]) for c in COLUMNS) + '\n')
+    if out is not sys.stdout:
+        out.close()
+    sys.exit(ret_val)
@@ -0,0 +1,12 @@
+// recursive fibonacci
+int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+    int count;
+    count = read();
+    write(fib(count));
+    return 0;
+}
@@ -0,0 +1,202 @@
+# Deterministic generator of large, valid C-- programs for measuring how
+# the compiler scales with the size of its input. The same options and
+# seed always give the same program.
+#
+# The program has --structs struct types and --functions functions of
+# --statements statements each (plus declarations), with if/while nested
+# up to --depth levels, --arrays local arrays per function, calls to
+# earlier functions and a main that calls all of them. Every name is
+# unique in the whole program, so it is accepted with and without nested
+# scopes. Loops are bounded and there is no recursion, but the programs
+# are meant to be compiled, not run. --no-io leaves out the write calls,
+# which semantic_check does not declare.
+#
+# usage: gen_program.py [options] [output-file]
+import sys
+import random
+import argparse
+
+ARRAY_SIZE = 16
+LOOP_BOUND = 4
+
+class Function:
+    def __init__(self, index, args, rand):
+        self.name = 'f%d' % index
+        self.params = ['%s_p%d' % (self.name, i) for i in range(rand.randint(1, 3))]
+        self.ints = ['%s_v%d' % (self.name, i) for i in range(args.locals)] + self.params
+        self.counters = []
+        self.arrays = ['%s_a%d' % (self.name, i) for i in range(args.arrays)]
+        self.structs = []
+        if args.structs > 0:
+            self.structs = [('%s_s%d' % (self.name, i), rand.randrange(args.structs)) for i in range(2)]
+
+class Generator:
+    def __init__(self, args):
+        self.args = args
+        self.rand = random.Random(args.seed)
+        self.lines = []
+        self.funcs = []
+        self.func = None
+
+    def emit(self, line, indent):
+        self.lines.append('    ' * indent + line)
+
+    def atom(self):
+        r = self.rand.random()
+        f = self.func
+        if r < 0.25:
+            return str(self.rand.randrange(100))
+        if r < 0.6:
+            return self.rand.choice(f.ints + f.counters)
+        if r < 0.8 and f.arrays:
+            return '%s[%s]' % (self.rand.choice(f.arrays), self.index())
+        if f.structs:
+            return self.field()
+        return self.rand.choice(f.ints)
+
+    def index(self):
+        if self.func.counters and self.rand.random() < 0.5:
+            return self.rand.choice(self.func.counters)
+        return str(self.rand.randrange(ARRAY_SIZE))
+
+    def field(self):
+        name, _ = self.rand.choice(self.func.structs)
+        if self.rand.random() < 0.5:
+            return '%s.x' % name
+        return '%s.v[%d]' % (name, self.rand.randrange(4))
+
+    def expr(self, depth=0):
+        r = self.rand.random()
+        if depth >= 2 or r < 0.3:
+            return self.atom()
+        a, b = self.expr(depth + 1), self.expr(depth + 1)
+        if r < 0.55:
+            return '%s + %s' % (a, b)
+        if r < 0.7:
+            return '%s - %s' % (a, b)
+        if r < 0.85:
+            return '(%s) * %d' % (a, self.rand.randrange(1, 10))
+        return '(%s) / %d' % (a, self.rand.randrange(1, 10))
+
+    def cond(self):
+        op = self.rand.choice(['<', '<=', '>', '>=', '==', '!='])
+        c = '%s %s %s' % (self.atom(), op, self.atom())
+        if self.rand.random() < 0.2:
+            c = '%s && %s %s %s' % (c, self.atom(), op, self.atom())
+        return c
+
+    def lvalue(self):
+        r = self.rand.random()
+        f = self.func
+        if r < 0.6 or not (f.arrays or f.structs):
+            return self.rand.choice(f.ints)
+        if r < 0.8 and f.arrays:
+            return '%s[%s]' % (self.rand.choice(f.arrays), self.index())
+        if f.structs:
+            return self.field()
+        return self.rand.choice(f.ints)
+
+    # emit about budget statements and return how many were emitted
+    def block(self, budget, indent, depth):
+        count = 0
+        while count < budget:
+            r = self.rand.random()
+            if depth < self.args.depth and budget - count >= 4 and r < 0.15:
+                inner = self.rand.randint(1, min(budget - count - 2, 8))
+                self.emit('if (%s) {' % self.cond(), indent)
+                count += 1 + self.block(inner, indent + 1, depth + 1)
+                self.emit('} else {', indent)
+                count += 1 + self.block(max(1, inner // 2), indent + 1, depth + 1)
+                self.emit('}', indent)
+            elif depth < self.args.depth and budget - count >= 4 and r < 0.25:
+                counter = '%s_i%d' % (self.func.name, depth)
+                inner = self.rand.randint(1, min(budget - count - 3, 8))
+                self.emit('%s = 0;' % counter, indent)
+                self.emit('while (%s < %d) {' % (counter, LOOP_BOUND), indent)
+                self.func.counters.append(counter)
+                count += 2 + self.block(inner, indent + 1, depth + 1)
+                self.func.counters.pop()
+                self.emit('%s = %s + 1;' % (counter, counter), indent + 1)
+                self.emit('}', indent)
+                count += 1
+            elif self.funcs and r < 0.35:
+                callee = self.rand.choice(self.funcs)
+                args = ', '.join(self.expr(1) for _ in callee.params)
+                self.emit('%s = %s(%s);' % (self.rand.choice(self.func.ints), callee.name, args), indent)
+                count += 1
+            elif r < 0.38 and not self.args.no_io:
+                self.emit('write(%s);' % self.atom(), indent)
+                count += 1
+            else:
+                self.emit('%s = %s;' % (self.lvalue(), self.expr()), indent)
+                count += 1
+        return count
+
+    def function(self, index):
+        args = self.args
+        f = Function(index, args, self.rand)
+        self.func = f
+        self.emit('int %s(%s) {' % (f.name, ', '.join('int ' + p for p in f.params)), 0)
+        self.emit('int %s;' % ', '.join(f.ints[:args.locals]), 1)
+        if args.depth > 0:
+            self.emit('int %s;' % ', '.join('%s_i%d' % (f.name, d) for d in range(args.depth)), 1)
+        for a in f.arrays:
+            self.emit('int %s[%d];' % (a, ARRAY_SIZE), 1)
+        for name, s in f.structs:
+            self.emit('struct S%d %s;' % (s, name), 1)
+        for v in f.ints[:args.locals]:
+            self.emit('%s = %d;' % (v, self.rand.randrange(10)), 1)
+        self.block(args.statements, 1, 0)
+        self.emit('return %s;' % self.expr(), 1)
+        self.emit('}', 0)
+        self.emit('', 0)
+        self.funcs.append(f)
+
+    def program(self):
+        for s in range(self.args.structs):
+            self.emit('struct S%d {' % s, 0)
+            self.emit('int x;', 1)
+            self.emit('int v[4];', 1)
+            self.emit('};', 0)
+            self.emit('', 0)
+        for i in range(self.args.functions):
+            self.function(i)
+        self.emit('int main() {', 0)
+        self.emit('int total;', 1)
+        self.emit('total = 0;', 1)
+        for f in self.funcs:
+            self.emit('total = total + %s(%s);' % (f.name, ', '.join(str(i + 1) for i in range(len(f.params)))), 1)
+        if self.args.no_io:
+            self.emit('return total;', 1)
+        else:
+            self.emit('write(total);', 1)
+            self.emit('return 0;', 1)
+        self.emit('}', 0)
+        return '\n'.join(self.lines) + '\n'
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Generate a C-- program of a chosen size.')
+    parser.add_argument('--functions', type=int, default=10, help='number of functions besides main')
+    parser.add_argument('--statements', type=int, default=50, help='statements per function')
+    parser.add_argument('--lines', type=int, help='choose --functions for about this many lines')
+    parser.add_argument('--depth', type=int, default=3, help='maximum nesting of if and while')
+    parser.add_argument('--structs', type=int, default=2, help='number of struct types')
+    parser.add_argument('--arrays', type=int, default=2, help='local arrays per function')
+    parser.add_argument('--locals', type=int, default=6, help='local int variables per function')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--no-io', action='store_true', help='no write calls, for semantic_check which does not know them')
+    parser.add_argument('output', nargs='?', help='output file (default: stdout)')
+    args = parser.parse_args()
+    if args.locals < 1 or args.statements < 1 or args.functions < 0:
+        parser.error('--locals and --statements must be positive')
+    if args.lines is not None:
+        # statements, their closing braces and the declarations of each function
+        per_function = args.statements * 1.15 + args.locals + args.arrays + 8
+        args.functions = max(1, int(args.lines / per_function))
+
+    text = Generator(args).program()
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
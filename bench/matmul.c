@@ -0,0 +1,49 @@
+// product of two 16x16 matrices
+int main() {
+    int a[16][16], b[16][16], c[16][16];
+    int n, seed, i, j, k, s, trace, total;
+    n = 16;
+    seed = read();
+    i = 0;
+    while (i < n) {
+        j = 0;
+        while (j < n) {
+            seed = seed * 75 + 74;
+            seed = seed - seed / 65537 * 65537;
+            a[i][j] = seed / 4096 - 8;
+            b[j][i] = seed - seed / 16 * 16 - 8;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    i = 0;
+    while (i < n) {
+        j = 0;
+        while (j < n) {
+            s = 0;
+            k = 0;
+            while (k < n) {
+                s = s + a[i][k] * b[k][j];
+                k = k + 1;
+            }
+            c[i][j] = s;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    trace = 0;
+    total = 0;
+    i = 0;
+    while (i < n) {
+        trace = trace + c[i][i];
+        j = 0;
+        while (j < n) {
+            total = total + c[i][j];
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    write(trace);
+    write(total);
+    return 0;
+}
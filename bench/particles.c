@@ -0,0 +1,56 @@
+// particles bouncing in a box, kept in an array of structs
+struct Particle {
+    int x, y;
+    int vx, vy;
+};
+
+int main() {
+    struct Particle p[64];
+    int n, steps, seed, i, t, sx, sy, bounces;
+    n = 64;
+    steps = read();
+    seed = read();
+    i = 0;
+    while (i < n) {
+        seed = seed * 75 + 74;
+        seed = seed - seed / 65537 * 65537;
+        p[i].x = seed / 64;
+        p[i].y = seed - seed / 1024 * 1024;
+        p[i].vx = seed / 8192 - 4;
+        p[i].vy = seed - seed / 7 * 7 - 3;
+        i = i + 1;
+    }
+    bounces = 0;
+    t = 0;
+    while (t < steps) {
+        i = 0;
+        while (i < n) {
+            p[i].x = p[i].x + p[i].vx;
+            p[i].y = p[i].y + p[i].vy;
+            if (p[i].x < 0 || p[i].x >= 1024) {
+                p[i].vx = -p[i].vx;
+                p[i].x = p[i].x + p[i].vx;
+                bounces = bounces + 1;
+            }
+            if (p[i].y < 0 || p[i].y >= 1024) {
+                p[i].vy = -p[i].vy;
+                p[i].y = p[i].y + p[i].vy;
+                bounces = bounces + 1;
+            }
+            i = i + 1;
+        }
+        t = t + 1;
+    }
+    sx = 0;
+    sy = 0;
+    i = 0;
+    while (i < n) {
+        sx = sx + p[i].x;
+        sy = sy + p[i].y;
+        i = i + 1;
+    }
+    write(sx);
+    write(sy);
+    write(bounces);
+    return 0;
+}
@@ -0,0 +1,140 @@
+# Measures how the compiler scales with the size of its input: programs
+# of growing size from gen_program.py are run through gen_AST,
+# semantic_check, gen_ir and gen_oc, and the wall time and peak RSS of
+# each run are printed, one row per size and tool. gen_AST parses and
+# prints the tree; the others each run the phases of the one before them
+# plus their own (semantic analysis; translation and IR optimization; MIPS
+# generation), so the difference between two rows is the cost of a phase.
+#
+# For every tool the growth exponent k of time ~ lines^k is fitted over
+# the sizes whose time is above --min-time, and the run fails when k
+# exceeds --max-exponent, which catches quadratic paths automatically.
+# Linear passes come out somewhat above 1 at these sizes, as their data
+# outgrows the caches, and quadratic ones near 2. Tools whose output is
+# inherently superlinear get their own limit in MAX_EXPONENT instead.
+import sys
+import os
+import math
+import json
+import time
+import argparse
+import subprocess
+import tempfile
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+TOOLS = ['gen_AST', 'semantic_check', 'gen_ir', 'gen_oc']
+COLUMNS = ['lines', 'tool', 'seconds', 'peak_rss_kb', 'output_bytes']
+
+# per-tool limits that replace --max-exponent. gen_AST prints every node
+# two spaces deeper than its parent, and ExtDefList and StmtList nest one
+# level per item, so the size of the tree it prints is quadratic in the
+# length of those lists (output_bytes shows it). At the default sizes that
+# output costs lines^1.5 to 1.6; 1.8 leaves room for the noise but still
+# fails when gen_AST does quadratic work of its own on top of it.
+MAX_EXPONENT = {'gen_AST': 1.8}
+
+def generate(lines, seed, no_io, path):
+    cmd = [sys.executable, os.path.join(BENCH_DIR, 'gen_program.py'), '--lines', str(lines), '--seed', str(seed)]
+    if no_io:
+        cmd.append('--no-io')
+    subprocess.run(cmd + [path], check=True)
+    with open(path) as f:
+        return sum(1 for _ in f)
+
+# run cmd once with its standard output going to stdout_path and return
+# (seconds, peak RSS in KB), or None if it failed
+def measure(cmd, stdout_path):
+    with open(stdout_path, 'w') as out, open(os.devnull, 'w') as devnull:
+        start = time.perf_counter()
+        p = subprocess.Popen(cmd, stdout=out, stderr=devnull)
+        _, status, usage = os.wait4(p.pid, 0)
+        seconds = time.perf_counter() - start
+    if status != 0:
+        return None
+    return seconds, usage.ru_maxrss
+
+# least-squares slope of log(y) over log(x)
+def exponent(points):
+    if len(points) < 2:
+        return None
+    xs = [math.log(x) for x, _ in points]
+    ys = [math.log(y) for _, y in points]
+    mx, my = sum(xs) / len(xs), sum(ys) / len(ys)
+    sxx = sum((x - mx) ** 2 for x in xs)
+    if sxx == 0:
+        return None
+    return sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sxx
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Measure compile time and memory against program size.')
+    parser.add_argument('-b', '--bin', default='out', help='directory of the compiler binaries')
+    parser.add_argument('-o', '--output', help='write the table to this file instead of stdout')
+    parser.add_argument('--json', action='store_true', help='one JSON object per row instead of tab-separated columns')
+    parser.add_argument('--sizes', default='2000,4000,8000,16000', help='comma-separated program sizes in lines')
+    parser.add_argument('--tools', default=','.join(TOOLS), help='comma-separated tools to run')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--repeat', type=int, default=1, help='runs per size and tool, the fastest is kept')
+    parser.add_argument('--min-time', type=float, default=0.05, help='seconds below which a run is too noisy to fit')
+    parser.add_argument('--max-exponent', type=float, default=1.5, help='fail when a tool grows faster than lines^k (see MAX_EXPONENT)')
+    args, flags = parser.parse_known_args()
+    bad = [f for f in flags if not f.startswith('-f')]
+    if bad:
+        parser.error('unrecognized arguments: ' + ' '.join(bad))
+    tools = args.tools.split(',')
+    sizes = [int(s) for s in args.sizes.split(',')]
+
+    rows = []
+    ret_val = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for size in sizes:
+            src = os.path.join(tmp, 'p.c')
+            src_no_io = os.path.join(tmp, 'p_no_io.c')
+            lines = generate(size, args.seed, False, src)
+            generate(size, args.seed, True, src_no_io)
+            for tool in tools:
+                cmd = [os.path.join(args.bin, tool)]
+                stdout_path = os.path.join(tmp, 'p.stdout')
+                if tool in ('gen_ir', 'gen_oc'):
+                    out_path = os.path.join(tmp, 'p.out')
+                    cmd += flags + [src, out_path]
+                else:
+                    out_path = stdout_path
+                    # semantic_check does not declare read and write
+                    cmd.append(src_no_io if tool == 'semantic_check' else src)
+                best = None
+                for _ in range(args.repeat):
+                    result = measure(cmd, stdout_path)
+                    if result is None:
+                        break
+                    if best is None or result[0] < best[0]:
+                        best = result
+                if best is None:
+                    print('Fail: {} failed on {} lines'.format(tool, lines), file=sys.stderr)
+                    ret_val = 1
+                    continue
+                rows.append({'lines': lines, 'tool': tool, 'seconds': round(best[0], 4), 'peak_rss_kb': best[1],
+                             'output_bytes': os.path.getsize(out_path)})
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.json:
+        for row in rows:
+            out.write(json.dumps(row) + '\n')
+    else:
+        out.write('\t'.join(COLUMNS) + '\n')
+        for row in rows:
+            out.write('\t'.join(str(row[c]) for c in COLUMNS) + '\n')
+    if out is not sys.stdout:
+        out.close()
+
+    for tool in tools:
+        points = [(r['lines'], r['seconds']) for r in rows if r['tool'] == tool and r['seconds'] >= args.min_time]
+        k = exponent(points)
+        if k is None:
+            print('{}: too fast to fit'.format(tool), file=sys.stderr)
+            continue
+        limit = MAX_EXPONENT.get(tool, args.max_exponent)
+        print('{}: time ~ lines^{:.2f}'.format(tool, k), file=sys.stderr)
+        if k > limit:
+            print('Fail: {} grows faster than lines^{}'.format(tool, limit), file=sys.stderr)
+            ret_val = 1
+    sys.exit(ret_val)
@@ -0,0 +1,48 @@
+// binary and linear search for m keys in a sorted array of 1000 numbers
+int binary_search(int a[1000], int n, int key) {
+    int lo, hi, mid;
+    lo = 0;
+    hi = n - 1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (a[mid] == key) return mid;
+        if (a[mid] < key) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+int linear_search(int list[1000], int len, int value) {
+    int i;
+    i = 0;
+    while (i < len && list[i] < value) i = i + 1;
+    if (i < len && list[i] == value) return i;
+    return -1;
+}
+
+int main() {
+    int table[1000];
+    int size, m, seed, k, target, hits, agree;
+    size = 1000;
+    m = read();
+    seed = read();
+    k = 0;
+    while (k < size) {
+        table[k] = 3 * k + 1;
+        k = k + 1;
+    }
+    hits = 0;
+    agree = 1;
+    k = 0;
+    while (k < m) {
+        seed = seed * 75 + 74;
+        seed = seed - seed / 65537 * 65537;
+        target = seed - seed / 3000 * 3000;
+        if (binary_search(table, size, target) != linear_search(table, size, target)) agree = 0;
+        if (binary_search(table, size, target) >= 0) hits = hits + 1;
+        k = k + 1;
+    }
+    write(hits);
+    write(agree);
+    return 0;
+}
@@ -0,0 +1,29 @@
+// sieve of Eratosthenes below n (n <= 5000)
+int main() {
+    int composite[5000];
+    int n, i, j, count, last;
+    n = read();
+    i = 0;
+    while (i < n) {
+        composite[i] = 0;
+        i = i + 1;
+    }
+    count = 0;
+    last = 0;
+    i = 2;
+    while (i < n) {
+        if (!composite[i]) {
+            count = count + 1;
+            last = i;
+            j = i * i;
+            while (j < n) {
+                composite[j] = 1;
+                j = j + i;
+            }
+        }
+        i = i + 1;
+    }
+    write(count);
+    write(last);
+    return 0;
+}
@@ -0,0 +1,51 @@
+// quick sort of n pseudo-random numbers (n <= 2000)
+int quicksort(int a[2000], int lo, int hi) {
+    int i, j, pivot, t;
+    if (lo < hi) {
+        pivot = a[(lo + hi) / 2];
+        i = lo;
+        j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) i = i + 1;
+            while (a[j] > pivot) j = j - 1;
+            if (i <= j) {
+                t = a[i];
+                a[i] = a[j];
+                a[j] = t;
+                i = i + 1;
+                j = j - 1;
+            }
+        }
+        quicksort(a, lo, j);
+        quicksort(a, i, hi);
+    }
+    return 0;
+}
+
+int main() {
+    int data[2000];
+    int n, seed, k, sorted, sum;
+    n = read();
+    seed = read();
+    k = 0;
+    while (k < n) {
+        seed = seed * 75 + 74;
+        seed = seed - seed / 65537 * 65537;
+        data[k] = seed;
+        k = k + 1;
+    }
+    quicksort(data, 0, n - 1);
+    sorted = 1;
+    sum = 0;
+    k = 1;
+    while (k < n) {
+        if (data[k - 1] > data[k]) sorted = 0;
+        sum = sum + (data[k] - data[k - 1]) * k / 64;
+        k = k + 1;
+    }
+    write(sorted);
+    write(data[0]);
+    write(data[n - 1]);
+    write(sum);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef __CALL_GRAPH_H__
+#define __CALL_GRAPH_H__
+
+#include "ir.h"
+#include "common.h"
+
+typedef struct {
+    InterCodes *code;           // the IR_CALL
+    int caller;                 // index into CallGraph.funcs
+} CGCall;
+
+typedef struct {
+    Symbol symbol;
+    InterCodes *head, *tail;    // FUNCTION ... last code of the body
+    int nparams;
+
+    int *callees;               // indices into CallGraph.funcs, may repeat
+    int ncallees, callee_capacity;
+
+    CGCall *calls;              // the call sites of this function
+    int ncalls, call_capacity;
+
+    int scc;                    // SCCs are numbered callees first
+    bool recursive;             // in a cycle of the call graph
+    bool reachable;             // from main
+
+    // summaries, including everything the function calls
+    bool leaf;                  // makes no calls (READ/WRITE do not count)
+    bool does_io;               // READ or WRITE
+    bool writes_memory;         // stores through a pointer it was passed
+    bool pure;                  // no io and no memory writes visible to the caller
+} CGFunc;
+
+typedef struct {
+    CGFunc *funcs;
+    int size;
+    int nsccs;
+} CallGraph;
+
+CallGraph* build_call_graph(InterCodes* codes);
+void free_call_graph(CallGraph* cg);
+// the node of func with its summaries, NULL if func is not defined
+CGFunc* cg_lookup(CallGraph* cg, Symbol func);
+
+InterCodes* optimize_call_graph(InterCodes* codes, bool *changed);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __INTERP_H__
+#define __INTERP_H__
+
+#include <stdio.h>
+#include "common.h"
+
+// Interpreter for the textual IR printed by gen_ir, with the semantics of
+// ir-simulator/irsim.py: every variable and DEC array lives in the frame of
+// its function, a new frame is made at each CALL, ARGs are popped by the
+// PARAMs of the callee, and the RETURN of main ends the run. Arithmetic
+// wraps at 32 bits and division truncates, as on MIPS.
+//
+// Labels, functions and variables are resolved when the program is loaded,
+// into an array of instructions specialised by operand kind (variable or
+// constant), which are executed with direct-threaded dispatch.
+
+// words of memory for the frames of all active calls
+#define INTERP_STACK_WORDS (1 << 22)
+
+typedef struct IrProgram IrProgram;
+
+typedef struct {
+    long long instructions; // counted like irsim: labels reached by falling through count, jump targets do not
+    long long loads;        // reads through *x
+    long long stores;       // writes through *x
+    long long calls;
+    int max_depth;          // deepest chain of active calls, main being 1
+} InterpStats;
+
+// parse and resolve the IR read from in; name is used in error messages.
+// Returns NULL after reporting the first error.
+IrProgram* interp_load(FILE* in, const char* name);
+void interp_free(IrProgram* prog);
+
+// run main, reading READ values from input and printing WRITE values to
+// output, one per line. Returns 0, or 1 after reporting a runtime error
+// (bad address, division by zero, missing input, stack overflow).
+int interp_run(IrProgram* prog, FILE* input, FILE* output, InterpStats* stats);
+
+// count the executions of every instruction, and the instructions
+// executed in every call, in the following runs of prog
+void interp_profile(IrProgram* prog);
+// the instructions executed for each source line, from the "# line N"
+// comments of gen_ir -g, the most expensive line first; "?" is code
+// before the first comment
+void interp_report_lines(IrProgram* prog, FILE* out);
+// after profiled runs: the flat profile (calls and the instructions executed
+// in each function, by itself and with what it called), the call graph
+// edges, the max_blocks most expensive basic blocks, and the IR annotated
+// with the executions of each line, the most expensive function first.
+// Recursive calls are counted in the inclusive numbers of the outermost
+// call only.
+void interp_report_profile(IrProgram* prog, FILE* out, int max_blocks);
+// after profiled runs of IR from gen_ir -fprofile-generate: the executions
+// of each basic block and of the taken side of the branch ending it, in the
+// format gen_ir and gen_oc -fprofile-use read (see pgo.h)
+void interp_write_block_counts(IrProgram* prog, FILE* out);
+
+#endif
@@ -17,7 +17,7 @@ typedef struct {
 #define VAR_NULL 0
 
 typedef struct {
-    enum {
+    enum IR_KIND {
         IR_LABEL,   // LABEL result :
         IR_FUNC,    // FUNCTION result :
         IR_ASSIGN,  // result := arg1
@@ -32,6 +32,8 @@ typedef struct {
 
         IR_GOTO,    // GOTO result
         IR_RELOP,   // IF arg1 [relop] arg2 GOTO result
+        IR_SETREL,  // result := arg1 [relop] arg2, as 1 or 0
+        IR_CMOV,    // IF arg2 [relop] #0 THEN result := arg1, relop is EQ or NE
         IR_RETURN,  // RETURN result
         IR_DEC,     // DEC result [size]
         IR_ARG,     // ARG result
@@ -39,7 +41,9 @@ typedef struct {
         IR_PARAM,   // PARAM result
 
         IR_READ,    // READ result
-        IR_WRITE    // WRITE result
+        IR_WRITE,   // WRITE result
+
+        IR_COUNT    // execution counter of a basic block, result is its hash (pgo.h)
     } kind;
 
     Operand result, arg1, arg2;
@@ -49,6 +53,9 @@ typedef struct {
         RELOP_GT, RELOP_GE, RELOP_NE
     } relop;
     int size;
+    int lineno;     // source line the instruction was translated from, 0 if unknown
+    bool wraps;     // IR_ADD, IR_SUB: wrap around on overflow instead of trapping,
+                    // for code that runs where the source would not run it
 
 } InterCode;
 
@@ -64,6 +71,7 @@ struct ArgNode_ {
 };
 typedef struct ArgNode_ ArgNode;
 
+InterCodes* newInterCodes();
 InterCodes* concatInterCodes(int count, ...);
 InterCodes* deleteInterCode(InterCodes *head, InterCodes *del);
 
@@ -71,6 +79,9 @@ InterCodes* genLabelCode(int label_id);
 InterCodes* genGotoCode(int label_id);
 
 enum RELOP_TYPE get_relop(ASTNode *RELOP);
+enum RELOP_TYPE get_reverse_relop(enum RELOP_TYPE relop);
+enum RELOP_TYPE get_mirror_relop(enum RELOP_TYPE relop);
+InterCodes* genSetRelCode(int place, enum RELOP_TYPE relop, Operand arg1, Operand arg2);
 
 int getTypeSize(Type type);
 
@@ -98,8 +109,19 @@ void generate_ir(ASTNode* Program);
 
 InterCodes* optmize_copyPropagation(InterCodes* inCodes);
 void peek_basic_block(InterCodes* codes, InterCodes** start, InterCodes** end);
+bool isOperandEqual(Operand op1, Operand op2);
+bool isDefinition(InterCodes* p);
+int getUsedOperands(InterCodes* p, Operand uses[3]);
+InterCodes* optimize_algebraic(InterCodes* codes, bool *changed);
+InterCodes* optimize_memory(InterCodes* codes, bool *changed);
+InterCodes* optimize_if_conversion(InterCodes* codes, bool *changed);
 InterCodes* optimize_ir(InterCodes* codes);
 
 #define LABEL_FALL 0
 
+extern int variableId;
+extern int labelId;
+int newVariableId();
+int newLabelId();
+
 #endif  // __IR_H__
@@ -0,0 +1,40 @@
+#ifndef __ISEL_H__
+#define __ISEL_H__
+
+#include "ir.h"
+#include "common.h"
+
+// Tiles that cover more than one IR instruction. A temporary defined by
+// t := &v, t := b + #c or t := b - #c whose only use is the address of a
+// load or store in the same block is folded into that access, which becomes
+// a single lw/sw c(b) or lw/sw off($fp). Chains of such definitions fold as
+// long as the offsets add up to an immediate. The folded definitions emit
+// nothing.
+
+// the smallest and largest 16-bit signed immediate
+#define IMM_MIN (-32768)
+#define IMM_MAX 32767
+
+typedef struct {
+    Operand base;       // holds the base address, or the array or variable
+    bool in_frame;      // the base is the frame slot of the operand above
+    int off;            // bytes added to the base
+} IselAddr;
+
+// find the foldable definitions of the whole program
+void isel_select(InterCodes* ics);
+
+// the definition made by p is folded into the use of its result
+bool isel_folded(InterCodes* p);
+
+// p defines its result and is not folded
+bool isel_defines(InterCodes* p);
+
+// operands read by p once the folded definitions are substituted, like
+// getUsedOperands; a folded address stands for its base operand
+int isel_uses(InterCodes* p, Operand uses[3]);
+
+// the address held by opd, following folded definitions
+IselAddr isel_address(Operand* opd);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __MEMSTAT_H__
+#define __MEMSTAT_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include "common.h"
+
+// Allocation tracking for -fmem-report and -fmem-budget: the long-lived
+// data structures of the compiler are allocated through these wrappers
+// with a tag, and the live and peak bytes and objects of every tag are
+// recorded at the end of each phase (mem_checkpoint).
+//
+// mem_start has to come before the first tagged allocation; without it the
+// wrappers are plain malloc/calloc/realloc/free.
+
+typedef enum {
+    MEM_AST,        // ASTNode
+    MEM_SYMBOL,     // SymbolList_ and Func_
+    MEM_TYPE,       // Type_ and FieldList_
+    MEM_IR,         // InterCodes and ArgNode
+    MEM_LVA,        // LocalVarAddr table of the backend
+    MEM_NUM
+} MemTag;
+
+void* mem_alloc(MemTag tag, size_t size);
+void* mem_calloc(MemTag tag, size_t n, size_t size);
+void* mem_realloc(MemTag tag, void *p, size_t size);
+void mem_free(void *p);
+
+// budget: fail (mem_over_budget) when the tagged bytes live at one time
+// exceed it, 0 for no limit
+void mem_start(long long budget);
+void mem_checkpoint(const char *phase);
+
+// allocations made through the wrappers so far and the bytes they asked
+// for, counted with or without mem_start (-ftime-report samples these)
+void mem_allocations(long long *count, long long *bytes);
+
+// the live and peak numbers of each tag at every checkpoint
+void mem_report(FILE *out);
+// report and return true when the peak went over the budget
+bool mem_over_budget(FILE *out);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef __MIPS_H__
+#define __MIPS_H__
+
+#include <stdio.h>
+#include "common.h"
+
+// the text segment is collected as a list of instructions so that it can be
+// rewritten before it is printed
+
+// register numbers
+enum {
+    MR_ZERO = 0, MR_V0 = 2, MR_V1 = 3, MR_A0 = 4,
+    MR_T0 = 8, MR_S0 = 16, MR_T8 = 24,
+    MR_SP = 29, MR_FP = 30, MR_RA = 31,
+    MIPS_NUM_REGS = 32
+};
+
+typedef enum {
+    MI_ENTRY,       // function entry label, printed after an empty line
+    MI_LABEL,
+    MI_LI, MI_LA, MI_MOVE,
+    MI_ADD, MI_ADDU, MI_SUB, MI_SUBU, MI_MUL,
+    MI_SLT, MI_SLTU, MI_XOR, MI_MOVN, MI_MOVZ,
+    MI_ADDI, MI_ADDIU, MI_XORI, MI_SLTI, MI_SLTIU, MI_SLL, MI_SRA, MI_SRL,
+    MI_MULT, MI_DIV, MI_MFHI, MI_MFLO,
+    MI_LW, MI_SW,
+    MI_BEQ, MI_BNE, MI_BGT, MI_BLT, MI_BGE, MI_BLE,
+    MI_BEQZ, MI_BNEZ, MI_BGTZ, MI_BLTZ, MI_BGEZ, MI_BLEZ,
+    MI_J, MI_JAL, MI_JR, MI_SYSCALL,
+    MI_NOP,
+    MI_NUM_OPS
+} MipsOp;
+
+// how the operands are written; r0-r2 are the register operands in the
+// order they appear in the text
+typedef enum {
+    MF_NONE,        // op
+    MF_L,           // op label
+    MF_R,           // op r0
+    MF_RR,          // op r0, r1
+    MF_RRR,         // op r0, r1, r2
+    MF_RI,          // op r0, imm
+    MF_RRI,         // op r0, r1, imm
+    MF_MEM,         // op r0, imm(r1)
+    MF_RL,          // op r0, label
+    MF_RRL,         // op r0, r1, label
+} MipsFormat;
+
+typedef struct {
+    const char *name;
+    MipsFormat format;
+    unsigned defs, uses;    // bit i: register operand i is written / read
+    int latency;            // cycles from issue until the result can be used
+} MipsOpInfo;
+
+extern const MipsOpInfo mips_ops[MI_NUM_OPS];
+extern const char *mips_reg_names[MIPS_NUM_REGS];
+
+typedef struct MipsIns_ {
+    MipsOp op;
+    int r[3];
+    int imm;
+    char *label;            // owned by the instruction
+    int block;              // used by the peephole pass
+    int line;               // source line for .loc, 0 if unknown
+    unsigned live;
+    struct MipsIns_ *prev, *next;
+} MipsIns;
+
+int mips_reg(const char *name);
+
+// shorthands for the formats above
+#define mips_r(op, a)               mips_emit(op, a, 0, 0, 0, NULL)
+#define mips_rr(op, a, b)           mips_emit(op, a, b, 0, 0, NULL)
+#define mips_rrr(op, a, b, c)       mips_emit(op, a, b, c, 0, NULL)
+#define mips_ri(op, a, imm)         mips_emit(op, a, 0, 0, imm, NULL)
+#define mips_rri(op, a, b, imm)     mips_emit(op, a, b, 0, imm, NULL)
+#define mips_mem(op, a, off, b)     mips_emit(op, a, b, 0, off, NULL)
+#define mips_none(op)               mips_emit(op, 0, 0, 0, 0, NULL)
+
+// source line given to the instructions appended from now on; mips_flush
+// prints a .loc directive where it changes
+void mips_set_line(int line);
+
+// append an instruction to the buffer; label may be NULL
+MipsIns* mips_emit(MipsOp op, int r0, int r1, int r2, int imm, const char *label);
+MipsIns* mips_emit_label(MipsOp op, const char *format, ...);
+
+// an instruction outside the buffer
+MipsIns* mips_new(MipsOp op, int r0, int r1, int r2, int imm, const char *label);
+
+MipsIns* mips_first();
+// insert ins after pos, or at the start when pos is NULL
+void mips_insert_after(MipsIns *pos, MipsIns *ins);
+void mips_unlink(MipsIns *ins);
+
+// branches and jumps, which are followed by a delay slot on the hardware
+bool mips_has_delay_slot(MipsIns *ins);
+// labels, branches, jumps, calls and syscalls
+bool mips_is_boundary(MipsIns *ins);
+
+// registers written / read by ins, as bit masks over register numbers
+unsigned mips_defs(MipsIns *ins);
+unsigned mips_uses(MipsIns *ins);
+
+// rewrite the buffer with the peephole rules
+void mips_peephole();
+
+// print the buffer to out and empty it
+void mips_flush(FILE *out);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __MIPSSIM_H__
+#define __MIPSSIM_H__
+
+#include <stdio.h>
+#include "common.h"
+
+// Simulator for the MIPS subset gen_oc emits (the opcodes of mips_ops),
+// reading the assembly text. Registers and memory are 32 bits; the data
+// segment holds the .asciiz strings and is read-only, the stack below
+// MIPSSIM_STACK_TOP is the only writable memory. main starts with $ra = 0
+// and the run ends when it returns there or on syscall 10. Under
+// .set noreorder branches and jumps have a delay slot.
+//
+// The cycle estimate models a single-issue in-order pipeline: an
+// instruction waits until its register operands (and HI/LO) are ready,
+// results take the latency from mips_ops, and a taken branch or jump
+// without a delay slot costs one bubble.
+
+#define MIPSSIM_TEXT_BASE 0x00400000
+#define MIPSSIM_DATA_BASE 0x10010000
+#define MIPSSIM_STACK_TOP 0x7ffff000
+#define MIPSSIM_STACK_WORDS (1 << 22)
+
+typedef enum {
+    MC_ALU,         // moves, li/la, add/sub/logic/compare/shift, mfhi/mflo
+    MC_MUL,         // mul, mult
+    MC_DIV,
+    MC_LOAD,
+    MC_STORE,
+    MC_BRANCH,      // conditional branches
+    MC_JUMP,        // j, jal, jr
+    MC_SYSCALL,
+    MC_NOP,
+    MC_NUM
+} MipsClass;
+
+extern const char *mipssim_class_names[MC_NUM];
+
+typedef struct {
+    long long instructions;
+    long long by_class[MC_NUM];
+    long long taken_branches;   // conditional branches that jumped
+    long long calls;            // executed jal instructions
+    long long stalls;           // cycles spent waiting for operands
+    long long bubbles;          // cycles lost to taken branches and jumps
+    long long cycles;
+} MipsSimStats;
+
+typedef struct {
+    bool print_strings;         // print the strings of syscall 4 (the read prompt, newlines);
+                                // without them every integer is followed by a newline
+    long long max_steps;        // stop with an error after this many instructions, 0: no limit
+    bool profile;               // count the instructions and cycles of each instruction
+} MipsSimOptions;
+
+typedef struct MipsProgram MipsProgram;
+
+// parse the assembly read from in; name is used in error messages.
+// Returns NULL after reporting the first error.
+MipsProgram* mipssim_load(FILE* in, const char* name);
+void mipssim_free(MipsProgram* prog);
+
+// run from main, reading syscall 5 values from input and printing to
+// output. Returns 0, or 1 after reporting a runtime error (bad address or
+// jump target, arithmetic overflow of add/sub/addi, division by zero,
+// missing input, step limit).
+int mipssim_run(MipsProgram* prog, FILE* input, FILE* output, const MipsSimOptions* options,
+    MipsSimStats* stats);
+
+// after a run with profile set: the instructions and cycles of each source
+// line, from the .loc directives of gen_oc -g, the most expensive line
+// first; "?" is code before the first .loc
+void mipssim_report_lines(MipsProgram* prog, FILE* out);
+
+#endif
@@ -4,46 +4,45 @@
 #include "AST.h"
 #include "ir.h"
 #include "common.h"
+#include "strength_reduce.h"
 
 typedef struct {
-    enum { LV_TEMP, LV_VAR } kind;
-    union {
-        char *name;
-        int id;
-    } u;
+    bool assigned;  // has a slot in the current frame
     int off;        // offset to $fp
 } LocalVarAddr;
 
 
 typedef struct {
-    char name[6];
+    int no;         // MIPS register number
     LocalVarAddr *lva;
     bool unused;
+    bool allocated;     // holds a value for the register allocator, never spilled
 } Reg;
 
-struct LvaList_ {
-    LocalVarAddr *lva;
-    struct LvaList_ *next;
-};
-typedef struct LvaList_ LvaList;
-
-void generate_oc(ASTNode* Program);
+// source: the path of the C-- file, named by the .file directive under -g
+void generate_oc(ASTNode* Program, const char* source);
 void gen_data_seg();
 void gen_global_seg();
 void gen_text_seg(InterCodes* ics);
 void gen_read_func();
 void gen_write_func();
 void init_reg();
+void plan_frame(InterCodes* func);
+void load_operand(int reg, Operand* opd);
 Reg* get_reg(Operand* opd);
+Reg* get_def_reg(Operand* opd);
+Reg* get_scratch_reg();
+void gen_strength_reduced(SRSeq* seq, Operand* result, Operand* src);
 void free_reg(Reg* r);
 void spill_reg(Reg* r);
 LocalVarAddr* get_lva(Operand* opd);
-LocalVarAddr* add_lva(Operand* opd);
-void add_param2lva(Operand* opd);
-void add_array2lva(Operand* opd, int size);
-void clear_lvas();
 void gen_prologue();
 void gen_epilogue();
 void gen_addr(Reg* r, Operand* opd);
+bool is_imm(int value);
+void gen_addi(Operand* result, Operand* src, int imm, bool wraps);
+Reg* get_addr_reg(Operand* opd, int* off);
+bool gen_branch_zero(InterCodes* ic);
+bool gen_setrel_imm(InterCodes* ic);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include "common.h"
+
+// code generation switches, set from -f<name> / -fno-<name> on the command line
+typedef struct {
+    bool optimize;          // run the IR optimizer
+    bool regalloc;          // keep values in registers across IR instructions
+    bool peephole;          // rewrite the emitted MIPS code with the peephole rules
+    bool schedule;          // reorder each block for the pipeline latencies
+    bool delay_slots;       // fill branch delay slots, output in .set noreorder mode
+    bool inline_io;         // expand read and write into syscalls at each use
+    bool line_info;         // -g: source lines as comments in the IR and .loc in the MIPS output
+    bool time_report;       // print the time spent in each phase to stderr
+    bool time_report_json;  // the same as JSON
+    bool stats;             // print what each optimization pass did to stderr
+    bool stats_json;        // the same as JSON, with instruction counts per function
+    bool mem_report;        // print the memory of each data structure after each phase
+    long long mem_budget;   // -fmem-budget=<bytes>[K|M|G]: fail when the tracked peak is over it, 0: none
+    bool profile_generate;  // count the executions of each basic block in the IR output (pgo.h)
+    const char *profile_use; // -fprofile-use=<file>: optimize with the counts run_ir -P wrote, NULL: none
+} Options;
+
+extern Options options;
+
+// remove the options from argv and return the number of arguments left,
+// or -1 after reporting an unknown option
+int parse_options(int argc, char **argv);
+
+#endif
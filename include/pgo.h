@@ -0,0 +1,48 @@
+#ifndef __PGO_H__
+#define __PGO_H__
+
+#include "ir.h"
+#include "common.h"
+
+// Profile-guided optimization in two steps:
+//
+//   gen_ir -fprofile-generate prog.cmm prog.ir
+//   run_ir -P prog.prof prog.ir < training-input
+//   gen_oc -fprofile-use=prog.prof prog.cmm prog.s
+//
+// The first puts an IR_COUNT at the start of every basic block of the
+// optimized IR, printed as "# block <hash>", which only run_ir accepts (the
+// IR has no global memory a compiled-in counter could live in, nor any way
+// to print one but WRITE). run_ir counts the executions of each block and
+// of the taken side of the branch ending it, and writes
+//
+//   function <name>
+//   block <hash> <executions> <taken, or - without a conditional branch>
+//
+// The hash is made from what the block computes (operators, variable and
+// function names, constants), not from temp or label numbers, so that the
+// blocks of a function are matched by it also after small changes to the
+// program; blocks that are not found are taken as not executed.
+
+// hot call sites are inlined if the callee has at most this many
+// instructions, and the sites together add at most PGO_INLINE_GROWTH
+// percent to the instructions of the program, or one callee of the
+// largest size to a small program
+#define PGO_INLINE_MAX_SIZE 40
+#define PGO_INLINE_GROWTH   50
+// a call site is hot when it runs at least this many thousandths of the
+// executions of the most executed block of the program
+#define PGO_HOT_PERMILLE    1
+
+// add the block counters
+InterCodes* pgo_instrument(InterCodes* codes);
+
+// read the profile at path and, in each executed function, lay the blocks
+// out so that the more frequent successor of each block follows it (moving
+// never executed blocks to the end and inverting branches as needed),
+// inline hot calls, and order the functions by the instructions executed
+// in them, the most expensive first. Warns and leaves codes as they are
+// when the profile cannot be read.
+InterCodes* pgo_use(InterCodes* codes, const char* path);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __REGALLOC_H__
+#define __REGALLOC_H__
+
+#include "ir.h"
+#include "common.h"
+
+// registers handed out by the allocator: caller-saved $t0-$t6 first, then
+// the callee-saved $s0-$s7; $t7-$t9 and $v1 stay free as scratch registers
+// for operands that live in stack slots
+#define RA_NUM_TEMP_REGS  7
+#define RA_NUM_SAVED_REGS 8
+#define RA_NUM_REGS       (RA_NUM_TEMP_REGS + RA_NUM_SAVED_REGS)
+#define RA_NO_REG         (-1)
+
+extern const char *ra_reg_names[RA_NUM_REGS];
+
+// number the temporaries and variables of the function starting at func (an
+// IR_FUNC) and, if allocate is set, assign registers to them; the result
+// stays valid until the next call
+void ra_allocate(InterCodes *func, bool allocate);
+
+// dense index of a temporary or variable of the current function in
+// [0, ra_count()), or -1
+int ra_index(Operand *opd);
+int ra_count();
+
+// register of a temporary or variable of the current function, or RA_NO_REG
+// when it lives in its stack slot
+int ra_lookup(Operand *opd);
+
+// give every index i with want[i] set a word-sized stack slot, shared with
+// other such values whose live intervals do not overlap unless its address
+// is taken; slot[i] receives the slot number (or -1) and the number of
+// slots is returned
+int ra_share_slots(const bool *want, int *slot);
+
+// bit i set when $si is used by the current function and must be saved
+unsigned ra_saved_regs_used();
+
+#endif
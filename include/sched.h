@@ -0,0 +1,16 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include "mips.h"
+
+// reorder the straight-line code between labels, branches and calls of the
+// buffer with a list scheduler, so that independent work fills the cycles
+// between a load or multiply and the use of its result (latencies from the
+// latency column of mips_ops)
+void mips_schedule();
+
+// move an instruction from before every branch and jump into its delay
+// slot, or put a nop there; the result needs .set noreorder
+void mips_fill_delay_slots();
+
+#endif
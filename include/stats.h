@@ -0,0 +1,30 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+#include "ir.h"
+#include "common.h"
+
+// Optimizer statistics for -fstats: named counters per pass (copies
+// propagated, constants folded, instructions deleted, ...) and, for the
+// passes bracketed by stats_ir_before / stats_ir_after, the number of IR
+// instructions of each function before the first run of the pass, after
+// its last run, and the sum of the changes made by the pass itself over
+// all its runs.
+//
+// Everything is a no-op until stats_start.
+
+#define STATS_MAX_PASSES 32
+#define STATS_MAX_COUNTERS 8
+
+void stats_start();
+void stats_add(const char *pass, const char *counter, long long n);
+void stats_ir_before(InterCodes *codes);
+void stats_ir_after(const char *pass, InterCodes *codes);
+
+// the counters and per-pass instruction totals as a table
+void stats_report(FILE *out);
+// everything, including the per-function counts, as one JSON object
+void stats_report_json(FILE *out);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __STRENGTH_REDUCE_H__
+#define __STRENGTH_REDUCE_H__
+
+#include "common.h"
+
+// rough issue cost of each instruction class, used to pick between a
+// shift/add (or multiply-high) sequence and the generic mul/div
+#define SR_COST_ALU     1
+#define SR_COST_LI      2   // li may expand to lui + ori
+#define SR_COST_MUL     5   // mul rd, rs, rt
+#define SR_COST_MULT_HI 6   // mult rs, rt + mfhi rd
+#define SR_COST_DIV     36  // div rs, rt + mflo rd
+
+#define SR_MAX_INS 80
+
+// operand slots of a lowered sequence, bound to real registers by the emitter
+enum SR_REG { SR_ZERO, SR_DST, SR_SRC, SR_TMP1, SR_TMP2 };
+
+typedef struct {
+    enum {
+        SR_LI,      // rd := imm
+        SR_MOVE,    // rd := rs
+        SR_ADDU,    // rd := rs + rt
+        SR_SUBU,    // rd := rs - rt
+        SR_SLL,     // rd := rs << imm
+        SR_SRA,     // rd := rs >> imm (arithmetic)
+        SR_SRL,     // rd := rs >> imm (logical)
+        SR_MULT_HI, // rd := high 32 bits of rs * rt (signed), i.e. mult + mfhi
+    } op;
+    enum SR_REG rd, rs, rt;
+    int imm;
+} SRIns;
+
+// SR_DST is only written by the last instruction, so the destination may
+// share a register with SR_SRC
+typedef struct {
+    int len;
+    int cost;
+    SRIns ins[SR_MAX_INS];
+} SRSeq;
+
+bool sr_mul_const(int c, SRSeq *seq);
+bool sr_div_const(int d, SRSeq *seq);
+int  sr_seq_eval(SRSeq *seq, int x);
+
+#endif
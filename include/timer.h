@@ -0,0 +1,30 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <stdio.h>
+#include "common.h"
+
+// Per-phase compile-time accounting for -ftime-report: wall time, CPU time
+// and the number and size of allocations made through the memstat wrappers
+// between timer_begin and the matching timer_end, plus cycles, instructions
+// and cache misses where perf_event_open is permitted. Phases nest, and a
+// phase entered again under the same parent (an optimization pass run to a
+// fixed point, the register allocator run per function) adds to the same
+// entry.
+//
+// Everything is a no-op until timer_start.
+
+// the most phases (with distinct names under their parents) recorded
+#define TIMER_MAX_PHASES 64
+#define TIMER_MAX_DEPTH 8
+
+void timer_start();
+void timer_begin(const char *name);
+void timer_end();
+
+// a table with one row per phase, children indented under their parents
+void timer_report(FILE *out);
+// the same numbers as one JSON object
+void timer_report_json(FILE *out);
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "AST.h"
 #include "semantic.h"
+#include "memstat.h"
 
 ASTNode *ASTroot = NULL;
 
@@ -29,7 +30,7 @@ const char *const ASTNodeTypeName[] = {
 };
 
 ASTNode *newASTNode(enum ASTNodeType type, int lineno) {
-    ASTNode *p = (ASTNode *)malloc(sizeof(ASTNode));
+    ASTNode *p = (ASTNode *)mem_alloc(MEM_AST, sizeof(ASTNode));
     p->child = p->sibling = p->parent = NULL;
     p->type = type;
     p->lineno = lineno;
@@ -106,5 +107,5 @@ void freeAST(ASTNode *parent) {
         p = p->sibling;
         freeAST(h);
     }
-    free(parent);
+    mem_free(parent);
 }
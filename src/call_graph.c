@@ -0,0 +1,423 @@
+#include "call_graph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "debug.h"
+#include "stats.h"
+
+// open addressing on the function symbol, so that call sites of large
+// programs resolve in constant time
+static int cg_slot(CallGraph* cg, int* index, int capacity, Symbol func) {
+    uintptr_t h = ((uintptr_t)func >> 4) * 2654435761u;
+    int i = (int)(h % (uintptr_t)capacity);
+    while (index[i] != -1 && cg->funcs[index[i]].symbol != func) {
+        i = (i + 1) % capacity;
+    }
+    return i;
+}
+
+static int *cg_index = NULL;
+static int cg_index_capacity = 0;
+static CallGraph *cg_indexed = NULL;
+
+static void cg_build_index(CallGraph* cg) {
+    free(cg_index);
+    cg_index_capacity = cg->size * 2 + 1;
+    cg_index = (int*)malloc(sizeof(int) * cg_index_capacity);
+    for (int i = 0; i < cg_index_capacity; i++) {
+        cg_index[i] = -1;
+    }
+    for (int i = 0; i < cg->size; i++) {
+        cg_index[cg_slot(cg, cg_index, cg_index_capacity, cg->funcs[i].symbol)] = i;
+    }
+    cg_indexed = cg;
+}
+
+static int cg_find(CallGraph* cg, Symbol func) {
+    if (cg_indexed != cg) cg_build_index(cg);
+    return cg_index[cg_slot(cg, cg_index, cg_index_capacity, func)];
+}
+
+CGFunc* cg_lookup(CallGraph* cg, Symbol func) {
+    int i = cg_find(cg, func);
+    return i < 0 ? NULL : &cg->funcs[i];
+}
+
+static void add_callee(CGFunc* f, int callee) {
+    if (f->ncallees == f->callee_capacity) {
+        f->callee_capacity = f->callee_capacity ? f->callee_capacity * 2 : 4;
+        f->callees = (int*)realloc(f->callees, sizeof(int) * f->callee_capacity);
+    }
+    f->callees[f->ncallees++] = callee;
+}
+
+static void add_call(CGFunc* f, InterCodes* code, int caller) {
+    if (f->ncalls == f->call_capacity) {
+        f->call_capacity = f->call_capacity ? f->call_capacity * 2 : 4;
+        f->calls = (CGCall*)realloc(f->calls, sizeof(CGCall) * f->call_capacity);
+    }
+    f->calls[f->ncalls].code = code;
+    f->calls[f->ncalls].caller = caller;
+    f->ncalls++;
+}
+
+// Tarjan's algorithm; SCC ids are assigned callees first
+static int tarjan_counter, *tarjan_num, *tarjan_low, *tarjan_stack, tarjan_top;
+static bool *tarjan_on_stack;
+
+static void tarjan(CallGraph* cg, int v) {
+    tarjan_num[v] = tarjan_low[v] = ++tarjan_counter;
+    tarjan_stack[tarjan_top++] = v;
+    tarjan_on_stack[v] = true;
+    CGFunc* f = &cg->funcs[v];
+    for (int i = 0; i < f->ncallees; i++) {
+        int w = f->callees[i];
+        if (w == v) f->recursive = true;
+        if (tarjan_num[w] == 0) {
+            tarjan(cg, w);
+            if (tarjan_low[w] < tarjan_low[v]) tarjan_low[v] = tarjan_low[w];
+        } else if (tarjan_on_stack[w] && tarjan_num[w] < tarjan_low[v]) {
+            tarjan_low[v] = tarjan_num[w];
+        }
+    }
+    if (tarjan_low[v] == tarjan_num[v]) {
+        int size = 0, w;
+        do {
+            w = tarjan_stack[--tarjan_top];
+            tarjan_on_stack[w] = false;
+            cg->funcs[w].scc = cg->nsccs;
+            size++;
+        } while (w != v);
+        if (size > 1) {
+            for (int i = tarjan_top; i < tarjan_top + size; i++) {
+                cg->funcs[tarjan_stack[i]].recursive = true;
+            }
+        }
+        cg->nsccs++;
+    }
+}
+
+static bool operand_in(Operand* set, int size, Operand op) {
+    for (int i = 0; i < size; i++) {
+        if (isOperandEqual(set[i], op)) return true;
+    }
+    return false;
+}
+
+// facts that only depend on the body of f
+static void local_summary(CGFunc* f) {
+    f->leaf = true;
+    f->does_io = false;
+    f->writes_memory = false;
+
+    // operands that may hold a pointer the function was passed
+    int size = 0, capacity = 8;
+    Operand* passed = (Operand*)malloc(sizeof(Operand) * capacity);
+    bool again = true;
+    while (again) {
+        again = false;
+        for (InterCodes* p = f->head; p != f->tail->next; p = p->next) {
+            bool derived = false;
+            switch (p->code.kind) {
+                case IR_PARAM: derived = true; break;
+                case IR_ASSIGN: case IR_SUB: case IR_CMOV:
+                    derived = operand_in(passed, size, p->code.arg1);
+                    break;
+                case IR_ADD:
+                    derived = operand_in(passed, size, p->code.arg1)
+                        || operand_in(passed, size, p->code.arg2);
+                    break;
+                default: break;
+            }
+            if (derived && !operand_in(passed, size, p->code.result)) {
+                if (size == capacity) {
+                    capacity *= 2;
+                    passed = (Operand*)realloc(passed, sizeof(Operand) * capacity);
+                }
+                passed[size++] = p->code.result;
+                again = true;
+            }
+        }
+    }
+
+    for (InterCodes* p = f->head; p != f->tail->next; p = p->next) {
+        switch (p->code.kind) {
+            case IR_CALL: f->leaf = false; break;
+            case IR_READ: case IR_WRITE: f->does_io = true; break;
+            case IR_DEREF_L:
+                if (operand_in(passed, size, p->code.result)) f->writes_memory = true;
+                break;
+            default: break;
+        }
+    }
+    free(passed);
+}
+
+// bottom-up over the SCCs: ids are callees first, so every callee outside
+// the SCC is final by the time the SCC is visited, and the members of the
+// SCC are iterated until they agree with each other
+static void compute_summaries(CallGraph* cg) {
+    for (int i = 0; i < cg->size; i++) {
+        local_summary(&cg->funcs[i]);
+    }
+    // members of SCC s are order[first[s]] .. order[first[s + 1] - 1]
+    int* first = (int*)calloc(cg->nsccs + 1, sizeof(int));
+    int* order = (int*)malloc(sizeof(int) * (cg->size + 1));
+    for (int i = 0; i < cg->size; i++) {
+        first[cg->funcs[i].scc + 1]++;
+    }
+    for (int s = 0; s < cg->nsccs; s++) {
+        first[s + 1] += first[s];
+    }
+    int* next = (int*)malloc(sizeof(int) * (cg->nsccs + 1));
+    memcpy(next, first, sizeof(int) * (cg->nsccs + 1));
+    for (int i = 0; i < cg->size; i++) {
+        order[next[cg->funcs[i].scc]++] = i;
+    }
+    free(next);
+
+    for (int s = 0; s < cg->nsccs; s++) {
+        bool again = true;
+        while (again) {
+            again = false;
+            for (int m = first[s]; m < first[s + 1]; m++) {
+                CGFunc* f = &cg->funcs[order[m]];
+                for (int i = 0; i < f->ncallees; i++) {
+                    CGFunc* callee = &cg->funcs[f->callees[i]];
+                    if (callee->does_io && !f->does_io) {
+                        f->does_io = true;
+                        again = true;
+                    }
+                    if (callee->writes_memory && !f->writes_memory) {
+                        f->writes_memory = true;
+                        again = true;
+                    }
+                }
+            }
+        }
+    }
+    free(first);
+    free(order);
+    for (int i = 0; i < cg->size; i++) {
+        cg->funcs[i].pure = !cg->funcs[i].does_io && !cg->funcs[i].writes_memory;
+    }
+}
+
+static void mark_reachable(CallGraph* cg, int v) {
+    if (cg->funcs[v].reachable) return;
+    cg->funcs[v].reachable = true;
+    for (int i = 0; i < cg->funcs[v].ncallees; i++) {
+        mark_reachable(cg, cg->funcs[v].callees[i]);
+    }
+}
+
+CallGraph* build_call_graph(InterCodes* codes) {
+    CallGraph* cg = (CallGraph*)malloc(sizeof(CallGraph));
+    int capacity = 16;
+    cg->funcs = (CGFunc*)malloc(sizeof(CGFunc) * capacity);
+    cg->size = 0;
+    cg->nsccs = 0;
+
+    CGFunc* f = NULL;
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_FUNC) {
+            if (cg->size == capacity) {
+                capacity *= 2;
+                cg->funcs = (CGFunc*)realloc(cg->funcs, sizeof(CGFunc) * capacity);
+            }
+            f = &cg->funcs[cg->size++];
+            memset(f, 0, sizeof(CGFunc));
+            f->symbol = p->code.result.symbol;
+            f->head = p;
+        }
+        if (f != NULL) {
+            f->tail = p;
+            if (p->code.kind == IR_PARAM) f->nparams++;
+        }
+    }
+
+    cg_indexed = NULL;
+    for (int i = 0; i < cg->size; i++) {
+        f = &cg->funcs[i];
+        for (InterCodes* p = f->head; p != f->tail->next; p = p->next) {
+            if (p->code.kind == IR_CALL) {
+                int callee = cg_find(cg, p->code.arg1.symbol);
+                if (callee >= 0) {
+                    add_callee(f, callee);
+                    add_call(&cg->funcs[callee], p, i);
+                }
+            }
+        }
+    }
+
+    tarjan_counter = tarjan_top = 0;
+    tarjan_num = (int*)calloc(cg->size, sizeof(int));
+    tarjan_low = (int*)calloc(cg->size, sizeof(int));
+    tarjan_stack = (int*)calloc(cg->size, sizeof(int));
+    tarjan_on_stack = (bool*)calloc(cg->size, sizeof(bool));
+    for (int i = 0; i < cg->size; i++) {
+        if (tarjan_num[i] == 0) tarjan(cg, i);
+    }
+    free(tarjan_num);
+    free(tarjan_low);
+    free(tarjan_stack);
+    free(tarjan_on_stack);
+
+    for (int i = 0; i < cg->size; i++) {
+        if (strcmp(cg->funcs[i].symbol->name, "main") == 0) {
+            mark_reachable(cg, i);
+        }
+    }
+    compute_summaries(cg);
+    return cg;
+}
+
+void free_call_graph(CallGraph* cg) {
+    if (cg == NULL) return;
+    for (int i = 0; i < cg->size; i++) {
+        free(cg->funcs[i].callees);
+        free(cg->funcs[i].calls);
+    }
+    free(cg->funcs);
+    if (cg_indexed == cg) cg_indexed = NULL;
+    free(cg);
+}
+
+// unlink FUNCTION ... tail from the list
+static InterCodes* remove_function(InterCodes* codes, CGFunc* f) {
+    InterCodes *before = f->head->prev, *after = f->tail->next;
+    if (before != NULL) {
+        before->next = after;
+    } else {
+        codes = after;
+    }
+    if (after != NULL) {
+        after->prev = before;
+    }
+    return codes;
+}
+
+// the ARGs of a call, first parameter first; false if they do not match
+static bool collect_args(InterCodes* call, int nparams, InterCodes** args) {
+    InterCodes* p = call->prev;
+    for (int i = 0; i < nparams; i++, p = p->prev) {
+        if (p == NULL || p->code.kind != IR_ARG) return false;
+        args[i] = p;
+    }
+    return p == NULL || p->code.kind != IR_ARG;
+}
+
+InterCodes* optimize_call_graph(InterCodes* codes, bool *changed) {
+    *changed = false;
+    CallGraph* cg = build_call_graph(codes);
+    bool has_main = false;
+    for (int i = 0; i < cg->size; i++) {
+        if (strcmp(cg->funcs[i].symbol->name, "main") == 0) has_main = true;
+    }
+    if (!has_main) {
+        free_call_graph(cg);
+        return codes;
+    }
+
+    // functions unreachable from main
+    for (int i = 0; i < cg->size; i++) {
+        if (!cg->funcs[i].reachable) {
+            *changed = true;
+            stats_add("call graph", "functions removed", 1);
+            codes = remove_function(codes, &cg->funcs[i]);
+        }
+    }
+
+    bool* temp_used = (bool*)calloc(variableId + 1, sizeof(bool));
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        Operand uses[3];
+        int n = getUsedOperands(p, uses);
+        for (int i = 0; i < n; i++) {
+            if (uses[i].kind == OP_TEMP) temp_used[uses[i].u.var_id] = true;
+        }
+    }
+
+    for (int i = 0; i < cg->size; i++) {
+        CGFunc* f = &cg->funcs[i];
+        if (!f->reachable || strcmp(f->symbol->name, "main") == 0) continue;
+
+        // call sites that were not removed with their caller
+        int ncall = 0;
+        bool result_used = false;
+        for (int c = 0; c < f->ncalls; c++) {
+            if (!cg->funcs[f->calls[c].caller].reachable) continue;
+            InterCodes* call = f->calls[c].code;
+            if (call->code.result.kind != OP_TEMP || temp_used[call->code.result.u.var_id]) {
+                result_used = true;
+            }
+            f->calls[ncall++] = f->calls[c];
+        }
+        f->ncalls = ncall;
+
+        // unused return value
+        if (!result_used) {
+            for (InterCodes* p = f->head; p != f->tail->next; p = p->next) {
+                if (p->code.kind == IR_RETURN && !(p->code.result.kind == OP_CONSTANT && p->code.result.u.value == 0)) {
+                    *changed = true;
+                    stats_add("call graph", "return values dropped", 1);
+                    p->code.result.kind = OP_CONSTANT;
+                    p->code.result.u.value = 0;
+                }
+            }
+        }
+
+        if (f->nparams == 0) continue;
+        // dead parameters: never read in the body
+        InterCodes** params = (InterCodes**)malloc(sizeof(InterCodes*) * f->nparams);
+        bool* dead = (bool*)malloc(sizeof(bool) * f->nparams);
+        int k = 0, ndead = 0;
+        for (InterCodes* p = f->head; p != f->tail->next; p = p->next) {
+            if (p->code.kind == IR_PARAM) params[k++] = p;
+        }
+        for (k = 0; k < f->nparams; k++) {
+            dead[k] = true;
+            for (InterCodes* p = f->head; p != f->tail->next && dead[k]; p = p->next) {
+                if (p->code.kind == IR_PARAM) continue;
+                Operand uses[3];
+                int n = getUsedOperands(p, uses);
+                for (int u = 0; u < n; u++) {
+                    if (isOperandEqual(uses[u], params[k]->code.result)) dead[k] = false;
+                }
+            }
+            if (dead[k]) ndead++;
+        }
+        if (ndead == 0) {
+            free(params);
+            free(dead);
+            continue;
+        }
+
+        // every call site has to pass exactly nparams ARGs
+        bool mismatch = false;
+        InterCodes** args = (InterCodes**)malloc(sizeof(InterCodes*) * f->nparams * (ncall + 1));
+        for (int c = 0; c < ncall && !mismatch; c++) {
+            mismatch = !collect_args(f->calls[c].code, f->nparams, &args[c * f->nparams]);
+        }
+        if (!mismatch) {
+            for (k = 0; k < f->nparams; k++) {
+                if (!dead[k]) continue;
+                *changed = true;
+                stats_add("call graph", "parameters removed", 1);
+                stats_add("call graph", "arguments removed", ncall);
+                codes = deleteInterCode(codes, params[k]);
+                for (int c = 0; c < ncall; c++) {
+                    codes = deleteInterCode(codes, args[c * f->nparams + k]);
+                }
+            }
+        }
+        free(args);
+        free(params);
+        free(dead);
+    }
+
+    free(temp_used);
+    free_call_graph(cg);
+    return codes;
+}
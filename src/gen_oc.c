@@ -3,8 +3,12 @@
 #include "AST.h"
 #include "debug.h"
 #include "ir.h"
+#include "memstat.h"
 #include "oc.h"
+#include "options.h"
+#include "stats.h"
 #include "sym_table.h"
+#include "timer.h"
 
 #ifdef YYDEBUG
 extern int yydebug;
@@ -17,7 +21,11 @@ extern int yyparse(void);
 extern ASTNode *ASTroot;
 
 int main(int argc, char **argv) {
+    argc = parse_options(argc, argv);
     if (argc < 2) return 1;
+    if (options.time_report || options.time_report_json) timer_start();
+    if (options.stats || options.stats_json) stats_start();
+    if (options.mem_report || options.mem_budget > 0) mem_start(options.mem_budget);
 
     FILE *fin = fopen(argv[1], "r");
     FILE *fout = NULL;
@@ -36,7 +44,10 @@ int main(int argc, char **argv) {
     yydebug = 1;
 #endif
 
+    timer_begin("parse");
     yyparse();
+    timer_end();
+    mem_checkpoint("parse");
 
     // ASTwalk(ASTroot, 0);
 
@@ -67,18 +78,28 @@ int main(int argc, char **argv) {
     memset(write_func->u.func->definition, 0, sizeof(ASTNode));
     insertSymbol(write_func);
 
+    timer_begin("semantic");
     semantic_parse(ASTroot);
+    timer_end();
+    mem_checkpoint("semantic");
 
     // generate_ir(ASTroot);
     // printf("---------------------------\n");
-    generate_oc(ASTroot);
+    generate_oc(ASTroot, argv[1]);
 
     freeAST(ASTroot);
+    mem_checkpoint("free AST");
 
     fclose(fin);
     if (argc == 3) {
         fclose(fout);
     }
 
+    if (options.time_report) timer_report(stderr);
+    if (options.time_report_json) timer_report_json(stderr);
+    if (options.stats) stats_report(stderr);
+    if (options.stats_json) stats_report_json(stderr);
+    if (options.mem_report) mem_report(stderr);
+    if (mem_over_budget(stderr)) return 1;
     return 0;
 }
@@ -0,0 +1,1066 @@
+#include "interp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+// the first words of memory are never part of a frame, so that small
+// addresses such as a null pointer fault
+#define LOW_WORDS 16
+#define MAX_TOKENS 8
+
+// instructions after loading. _VV / _VK: the last operand is a variable /
+// a constant. H_ instructions evaluate an operand form that irsim handles
+// inside a single instruction (&v, *v, two constants) and are not counted.
+#define INTERP_OPS(X) \
+    X(NOP) X(DEC) X(FUNC) X(END) \
+    X(MOV_V) X(MOV_K) X(ADDR) X(LOAD) X(STORE_V) X(STORE_K) \
+    X(ADD_VV) X(ADD_VK) X(SUB_VV) X(SUB_VK) X(SUB_KV) \
+    X(MUL_VV) X(MUL_VK) X(DIV_VV) X(DIV_VK) X(DIV_KV) \
+    X(LT_VV) X(LT_VK) X(LE_VV) X(LE_VK) X(GT_VV) X(GT_VK) \
+    X(GE_VV) X(GE_VK) X(EQ_VV) X(EQ_VK) X(NE_VV) X(NE_VK) \
+    X(GOTO) X(CALL) X(RETURN_V) X(RETURN_K) X(ARG_V) X(ARG_K) X(PARAM) \
+    X(READ) X(WRITE_V) X(WRITE_K) \
+    X(H_MOV_K) X(H_ADDR) X(H_LOAD) X(H_STORE)
+
+#define OP_ENUM(name) OP_##name,
+typedef enum { INTERP_OPS(OP_ENUM) NUM_OPS } InterpOp;
+
+typedef struct {
+    const void* handler;    // set by interp_run
+    InterpOp op;
+    int32_t a, b, c;        // frame slots, constants, function or jump target
+    int line;
+    int src_line;           // from the last "# line N" comment, 0 before the first
+} Ins;
+
+typedef struct {
+    char* name;
+    int entry;              // first instruction after the FUNCTION line, -1 until defined
+    int frame_words;
+    int line;               // first reference
+} Func;
+
+typedef struct {
+    uint32_t hash;
+    int func;
+    int ins;                // first instruction of the block
+} BlockMarker;
+
+struct IrProgram {
+    const char* name;
+    Ins* code;
+    int ncode, code_capacity;
+    Func* funcs;
+    int nfuncs, func_capacity;
+    int main_func;
+    char** text;            // the lines of the IR file, for the annotated listing
+    int ntext, text_capacity;
+    long long* counts;      // executions of each instruction, NULL when not profiling
+    long long* inclusive;   // of a CALL: instructions executed in the calls it made
+    BlockMarker* markers;   // from the "# block <hash>" comments of gen_ir -fprofile-generate
+    int nmarkers, marker_capacity;
+};
+
+// open addressing from names to ints
+typedef struct {
+    char** keys;
+    int* values;
+    int capacity, count;
+} NameTable;
+
+static unsigned hash_name(const char* s) {
+    unsigned h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static int name_find(NameTable* t, const char* name) {
+    if (t->capacity == 0) return -1;
+    for (unsigned i = hash_name(name) & (t->capacity - 1); t->keys[i] != NULL;
+        i = (i + 1) & (t->capacity - 1)) {
+        if (strcmp(t->keys[i], name) == 0) return t->values[i];
+    }
+    return -1;
+}
+
+static void name_insert(NameTable* t, const char* name, int value) {
+    if (2 * (t->count + 1) > t->capacity) {
+        NameTable old = *t;
+        t->capacity = old.capacity ? old.capacity * 2 : 64;
+        t->keys = (char**)calloc(t->capacity, sizeof(char*));
+        t->values = (int*)malloc(sizeof(int) * t->capacity);
+        t->count = 0;
+        for (int i = 0; i < old.capacity; i++) {
+            if (old.keys[i] == NULL) continue;
+            name_insert(t, old.keys[i], old.values[i]);
+            free(old.keys[i]);
+        }
+        free(old.keys);
+        free(old.values);
+    }
+    unsigned i = hash_name(name) & (t->capacity - 1);
+    while (t->keys[i] != NULL) i = (i + 1) & (t->capacity - 1);
+    t->keys[i] = strdup(name);
+    t->values[i] = value;
+    t->count++;
+}
+
+static void name_free(NameTable* t) {
+    for (int i = 0; i < t->capacity; i++) free(t->keys[i]);
+    free(t->keys);
+    free(t->values);
+    memset(t, 0, sizeof(NameTable));
+}
+
+typedef struct {
+    enum { O_CONST, O_VAR, O_ADDR, O_DEREF } kind;
+    int32_t v;              // the constant, or the slot of the variable
+} Opnd;
+
+// state of interp_load
+static struct {
+    IrProgram* prog;
+    int line;
+    int src_line;
+    bool failed;
+    NameTable labels, funcs, vars;
+    int* label_pos;         // instruction of each label, -1 until defined
+    int nlabels, label_capacity;
+    int func;               // function being loaded, -1 before the first
+    int frame_words;
+    int scratch[3];         // slots for H_ results, -1 until needed
+} L;
+
+static void load_error(const char* format, ...) {
+    if (L.failed) return;
+    L.failed = true;
+    va_list ap;
+    va_start(ap, format);
+    fprintf(stderr, "%s:%d: error: ", L.prog->name, L.line);
+    vfprintf(stderr, format, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+}
+
+static void emit(InterpOp op, int32_t a, int32_t b, int32_t c) {
+    IrProgram* p = L.prog;
+    if (p->ncode == p->code_capacity) {
+        p->code_capacity = p->code_capacity ? p->code_capacity * 2 : 256;
+        p->code = (Ins*)realloc(p->code, sizeof(Ins) * p->code_capacity);
+    }
+    Ins* ins = &p->code[p->ncode++];
+    ins->handler = NULL;
+    ins->op = op;
+    ins->a = a;
+    ins->b = b;
+    ins->c = c;
+    ins->line = L.line;
+    ins->src_line = L.src_line;
+}
+
+static bool is_ident(const char* s) {
+    if (!isalpha((unsigned char)*s) && *s != '_') return false;
+    for (s++; *s; s++) {
+        if (!isalnum((unsigned char)*s) && *s != '_') return false;
+    }
+    return true;
+}
+
+static int label_ref(const char* name) {
+    if (!is_ident(name)) {
+        load_error("bad label name '%s'", name);
+        return 0;
+    }
+    int id = name_find(&L.labels, name);
+    if (id >= 0) return id;
+    if (L.nlabels == L.label_capacity) {
+        L.label_capacity = L.label_capacity ? L.label_capacity * 2 : 64;
+        L.label_pos = (int*)realloc(L.label_pos, sizeof(int) * L.label_capacity);
+    }
+    L.label_pos[L.nlabels] = -1;
+    name_insert(&L.labels, name, L.nlabels);
+    return L.nlabels++;
+}
+
+static int func_ref(const char* name) {
+    if (!is_ident(name)) {
+        load_error("bad function name '%s'", name);
+        return 0;
+    }
+    int id = name_find(&L.funcs, name);
+    if (id >= 0) return id;
+    IrProgram* p = L.prog;
+    if (p->nfuncs == p->func_capacity) {
+        p->func_capacity = p->func_capacity ? p->func_capacity * 2 : 16;
+        p->funcs = (Func*)realloc(p->funcs, sizeof(Func) * p->func_capacity);
+    }
+    Func* f = &p->funcs[p->nfuncs];
+    f->name = strdup(name);
+    f->entry = -1;
+    f->frame_words = 0;
+    f->line = L.line;
+    name_insert(&L.funcs, name, p->nfuncs);
+    return p->nfuncs++;
+}
+
+// slot of the variable name in the current frame, given one word on first use
+static int var_slot(const char* name) {
+    if (!is_ident(name)) {
+        load_error("bad variable name '%s'", name);
+        return 0;
+    }
+    int slot = name_find(&L.vars, name);
+    if (slot >= 0) return slot;
+    name_insert(&L.vars, name, L.frame_words);
+    return L.frame_words++;
+}
+
+static int scratch(int k) {
+    if (L.scratch[k] < 0) L.scratch[k] = L.frame_words++;
+    return L.scratch[k];
+}
+
+static Opnd parse_operand(const char* tok) {
+    Opnd o = { O_VAR, 0 };
+    if (tok[0] == '#') {
+        char* end;
+        long long v = strtoll(tok + 1, &end, 10);
+        if (end == tok + 1 || *end != '\0' || v < INT32_MIN || v > INT32_MAX) {
+            load_error("bad constant '%s'", tok);
+        }
+        o.kind = O_CONST;
+        o.v = (int32_t)v;
+        return o;
+    }
+    if (tok[0] == '&') {
+        o.kind = O_ADDR;
+        tok++;
+    } else if (tok[0] == '*') {
+        o.kind = O_DEREF;
+        tok++;
+    }
+    o.v = var_slot(tok);
+    return o;
+}
+
+// o as a variable or a constant, loading &v and *v into scratch slot k
+static Opnd value_of(Opnd o, int k) {
+    if (o.kind == O_ADDR || o.kind == O_DEREF) {
+        int s = scratch(k);
+        emit(o.kind == O_ADDR ? OP_H_ADDR : OP_H_LOAD, s, o.v, 0);
+        o.kind = O_VAR;
+        o.v = s;
+    }
+    return o;
+}
+
+// o as a variable
+static Opnd var_of(Opnd o, int k) {
+    o = value_of(o, k);
+    if (o.kind == O_CONST) {
+        int s = scratch(k);
+        emit(OP_H_MOV_K, s, o.v, 0);
+        o.kind = O_VAR;
+        o.v = s;
+    }
+    return o;
+}
+
+// slot an instruction writes the result d to; a *x result goes to a scratch
+// slot and is stored by finish_dest
+static int dest_slot(Opnd d) {
+    if (d.kind == O_VAR) return d.v;
+    if (d.kind == O_DEREF) return scratch(2);
+    load_error("cannot assign to a constant or an address");
+    return 0;
+}
+
+static void finish_dest(Opnd d) {
+    if (d.kind == O_DEREF) emit(OP_H_STORE, d.v, scratch(2), 0);
+}
+
+static void end_function() {
+    if (L.func >= 0) L.prog->funcs[L.func].frame_words = L.frame_words;
+}
+
+static void load_assign(char** t, int n) {
+    Opnd d = parse_operand(t[0]);
+    if (n == 4 && strcmp(t[2], "CALL") == 0) {
+        int f = func_ref(t[3]);
+        emit(OP_CALL, dest_slot(d), f, 0);
+        finish_dest(d);
+    } else if (n == 3) {
+        Opnd s = parse_operand(t[2]);
+        if (d.kind == O_VAR) {
+            switch (s.kind) {
+                case O_CONST: emit(OP_MOV_K, d.v, s.v, 0); break;
+                case O_VAR: emit(OP_MOV_V, d.v, s.v, 0); break;
+                case O_ADDR: emit(OP_ADDR, d.v, s.v, 0); break;
+                case O_DEREF: emit(OP_LOAD, d.v, s.v, 0); break;
+            }
+        } else if (d.kind == O_DEREF) {
+            s = value_of(s, 0);
+            emit(s.kind == O_CONST ? OP_STORE_K : OP_STORE_V, d.v, s.v, 0);
+        } else {
+            dest_slot(d);
+        }
+    } else if (n == 5 && strlen(t[3]) == 1 && strchr("+-*/", t[3][0]) != NULL) {
+        static const int forms[4][3] = {
+            { OP_ADD_VV, OP_ADD_VK, -1 },
+            { OP_SUB_VV, OP_SUB_VK, OP_SUB_KV },
+            { OP_MUL_VV, OP_MUL_VK, -1 },
+            { OP_DIV_VV, OP_DIV_VK, OP_DIV_KV },
+        };
+        int k = (int)(strchr("+-*/", t[3][0]) - "+-*/");
+        Opnd x = value_of(parse_operand(t[2]), 0);
+        Opnd y = value_of(parse_operand(t[4]), 1);
+        if (x.kind == O_CONST && y.kind == O_CONST) x = var_of(x, 0);
+        if (x.kind == O_CONST && forms[k][2] < 0) {
+            Opnd tmp = x;
+            x = y;
+            y = tmp;
+        }
+        int form = x.kind == O_CONST ? 2 : y.kind == O_CONST ? 1 : 0;
+        emit(forms[k][form], dest_slot(d), x.v, y.v);
+        finish_dest(d);
+    } else {
+        load_error("syntax error");
+    }
+}
+
+static void load_line(char** t, int n) {
+    if (strcmp(t[0], "FUNCTION") == 0) {
+        if (n != 3 || strcmp(t[2], ":") != 0) {
+            load_error("syntax error");
+            return;
+        }
+        int f = func_ref(t[1]);
+        if (L.prog->funcs[f].entry >= 0) {
+            load_error("function %s is defined twice", t[1]);
+            return;
+        }
+        end_function();
+        emit(OP_FUNC, f, 0, 0);
+        L.prog->funcs[f].entry = L.prog->ncode;
+        L.func = f;
+        L.frame_words = 0;
+        name_free(&L.vars);
+        for (int k = 0; k < 3; k++) L.scratch[k] = -1;
+        return;
+    }
+    if (L.func < 0) {
+        load_error("instruction outside of a function");
+        return;
+    }
+    if (strcmp(t[0], "LABEL") == 0) {
+        if (n != 3 || strcmp(t[2], ":") != 0) {
+            load_error("syntax error");
+            return;
+        }
+        int id = label_ref(t[1]);
+        if (L.label_pos[id] >= 0) {
+            load_error("label %s is defined twice", t[1]);
+            return;
+        }
+        L.label_pos[id] = L.prog->ncode;
+        emit(OP_NOP, 0, 0, 0);
+    } else if (strcmp(t[0], "GOTO") == 0 && n == 2) {
+        emit(OP_GOTO, 0, 0, label_ref(t[1]));
+    } else if (strcmp(t[0], "IF") == 0 && n == 6 && strcmp(t[4], "GOTO") == 0) {
+        static const char* relops[] = { "<", "<=", ">", ">=", "==", "!=" };
+        static const int mirror[] = { 2, 3, 0, 1, 4, 5 };
+        int rel = 0;
+        while (rel < 6 && strcmp(t[2], relops[rel]) != 0) rel++;
+        if (rel == 6) {
+            load_error("bad relational operator '%s'", t[2]);
+            return;
+        }
+        Opnd x = value_of(parse_operand(t[1]), 0);
+        Opnd y = value_of(parse_operand(t[3]), 1);
+        if (x.kind == O_CONST && y.kind == O_CONST) x = var_of(x, 0);
+        if (x.kind == O_CONST) {
+            Opnd tmp = x;
+            x = y;
+            y = tmp;
+            rel = mirror[rel];
+        }
+        emit(OP_LT_VV + 2 * rel + (y.kind == O_CONST), x.v, y.v, label_ref(t[5]));
+    } else if ((strcmp(t[0], "RETURN") == 0 || strcmp(t[0], "WRITE") == 0
+        || strcmp(t[0], "ARG") == 0) && n == 2) {
+        Opnd v = value_of(parse_operand(t[1]), 0);
+        InterpOp op = t[0][0] == 'R' ? OP_RETURN_V : t[0][0] == 'W' ? OP_WRITE_V : OP_ARG_V;
+        emit(op + (v.kind == O_CONST), v.v, 0, 0);
+    } else if ((strcmp(t[0], "READ") == 0 || strcmp(t[0], "PARAM") == 0) && n == 2) {
+        Opnd d = parse_operand(t[1]);
+        emit(t[0][0] == 'R' ? OP_READ : OP_PARAM, dest_slot(d), 0, 0);
+        finish_dest(d);
+    } else if (strcmp(t[0], "DEC") == 0 && n == 3) {
+        char* end;
+        long size = strtol(t[2], &end, 10);
+        if (*end != '\0' || size <= 0 || size % 4 != 0) {
+            load_error("bad size '%s'", t[2]);
+            return;
+        }
+        if (!is_ident(t[1]) || name_find(&L.vars, t[1]) >= 0) {
+            load_error("bad or already used name '%s' in DEC", t[1]);
+            return;
+        }
+        name_insert(&L.vars, t[1], L.frame_words);
+        emit(OP_DEC, L.frame_words, 0, 0);
+        L.frame_words += size / 4;
+    } else if (n >= 3 && strcmp(t[1], ":=") == 0) {
+        load_assign(t, n);
+    } else {
+        load_error("syntax error");
+    }
+}
+
+static bool is_jump(InterpOp op) {
+    return op == OP_GOTO || (op >= OP_LT_VV && op <= OP_NE_VK);
+}
+
+IrProgram* interp_load(FILE* in, const char* name) {
+    memset(&L, 0, sizeof(L));
+    L.prog = (IrProgram*)calloc(1, sizeof(IrProgram));
+    L.prog->name = name;
+    L.func = -1;
+
+    char* line = NULL;
+    size_t len = 0;
+    while (!L.failed && getline(&line, &len, in) != -1) {
+        L.line++;
+        IrProgram* p = L.prog;
+        if (p->ntext == p->text_capacity) {
+            p->text_capacity = p->text_capacity ? p->text_capacity * 2 : 256;
+            p->text = (char**)realloc(p->text, sizeof(char*) * p->text_capacity);
+        }
+        p->text[p->ntext++] = strndup(line, strcspn(line, "\r\n"));
+        char* t[MAX_TOKENS + 1];
+        int n = 0;
+        for (char* tok = strtok(line, " \t\r\n"); tok != NULL && n <= MAX_TOKENS;
+            tok = strtok(NULL, " \t\r\n")) {
+            t[n++] = tok;
+        }
+        if (n == 3 && strcmp(t[0], "#") == 0 && strcmp(t[1], "line") == 0) {
+            L.src_line = atoi(t[2]);
+            continue;
+        }
+        if (n == 3 && strcmp(t[0], "#") == 0 && strcmp(t[1], "block") == 0 && L.func >= 0) {
+            if (p->nmarkers == p->marker_capacity) {
+                p->marker_capacity = p->marker_capacity ? p->marker_capacity * 2 : 256;
+                p->markers = (BlockMarker*)realloc(p->markers, sizeof(BlockMarker) * p->marker_capacity);
+            }
+            p->markers[p->nmarkers++] = (BlockMarker){ (uint32_t)strtoul(t[2], NULL, 16), L.func, p->ncode };
+            continue;
+        }
+        if (n == 0 || t[0][0] == '#') continue;
+        if (n > MAX_TOKENS) {
+            load_error("syntax error");
+            break;
+        }
+        load_line(t, n);
+    }
+    free(line);
+    end_function();
+    emit(OP_END, 0, 0, 0);
+
+    IrProgram* p = L.prog;
+    for (int i = 0; i < p->ncode && !L.failed; i++) {
+        if (!is_jump(p->code[i].op)) continue;
+        // a jump skips the LABEL itself, which irsim only counts when
+        // falling through it
+        int pos = L.label_pos[p->code[i].c];
+        L.line = p->code[i].line;
+        if (pos < 0) load_error("undefined label");
+        p->code[i].c = pos + 1;
+    }
+    for (int f = 0; f < p->nfuncs && !L.failed; f++) {
+        L.line = p->funcs[f].line;
+        if (p->funcs[f].entry < 0) load_error("undefined function %s", p->funcs[f].name);
+    }
+    p->main_func = name_find(&L.funcs, "main");
+    if (!L.failed && p->main_func < 0) {
+        L.line = 0;
+        load_error("no main function");
+    }
+
+    name_free(&L.labels);
+    name_free(&L.funcs);
+    name_free(&L.vars);
+    free(L.label_pos);
+    if (L.failed) {
+        interp_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void interp_free(IrProgram* prog) {
+    if (prog == NULL) return;
+    for (int f = 0; f < prog->nfuncs; f++) free(prog->funcs[f].name);
+    for (int i = 0; i < prog->ntext; i++) free(prog->text[i]);
+    free(prog->text);
+    free(prog->funcs);
+    free(prog->code);
+    free(prog->counts);
+    free(prog->inclusive);
+    free(prog->markers);
+    free(prog);
+}
+
+void interp_profile(IrProgram* prog) {
+    free(prog->counts);
+    free(prog->inclusive);
+    prog->counts = (long long*)calloc(prog->ncode, sizeof(long long));
+    prog->inclusive = (long long*)calloc(prog->ncode, sizeof(long long));
+}
+
+// the instructions irsim counts, see steps in interp_run; of the FUNCTION
+// lines only that of main is, once, when the run starts at it
+static bool is_counted(InterpOp op) {
+    return op != OP_END && op < OP_H_MOV_K;
+}
+
+typedef struct {
+    int line;
+    long long cost;
+} LineCost;
+
+static int by_cost(const void* a, const void* b) {
+    const LineCost *x = (const LineCost*)a, *y = (const LineCost*)b;
+    if (x->cost != y->cost) return x->cost < y->cost ? 1 : -1;
+    return x->line - y->line;
+}
+
+void interp_report_lines(IrProgram* prog, FILE* out) {
+    if (prog->counts == NULL) return;
+    int nlines = 1;
+    for (int i = 0; i < prog->ncode; i++) {
+        if (prog->code[i].src_line >= nlines) nlines = prog->code[i].src_line + 1;
+    }
+    LineCost* lines = (LineCost*)calloc(nlines, sizeof(LineCost));
+    long long total = 0;
+    for (int i = 0; i < nlines; i++) lines[i].line = i;
+    for (int i = 0; i < prog->ncode; i++) {
+        if (!is_counted(prog->code[i].op)) continue;
+        lines[prog->code[i].src_line].cost += prog->counts[i];
+        total += prog->counts[i];
+    }
+    qsort(lines, nlines, sizeof(LineCost), by_cost);
+    fprintf(out, "%-8s %14s %8s\n", "line", "instructions", "%");
+    for (int i = 0; i < nlines && lines[i].cost > 0; i++) {
+        char name[16];
+        if (lines[i].line == 0) {
+            snprintf(name, sizeof(name), "?");
+        } else {
+            snprintf(name, sizeof(name), "%d", lines[i].line);
+        }
+        fprintf(out, "%-8s %14lld %8.2f\n", name, lines[i].cost, 100.0 * lines[i].cost / total);
+    }
+    free(lines);
+}
+
+// execution counts of an IR line: what its instruction did, and for a
+// LABEL how often control passed it (falling through or jumping past it)
+static long long text_count(IrProgram* prog, int i) {
+    if (prog->code[i].op == OP_NOP && i + 1 < prog->ncode) return prog->counts[i + 1];
+    return prog->counts[i];
+}
+
+typedef struct {
+    int func;
+    long long calls, self, inclusive;
+    int first_text, last_text;  // lines of the IR file from the FUNCTION line, counted from 0
+} FuncProfile;
+
+typedef struct {
+    int caller, callee;
+    long long calls, inclusive;
+} EdgeProfile;
+
+typedef struct {
+    int func, first, last;      // instructions
+    int src_min, src_max;       // source lines, 0 if unknown
+    long long executions, cost;
+} BlockProfile;
+
+static int func_by_cost(const void* a, const void* b) {
+    const FuncProfile *x = (const FuncProfile*)a, *y = (const FuncProfile*)b;
+    if (x->self != y->self) return x->self < y->self ? 1 : -1;
+    return x->func - y->func;
+}
+
+static int edge_by_pair(const void* a, const void* b) {
+    const EdgeProfile *x = (const EdgeProfile*)a, *y = (const EdgeProfile*)b;
+    if (x->caller != y->caller) return x->caller - y->caller;
+    return x->callee - y->callee;
+}
+
+static int edge_by_calls(const void* a, const void* b) {
+    const EdgeProfile *x = (const EdgeProfile*)a, *y = (const EdgeProfile*)b;
+    if (x->calls != y->calls) return x->calls < y->calls ? 1 : -1;
+    return edge_by_pair(a, b);
+}
+
+static int block_by_cost(const void* a, const void* b) {
+    const BlockProfile *x = (const BlockProfile*)a, *y = (const BlockProfile*)b;
+    if (x->cost != y->cost) return x->cost < y->cost ? 1 : -1;
+    return x->first - y->first;
+}
+
+static double percent(long long part, long long total) {
+    return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+void interp_report_profile(IrProgram* prog, FILE* out, int max_blocks) {
+    if (prog->counts == NULL) return;
+    Ins* code = prog->code;
+    long long* counts = prog->counts;
+    int nfuncs = prog->nfuncs;
+
+    // functions: instructions from the entry to the next FUNCTION
+    FuncProfile* funcs = (FuncProfile*)calloc(nfuncs, sizeof(FuncProfile));
+    int* owner = (int*)malloc(sizeof(int) * prog->ncode);
+    long long total = 0;
+    int cur = -1;
+    for (int f = 0; f < nfuncs; f++) {
+        funcs[f].func = f;
+        funcs[f].first_text = prog->ntext;
+    }
+    for (int i = 0; i < prog->ncode; i++) {
+        if (code[i].op == OP_FUNC) {
+            cur = code[i].a;
+            funcs[cur].first_text = code[i].line - 1;
+        }
+        owner[i] = cur;
+        if (cur < 0 || code[i].op == OP_END) continue;
+        if (is_counted(code[i].op)) {
+            funcs[cur].self += counts[i];
+            total += counts[i];
+        }
+    }
+    // the listing of a function ends before the next FUNCTION line
+    for (int f = 0; f < nfuncs; f++) {
+        int next = prog->ntext;
+        for (int g = 0; g < nfuncs; g++) {
+            if (funcs[g].first_text > funcs[f].first_text && funcs[g].first_text < next) next = funcs[g].first_text;
+        }
+        funcs[f].last_text = next - 1;
+    }
+
+    // call graph edges from the CALL instructions
+    int nedges = 0;
+    EdgeProfile* edges = (EdgeProfile*)malloc(sizeof(EdgeProfile) * (prog->ncode + 1));
+    for (int i = 0; i < prog->ncode; i++) {
+        if (code[i].op != OP_CALL || counts[i] == 0) continue;
+        edges[nedges++] = (EdgeProfile){ owner[i], code[i].b, counts[i], prog->inclusive[i] };
+        funcs[code[i].b].calls += counts[i];
+        funcs[code[i].b].inclusive += prog->inclusive[i];
+    }
+    funcs[prog->main_func].calls = 1;
+    funcs[prog->main_func].inclusive = total;
+    qsort(edges, nedges, sizeof(EdgeProfile), edge_by_pair);
+    int merged = 0;
+    for (int i = 0; i < nedges; i++) {
+        if (merged > 0 && edge_by_pair(&edges[merged - 1], &edges[i]) == 0) {
+            edges[merged - 1].calls += edges[i].calls;
+            edges[merged - 1].inclusive += edges[i].inclusive;
+        } else {
+            edges[merged++] = edges[i];
+        }
+    }
+    nedges = merged;
+    qsort(edges, nedges, sizeof(EdgeProfile), edge_by_calls);
+
+    // basic blocks start at a function entry, after a jump or return, and
+    // after a LABEL: jumps land past the LABEL, which is only executed when
+    // falling through and stays with the code before it
+    int nblocks = 0;
+    BlockProfile* blocks = (BlockProfile*)malloc(sizeof(BlockProfile) * (prog->ncode + 1));
+    for (int i = 0; i < prog->ncode; i++) {
+        InterpOp op = code[i].op;
+        if (op == OP_FUNC || op == OP_END) continue;
+        InterpOp prev = code[i - 1].op;
+        bool leader = prev == OP_FUNC || (op != OP_NOP && (prev == OP_NOP || is_jump(prev)
+            || prev == OP_RETURN_V || prev == OP_RETURN_K));
+        if (leader) {
+            blocks[nblocks++] = (BlockProfile){ owner[i], i, i, 0, 0, counts[i], 0 };
+        }
+        BlockProfile* b = &blocks[nblocks - 1];
+        if (op != OP_NOP) {
+            b->last = i;
+            int src = code[i].src_line;
+            if (src > 0 && (b->src_min == 0 || src < b->src_min)) b->src_min = src;
+            if (src > b->src_max) b->src_max = src;
+        }
+        if (is_counted(op)) b->cost += counts[i];
+    }
+    qsort(blocks, nblocks, sizeof(BlockProfile), block_by_cost);
+    qsort(funcs, nfuncs, sizeof(FuncProfile), func_by_cost);
+
+    fprintf(out, "flat profile: %lld instructions\n\n", total);
+    fprintf(out, "%-20s %10s %14s %8s %14s %8s %10s\n", "function", "calls", "self", "self %",
+        "inclusive", "incl %", "self/call");
+    for (int i = 0; i < nfuncs; i++) {
+        FuncProfile* fp = &funcs[i];
+        if (fp->calls == 0) continue;
+        fprintf(out, "%-20s %10lld %14lld %8.2f %14lld %8.2f %10.1f\n", prog->funcs[fp->func].name,
+            fp->calls, fp->self, percent(fp->self, total), fp->inclusive, percent(fp->inclusive, total),
+            (double)fp->self / fp->calls);
+    }
+
+    fprintf(out, "\ncall graph\n\n%-20s %-20s %10s %14s %8s\n", "caller", "callee", "calls", "inclusive", "incl %");
+    for (int i = 0; i < nedges; i++) {
+        fprintf(out, "%-20s %-20s %10lld %14lld %8.2f\n", prog->funcs[edges[i].caller].name,
+            prog->funcs[edges[i].callee].name, edges[i].calls, edges[i].inclusive,
+            percent(edges[i].inclusive, total));
+    }
+
+    fprintf(out, "\nhottest basic blocks\n\n%-20s %-12s %-12s %12s %14s %8s\n", "function", "IR lines",
+        "source", "executions", "instructions", "%");
+    for (int i = 0; i < nblocks && i < max_blocks && blocks[i].cost > 0; i++) {
+        BlockProfile* b = &blocks[i];
+        char lines[32], source[32] = "-";
+        snprintf(lines, sizeof(lines), "%d-%d", code[b->first].line, code[b->last].line);
+        if (b->src_min > 0) snprintf(source, sizeof(source), "%d-%d", b->src_min, b->src_max);
+        fprintf(out, "%-20s %-12s %-12s %12lld %14lld %8.2f\n", prog->funcs[b->func].name, lines, source,
+            b->executions, b->cost, percent(b->cost, total));
+    }
+
+    // executions of each line of the IR file, by function, most expensive first
+    long long* text_counts = (long long*)calloc(prog->ntext + 1, sizeof(long long));
+    bool* executable = (bool*)calloc(prog->ntext + 1, sizeof(bool));
+    for (int i = 0; i < prog->ncode; i++) {
+        if (code[i].op == OP_FUNC || code[i].op == OP_END) continue;
+        int t = code[i].line - 1;
+        long long c = text_count(prog, i);
+        executable[t] = true;
+        if (c > text_counts[t]) text_counts[t] = c;
+    }
+    fprintf(out, "\nannotated IR\n");
+    for (int i = 0; i < nfuncs; i++) {
+        FuncProfile* fp = &funcs[i];
+        if (fp->calls == 0) continue;
+        fprintf(out, "\n%12s %8s   %s: %lld calls, %.2f%% self\n", "count", "%", prog->funcs[fp->func].name,
+            fp->calls, percent(fp->self, total));
+        for (int t = fp->first_text; t <= fp->last_text && t < prog->ntext; t++) {
+            if (executable[t]) {
+                fprintf(out, "%12lld %8.2f   %s\n", text_counts[t], percent(text_counts[t], total), prog->text[t]);
+            } else {
+                fprintf(out, "%12s %8s   %s\n", "", "", prog->text[t]);
+            }
+        }
+    }
+
+    free(text_counts);
+    free(executable);
+    free(blocks);
+    free(edges);
+    free(owner);
+    free(funcs);
+}
+
+void interp_write_block_counts(IrProgram* prog, FILE* out) {
+    if (prog->counts == NULL) return;
+    Ins* code = prog->code;
+    fprintf(out, "# block counts of %s\n", prog->name);
+    for (int m = 0; m < prog->nmarkers; m++) {
+        BlockMarker* b = &prog->markers[m];
+        if (m == 0 || prog->markers[m - 1].func != b->func) fprintf(out, "function %s\n", prog->funcs[b->func].name);
+        // the block ends at the next marker or FUNCTION; the LABELs of the
+        // next block come before its marker
+        int end = m + 1 < prog->nmarkers ? prog->markers[m + 1].ins : prog->ncode;
+        int last = b->ins;
+        for (int i = b->ins; i < end && code[i].op != OP_FUNC && code[i].op != OP_END; i++) {
+            if (code[i].op != OP_NOP) last = i;
+        }
+        fprintf(out, "block %08x %lld ", b->hash, prog->counts[b->ins]);
+        if (is_jump(code[last].op) && code[last].op != OP_GOTO) {
+            fprintf(out, "%lld\n", prog->counts[last] - prog->counts[last + 1]);
+        } else {
+            fprintf(out, "-\n");
+        }
+    }
+}
+
+typedef struct {
+    Ins* ret;
+    uint32_t fpi;           // frame of the caller
+    int32_t result;         // slot of the caller the value is returned to
+    long long start;        // steps after the CALL, for the inclusive counts of the profile
+} CallRecord;
+
+int interp_run(IrProgram* prog, FILE* input, FILE* output, InterpStats* stats) {
+#define OP_LABEL(name) &&do_##name,
+    static const void* const handlers[] = { INTERP_OPS(OP_LABEL) };
+#undef OP_LABEL
+    Ins* code = prog->code;
+    long long* counts = prog->counts;
+    // when profiling, every instruction first goes through do_PROFILE, and
+    // calls and returns through their own entries that keep the number of
+    // active calls of each function
+    int* active = NULL;
+    for (int i = 0; i < prog->ncode; i++) {
+        InterpOp op = code[i].op;
+        if (counts == NULL) {
+            code[i].handler = handlers[op];
+        } else if (op == OP_CALL) {
+            code[i].handler = &&do_PROFILE_CALL;
+        } else if (op == OP_RETURN_V || op == OP_RETURN_K) {
+            code[i].handler = &&do_PROFILE_RETURN;
+        } else {
+            code[i].handler = &&do_PROFILE;
+        }
+    }
+    if (counts != NULL) {
+        active = (int*)calloc(prog->nfuncs, sizeof(int));
+        counts[prog->funcs[prog->main_func].entry - 1]++;
+    }
+
+    int32_t* mem = (int32_t*)calloc(INTERP_STACK_WORDS, sizeof(int32_t));
+    int call_capacity = 64, arg_capacity = 64, depth = 0, nargs = 0, max_depth = 0;
+    CallRecord* calls = (CallRecord*)malloc(sizeof(CallRecord) * call_capacity);
+    int32_t* args = (int32_t*)malloc(sizeof(int32_t) * arg_capacity);
+    const char* error = NULL;
+    int status = 0;
+    int32_t v;
+
+    // irsim counts the FUNCTION line of main it starts at
+    long long steps = 1, ncalls = 0, nloads = 0, nstores = 0;
+    Func* f = &prog->funcs[prog->main_func];
+    uint32_t fpi = LOW_WORDS, sp = LOW_WORDS + f->frame_words;
+    int32_t* fp = mem + fpi;
+    Ins* ip = code + f->entry;
+    if (sp > INTERP_STACK_WORDS) {
+        error = "stack overflow";
+        goto fail;
+    }
+
+#define NEXT() goto *(++ip)->handler
+#define JUMP(target) do { ip = code + (target); goto *ip->handler; } while (0)
+#define FAIL(msg) do { error = msg; goto fail; } while (0)
+// addr is the byte address of a word in a live frame
+#define CHECK_ADDR(addr) \
+    if (((uint32_t)(addr) & 3) || (uint32_t)(addr) - 4 * LOW_WORDS >= 4 * (sp - LOW_WORDS)) \
+        FAIL("bad address")
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+#define BRANCH(name, x, rel, y) \
+    do_##name: steps++; if (x rel y) JUMP(ip->c); NEXT();
+
+    goto *ip->handler;
+
+do_PROFILE:
+    counts[ip - code]++;
+    goto *handlers[ip->op];
+do_PROFILE_CALL:
+    counts[ip - code]++;
+    active[ip->b]++;
+    goto do_CALL;
+do_PROFILE_RETURN:
+    counts[ip - code]++;
+    if (depth > 0) {
+        // a recursive call is already part of the outermost one
+        Ins* call = calls[depth - 1].ret - 1;
+        if (--active[call->b] == 0) prog->inclusive[call - code] += steps + 1 - calls[depth - 1].start;
+    }
+    goto *handlers[ip->op];
+do_NOP:
+do_DEC:
+    steps++;
+    NEXT();
+do_FUNC:
+    FAIL("reached the next FUNCTION without RETURN");
+do_END:
+    FAIL("reached the end of the program without RETURN");
+do_MOV_V:
+    steps++;
+    fp[ip->a] = fp[ip->b];
+    NEXT();
+do_MOV_K:
+    steps++;
+    fp[ip->a] = ip->b;
+    NEXT();
+do_ADDR:
+    steps++;
+do_H_ADDR:
+    fp[ip->a] = (int32_t)(4 * (fpi + ip->b));
+    NEXT();
+do_LOAD:
+    steps++;
+do_H_LOAD:
+    nloads++;
+    v = fp[ip->b];
+    CHECK_ADDR(v);
+    fp[ip->a] = mem[(uint32_t)v >> 2];
+    NEXT();
+do_STORE_V:
+    steps++;
+do_H_STORE:
+    nstores++;
+    v = fp[ip->a];
+    CHECK_ADDR(v);
+    mem[(uint32_t)v >> 2] = fp[ip->b];
+    NEXT();
+do_STORE_K:
+    steps++;
+    nstores++;
+    v = fp[ip->a];
+    CHECK_ADDR(v);
+    mem[(uint32_t)v >> 2] = ip->b;
+    NEXT();
+do_H_MOV_K:
+    fp[ip->a] = ip->b;
+    NEXT();
+do_ADD_VV:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] + (uint32_t)fp[ip->c]);
+    NEXT();
+do_ADD_VK:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] + (uint32_t)ip->c);
+    NEXT();
+do_SUB_VV:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] - (uint32_t)fp[ip->c]);
+    NEXT();
+do_SUB_VK:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] - (uint32_t)ip->c);
+    NEXT();
+do_SUB_KV:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)ip->b - (uint32_t)fp[ip->c]);
+    NEXT();
+do_MUL_VV:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] * (uint32_t)fp[ip->c]);
+    NEXT();
+do_MUL_VK:
+    steps++;
+    fp[ip->a] = WRAP((uint32_t)fp[ip->b] * (uint32_t)ip->c);
+    NEXT();
+do_DIV_VV:
+    v = fp[ip->c];
+    goto divide;
+do_DIV_VK:
+    v = ip->c;
+    goto divide;
+do_DIV_KV:
+    v = fp[ip->c];
+    if (v == 0) FAIL("division by zero");
+    steps++;
+    // INT_MIN / -1 wraps around like the other operators
+    fp[ip->a] = v == -1 ? WRAP(0u - (uint32_t)ip->b) : ip->b / v;
+    NEXT();
+divide:
+    if (v == 0) FAIL("division by zero");
+    steps++;
+    fp[ip->a] = v == -1 ? WRAP(0u - (uint32_t)fp[ip->b]) : fp[ip->b] / v;
+    NEXT();
+BRANCH(LT_VV, fp[ip->a], <, fp[ip->b])
+BRANCH(LT_VK, fp[ip->a], <, ip->b)
+BRANCH(LE_VV, fp[ip->a], <=, fp[ip->b])
+BRANCH(LE_VK, fp[ip->a], <=, ip->b)
+BRANCH(GT_VV, fp[ip->a], >, fp[ip->b])
+BRANCH(GT_VK, fp[ip->a], >, ip->b)
+BRANCH(GE_VV, fp[ip->a], >=, fp[ip->b])
+BRANCH(GE_VK, fp[ip->a], >=, ip->b)
+BRANCH(EQ_VV, fp[ip->a], ==, fp[ip->b])
+BRANCH(EQ_VK, fp[ip->a], ==, ip->b)
+BRANCH(NE_VV, fp[ip->a], !=, fp[ip->b])
+BRANCH(NE_VK, fp[ip->a], !=, ip->b)
+do_GOTO:
+    steps++;
+    JUMP(ip->c);
+do_CALL:
+    steps++;
+    ncalls++;
+    if (depth == call_capacity) {
+        call_capacity *= 2;
+        calls = (CallRecord*)realloc(calls, sizeof(CallRecord) * call_capacity);
+    }
+    calls[depth].ret = ip + 1;
+    calls[depth].fpi = fpi;
+    calls[depth].result = ip->a;
+    calls[depth].start = steps;
+    if (++depth > max_depth) max_depth = depth;
+    f = &prog->funcs[ip->b];
+    if (sp + f->frame_words > INTERP_STACK_WORDS) FAIL("stack overflow");
+    fpi = sp;
+    sp += f->frame_words;
+    fp = mem + fpi;
+    memset(fp, 0, sizeof(int32_t) * f->frame_words);
+    JUMP(f->entry);
+do_RETURN_V:
+    v = fp[ip->a];
+    goto do_return;
+do_RETURN_K:
+    v = ip->a;
+do_return:
+    steps++;
+    if (depth == 0) goto done;
+    depth--;
+    sp = fpi;
+    fpi = calls[depth].fpi;
+    fp = mem + fpi;
+    fp[calls[depth].result] = v;
+    ip = calls[depth].ret;
+    goto *ip->handler;
+do_ARG_V:
+    v = fp[ip->a];
+    goto push_arg;
+do_ARG_K:
+    v = ip->a;
+push_arg:
+    steps++;
+    if (nargs == arg_capacity) {
+        arg_capacity *= 2;
+        args = (int32_t*)realloc(args, sizeof(int32_t) * arg_capacity);
+    }
+    args[nargs++] = v;
+    NEXT();
+do_PARAM:
+    if (nargs == 0) FAIL("PARAM without a matching ARG");
+    steps++;
+    fp[ip->a] = args[--nargs];
+    NEXT();
+do_READ:
+    if (fscanf(input, "%d", &v) != 1) FAIL("READ after the end of the input");
+    steps++;
+    fp[ip->a] = v;
+    NEXT();
+do_WRITE_V:
+    v = fp[ip->a];
+    goto write;
+do_WRITE_K:
+    v = ip->a;
+write:
+    steps++;
+    fprintf(output, "%d\n", v);
+    NEXT();
+
+fail:
+    fprintf(stderr, "%s:%d: runtime error: %s\n", prog->name, ip->line, error);
+    status = 1;
+done:
+    if (stats != NULL) {
+        stats->instructions = steps;
+        stats->loads = nloads;
+        stats->stores = nstores;
+        stats->calls = ncalls;
+        stats->max_depth = max_depth + 1;
+    }
+    free(active);
+    free(args);
+    free(calls);
+    free(mem);
+    return status;
+#undef NEXT
+#undef JUMP
+#undef FAIL
+#undef CHECK_ADDR
+#undef WRAP
+#undef BRANCH
+}
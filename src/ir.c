@@ -2,22 +2,35 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 #include "AST.h"
 #include "ir.h"
+#include "call_graph.h"
 #include "sym_table.h"
 #include "debug.h"
+#include "options.h"
+#include "timer.h"
+#include "stats.h"
+#include "memstat.h"
+#include "pgo.h"
+
+// source line of the statement, declaration or expression being
+// translated, given to every instruction made for it
+static int currentLine = 0;
 
 InterCodes* newInterCodes() {
-    InterCodes* p = (InterCodes*)malloc(sizeof(InterCodes));
+    InterCodes* p = (InterCodes*)mem_alloc(MEM_IR, sizeof(InterCodes));
     p->next = p->prev = NULL;
     p->code.result.u.var_id = -1;
     p->code.arg1.u.var_id = -1;
     p->code.arg2.u.var_id = -1;
+    p->code.lineno = currentLine;
+    p->code.wraps = false;
     return p;
 }
 
 ArgNode* newArgNode(int var_id) {
-    ArgNode *arg = (ArgNode*)malloc(sizeof(ArgNode));
+    ArgNode *arg = (ArgNode*)mem_alloc(MEM_IR, sizeof(ArgNode));
     arg->next = NULL;
     arg->var_id = var_id;
     return arg;
@@ -28,9 +41,9 @@ int newVariableId() {
     return variableId++;
 }
 
+int labelId = 1;
 int newLabelId() {
-    static int id = 1;
-    return id++;
+    return labelId++;
 }
 
 static InterCodes* getInterCodesTail(InterCodes* head) {
@@ -97,6 +110,16 @@ InterCodes* deleteInterCode(InterCodes *head, InterCodes *del) {
     return newHead;
 }
 
+// pos must not be the head of the list; codes made by the optimizer take
+// the source line of pos
+static void insertBefore(InterCodes* pos, InterCodes* codes) {
+    if (codes->code.lineno == 0) codes->code.lineno = pos->code.lineno;
+    codes->prev = pos->prev;
+    codes->next = pos;
+    pos->prev->next = codes;
+    pos->prev = codes;
+}
+
 InterCodes* genLabelCode(int label_id) {
     InterCodes* codes = newInterCodes();
     codes->code.kind = IR_LABEL;
@@ -113,6 +136,32 @@ InterCodes* genGotoCode(int label_id) {
     return codes;
 }
 
+static Operand tempOperand(int var_id) {
+    Operand op;
+    op.kind = OP_TEMP;
+    op.u.var_id = var_id;
+    op.symbol = NULL;
+    return op;
+}
+
+static Operand constantOperand(int value) {
+    Operand op;
+    op.kind = OP_CONSTANT;
+    op.u.value = value;
+    op.symbol = NULL;
+    return op;
+}
+
+InterCodes* genSetRelCode(int place, enum RELOP_TYPE relop, Operand arg1, Operand arg2) {
+    InterCodes* codes = newInterCodes();
+    codes->code.kind = IR_SETREL;
+    codes->code.relop = relop;
+    codes->code.result = tempOperand(place);
+    codes->code.arg1 = arg1;
+    codes->code.arg2 = arg2;
+    return codes;
+}
+
 enum RELOP_TYPE get_relop(ASTNode *RELOP) {
     assert(RELOP);
     assert(RELOP->type == AST_RELOP);
@@ -146,10 +195,60 @@ enum RELOP_TYPE get_reverse_relop(enum RELOP_TYPE relop) {
     }
 }
 
+// relop with its operands swapped: a < b  <=>  b > a
+enum RELOP_TYPE get_mirror_relop(enum RELOP_TYPE relop) {
+    switch (relop) {
+        case RELOP_LT: return RELOP_GT;
+        case RELOP_LE: return RELOP_GE;
+        case RELOP_GT: return RELOP_LT;
+        case RELOP_GE: return RELOP_LE;
+        default: return relop;
+    }
+}
+
+// whether Exp can be evaluated even when the source would not evaluate it:
+// no calls, assignments or memory accesses, and no arithmetic, which may
+// trap (add and sub on overflow, div on zero)
+static bool isSpeculatable(ASTNode *Exp) {
+    assert(Exp->type == AST_Exp);
+    ASTNode* first = Exp->child;
+    if (first->type == AST_INT) return true;
+    if (first->type == AST_ID) return first->sibling == NULL;
+    if (first->type == AST_LP) return isSpeculatable(first->sibling);
+    if (first->type == AST_NOT) return isSpeculatable(first->sibling);
+    if (first->type != AST_Exp) return false;
+    switch (first->sibling->type) {
+        case AST_RELOP: case AST_AND: case AST_OR:
+            return isSpeculatable(first) && isSpeculatable(first->sibling->sibling);
+        default:
+            return false;
+    }
+}
+
+static bool isBooleanExp(ASTNode *Exp) {
+    return Exp->child->type == AST_NOT
+        || (Exp->child->sibling != NULL && (Exp->child->sibling->type == AST_RELOP
+            || Exp->child->sibling->type == AST_AND || Exp->child->sibling->type == AST_OR))
+        || (Exp->child->type == AST_LP && isBooleanExp(Exp->child->sibling));
+}
+
+// place := Exp != 0, as 0 or 1
+static InterCodes* translate_Bool(ASTNode *Exp, int place) {
+    if (isBooleanExp(Exp)) {
+        return translate_Exp(Exp, place);
+    }
+    int t1 = newVariableId();
+    InterCodes* code1 = translate_Exp(Exp, t1);
+    InterCodes* code2 = genSetRelCode(place, RELOP_NE, tempOperand(t1), constantOperand(0));
+    return concatInterCodes(2, code1, code2);
+}
+
 InterCodes* translate_Exp(ASTNode* Exp, int place) {
     assert(Exp);
     assert(Exp->type == AST_Exp);
 
+    int line = currentLine;
+    currentLine = Exp->lineno;
     InterCodes* codes = newInterCodes();
     if (Exp->child->type == AST_INT) { // Exp -> INT
         codes->code.kind = IR_ASSIGN;
@@ -359,10 +458,47 @@ InterCodes* translate_Exp(ASTNode* Exp, int place) {
         code2->code.arg2.u.var_id = t1;
 
         codes = concatInterCodes(2, code1, code2);
-    } else if (Exp->child->sibling->type == AST_RELOP ||
-               Exp->child->sibling->type == AST_AND ||
-               Exp->child->sibling->type == AST_OR ||
-               Exp->child->type == AST_NOT) {
+    } else if (Exp->child->type != AST_NOT && Exp->child->sibling->type == AST_RELOP) { // Exp -> Exp RELOP Exp
+        // both sides are always evaluated, so no branch is needed
+        int t1 = newVariableId();
+        int t2 = newVariableId();
+        InterCodes* code1 = translate_Exp(Exp->child, t1);
+        InterCodes* code2 = translate_Exp(Exp->child->sibling->sibling, t2);
+        InterCodes* code3 = genSetRelCode(place, get_relop(Exp->child->sibling), tempOperand(t1), tempOperand(t2));
+
+        codes = concatInterCodes(3, code1, code2, code3);
+    } else if (Exp->child->type == AST_NOT) { // Exp -> NOT Exp
+        int t1 = newVariableId();
+        InterCodes* code1 = translate_Exp(Exp->child->sibling, t1);
+        InterCodes* code2 = genSetRelCode(place, RELOP_EQ, tempOperand(t1), constantOperand(0));
+
+        codes = concatInterCodes(2, code1, code2);
+    } else if ((Exp->child->sibling->type == AST_AND || Exp->child->sibling->type == AST_OR)
+               && isSpeculatable(Exp->child->sibling->sibling)) { // Exp -> Exp AND|OR Exp
+        // the right side may be evaluated unconditionally: sum the two truth
+        // values and compare, a && b -> (a != 0) + (b != 0) == 2
+        int t1 = newVariableId();
+        int t2 = newVariableId();
+        int t3 = newVariableId();
+        InterCodes* code1 = translate_Bool(Exp->child, t1);
+        InterCodes* code2 = translate_Bool(Exp->child->sibling->sibling, t2);
+
+        InterCodes* code3 = newInterCodes();
+        code3->code.kind = IR_ADD;
+        code3->code.result = tempOperand(t3);
+        code3->code.arg1 = tempOperand(t1);
+        code3->code.arg2 = tempOperand(t2);
+
+        InterCodes* code4;
+        if (Exp->child->sibling->type == AST_AND) {
+            code4 = genSetRelCode(place, RELOP_EQ, tempOperand(t3), constantOperand(2));
+        } else {
+            code4 = genSetRelCode(place, RELOP_NE, tempOperand(t3), constantOperand(0));
+        }
+
+        codes = concatInterCodes(4, code1, code2, code3, code4);
+    } else if (Exp->child->sibling->type == AST_AND ||
+               Exp->child->sibling->type == AST_OR) {
         int true_label = newLabelId();
         int false_label = newLabelId();
 
@@ -517,6 +653,7 @@ InterCodes* translate_Exp(ASTNode* Exp, int place) {
         assert(0);
     }
 
+    currentLine = line;
     return codes;
 }
 
@@ -524,6 +661,8 @@ InterCodes* translate_Stmt(ASTNode *Stmt) {
     assert(Stmt);
     assert(Stmt->type == AST_Stmt);
 
+    int line = currentLine;
+    currentLine = Stmt->lineno;
     InterCodes* codes = NULL;
 
     if (Stmt->child->type == AST_CompSt) { // Stmt -> CompSt
@@ -571,6 +710,7 @@ InterCodes* translate_Stmt(ASTNode *Stmt) {
         assert(0);
     }
 
+    currentLine = line;
     return codes;
 }
 
@@ -647,6 +787,8 @@ InterCodes* translate_Dec(ASTNode *Dec) {
     assert(Dec);
     assert(Dec->type == AST_Dec);
 
+    int line = currentLine;
+    currentLine = Dec->lineno;
     InterCodes* codes = NULL;
 
     if (Dec->child->sibling == NULL) { // Dec -> VarDec
@@ -669,6 +811,31 @@ InterCodes* translate_Dec(ASTNode *Dec) {
         assert(0);
     }
 
+    currentLine = line;
+    return codes;
+}
+
+// IF arg1 relop arg2 GOTO label_true, otherwise go to label_false,
+// where either label may be LABEL_FALL
+static InterCodes* genCondJump(enum RELOP_TYPE relop, Operand arg1, Operand arg2, int label_true, int label_false) {
+    if (label_true == LABEL_FALL && label_false == LABEL_FALL) {
+        return NULL;
+    }
+    InterCodes* codes = newInterCodes();
+    codes->code.kind = IR_RELOP;
+    codes->code.result.kind = OP_LABEL;
+    codes->code.arg1 = arg1;
+    codes->code.arg2 = arg2;
+    if (label_true != LABEL_FALL) {
+        codes->code.relop = relop;
+        codes->code.result.u.label_id = label_true;
+        if (label_false != LABEL_FALL) {
+            codes = concatInterCodes(2, codes, genGotoCode(label_false));
+        }
+    } else {
+        codes->code.relop = get_reverse_relop(relop);
+        codes->code.result.u.label_id = label_false;
+    }
     return codes;
 }
 
@@ -676,55 +843,23 @@ InterCodes* translate_Cond(ASTNode *Exp, int label_true, int label_false) {
     assert(Exp);
     assert(Exp->type == AST_Exp);
 
+    int line = currentLine;
+    currentLine = Exp->lineno;
     InterCodes* codes = NULL;
     if (Exp->child->type == AST_NOT) { // Exp -> NOT Exp
-        codes = translate_Cond(Exp, label_false, label_true);
-    } else if (Exp->child->sibling->type == AST_RELOP) { // Exp -> Exp RELOP Exp
+        codes = translate_Cond(Exp->child->sibling, label_false, label_true);
+    } else if (Exp->child->type == AST_LP) { // Exp -> LP Exp RP
+        codes = translate_Cond(Exp->child->sibling, label_true, label_false);
+    } else if (Exp->child->sibling != NULL && Exp->child->sibling->type == AST_RELOP) { // Exp -> Exp RELOP Exp
         int t1 = newVariableId();
         int t2 = newVariableId();
         InterCodes* code1 = translate_Exp(Exp->child, t1);
         InterCodes* code2 = translate_Exp(Exp->child->sibling->sibling, t2);
+        InterCodes* code3 = genCondJump(get_relop(Exp->child->sibling), tempOperand(t1), tempOperand(t2),
+            label_true, label_false);
 
-        if (label_true != LABEL_FALL && label_false != LABEL_FALL) {
-            InterCodes* code3 = newInterCodes();
-            code3->code.kind = IR_RELOP;
-            code3->code.relop = get_relop(Exp->child->sibling);
-            code3->code.result.kind = OP_LABEL;
-            code3->code.result.u.label_id = label_true;
-            code3->code.arg1.kind = OP_TEMP;
-            code3->code.arg1.u.var_id = t1;
-            code3->code.arg2.kind = OP_TEMP;
-            code3->code.arg2.u.var_id = t2;
-
-            codes = concatInterCodes(4, code1, code2, code3, genGotoCode(label_false));
-        } else if (label_true != LABEL_FALL) {
-            InterCodes* code3 = newInterCodes();
-            code3->code.kind = IR_RELOP;
-            code3->code.relop = get_relop(Exp->child->sibling);
-            code3->code.result.kind = OP_LABEL;
-            code3->code.result.u.label_id = label_true;
-            code3->code.arg1.kind = OP_TEMP;
-            code3->code.arg1.u.var_id = t1;
-            code3->code.arg2.kind = OP_TEMP;
-            code3->code.arg2.u.var_id = t2;
-
-            codes = concatInterCodes(3, code1, code2, code3);
-        } else if (label_false != LABEL_FALL) {
-            InterCodes* code3 = newInterCodes();
-            code3->code.kind = IR_RELOP;
-            code3->code.relop = get_reverse_relop(get_relop(Exp->child->sibling));
-            code3->code.result.kind = OP_LABEL;
-            code3->code.result.u.label_id = label_false;
-            code3->code.arg1.kind = OP_TEMP;
-            code3->code.arg1.u.var_id = t1;
-            code3->code.arg2.kind = OP_TEMP;
-            code3->code.arg2.u.var_id = t2;
-
-            codes = concatInterCodes(3, code1, code2, code3);
-        } else {
-            codes = concatInterCodes(2, code1, code2);
-        }
-    } else if (Exp->child->sibling->type == AST_AND) { // Exp AND Exp
+        codes = concatInterCodes(3, code1, code2, code3);
+    } else if (Exp->child->sibling != NULL && Exp->child->sibling->type == AST_AND) { // Exp AND Exp
         int label_Exp1_false;
         if (label_false != LABEL_FALL) {
             label_Exp1_false = label_false;
@@ -740,7 +875,7 @@ InterCodes* translate_Cond(ASTNode *Exp, int label_true, int label_false) {
         } else {
             codes = concatInterCodes(3, code1, code2, genLabelCode(label_Exp1_false));
         }
-    } else if (Exp->child->sibling->type == AST_OR) { // Exp OR Exp
+    } else if (Exp->child->sibling != NULL && Exp->child->sibling->type == AST_OR) { // Exp OR Exp
         int label_Exp1_true;
         if (label_true != LABEL_FALL) {
             label_Exp1_true = label_true;
@@ -760,19 +895,12 @@ InterCodes* translate_Cond(ASTNode *Exp, int label_true, int label_false) {
         int t1 = newVariableId();
         InterCodes* code1 = translate_Exp(Exp, t1);
 
-        InterCodes* code2 = newInterCodes();
-        code2->code.kind = IR_RELOP;
-        code2->code.relop = RELOP_NE;
-        code2->code.result.kind = OP_LABEL;
-        code2->code.result.u.label_id = label_true;
-        code2->code.arg1.kind = OP_TEMP;
-        code2->code.arg1.u.var_id = t1;
-        code2->code.arg2.kind = OP_CONSTANT;
-        code2->code.arg2.u.var_id = 0;
+        InterCodes* code2 = genCondJump(RELOP_NE, tempOperand(t1), constantOperand(0), label_true, label_false);
 
-        codes = concatInterCodes(3, code1, code2, genGotoCode(label_false));
+        codes = concatInterCodes(2, code1, code2);
     }
     assert(codes);
+    currentLine = line;
     return codes;
 }
 
@@ -803,11 +931,26 @@ InterCodes* translate_Args(ASTNode *Args, ArgNode** arg_list) {
 InterCodes* translate_Program(ASTNode *Program) {
     assert(Program);
     assert(Program->type == AST_Program);
+    timer_begin("translate");
     InterCodes* codes = translate_ExtDefList(Program->child);
+    currentLine = 0;
+    timer_end();
+    mem_checkpoint("translate");
 #ifndef NO_OPTIMIZE
     // codes = optmize_copyPropagation(codes);
-    codes = optimize_ir(codes);
+    if (options.optimize) {
+        timer_begin("optimize");
+        codes = optimize_ir(codes);
+        timer_end();
+        mem_checkpoint("optimize");
+    }
 #endif
+    if (options.profile_use != NULL) {
+        timer_begin("profile use");
+        codes = pgo_use(codes, options.profile_use);
+        timer_end();
+        mem_checkpoint("profile use");
+    }
     return codes;
 }
 
@@ -832,6 +975,7 @@ InterCodes* translate_ExtDef(ASTNode *ExtDef) {
     assert(ExtDef);
     assert(ExtDef->type == AST_ExtDef);
 
+    currentLine = ExtDef->lineno;
     InterCodes* codes = NULL;
 
     if (ExtDef->child->sibling->type == AST_FunDec) {
@@ -985,10 +1129,30 @@ static void printOperand(Operand op) {
     }
 }
 
+static void printRelop(enum RELOP_TYPE relop) {
+    switch (relop) {
+        case RELOP_LT: printf(" < "); break;
+        case RELOP_LE: printf(" <= "); break;
+        case RELOP_EQ: printf(" == "); break;
+        case RELOP_GT: printf(" > "); break;
+        case RELOP_GE: printf(" >= "); break;
+        case RELOP_NE: printf(" != "); break;
+        default: assert(0);
+    }
+}
+
 void generate_ir(ASTNode* Program) {
     InterCodes* codes = translate_Program(Program);
+    if (options.profile_generate) codes = pgo_instrument(codes);
 
+    timer_begin("print IR");
+    int line = 0;
     for (InterCodes* p = codes; p != NULL; p = p->next) {
+        // with -g, a comment where the source line changes
+        if (options.line_info && p->code.lineno != 0 && p->code.lineno != line) {
+            line = p->code.lineno;
+            printf("# line %d\n", line);
+        }
         switch(p->code.kind) {
             case IR_LABEL: {
                 assert(p->code.result.kind == OP_LABEL);
@@ -1055,21 +1219,45 @@ void generate_ir(ASTNode* Program) {
             case IR_RELOP: {
                 printf("IF ");
                 printOperand(p->code.arg1);
-                switch (p->code.relop) {
-                    case RELOP_LT: printf(" < "); break;
-                    case RELOP_LE: printf(" <= "); break;
-                    case RELOP_EQ: printf(" == "); break;
-                    case RELOP_GT: printf(" > "); break;
-                    case RELOP_GE: printf(" >= "); break;
-                    case RELOP_NE: printf(" != "); break;
-                    default: assert(0);
-                }
+                printRelop(p->code.relop);
                 printOperand(p->code.arg2);
                 printf(" GOTO ");
                 printOperand(p->code.result);
                 printf("\n");
                 break;
             }
+            case IR_SETREL: {
+                // the IR text has no such instruction, spell it out with branches
+                int label_true = newLabelId();
+                int label_end = newLabelId();
+                printf("IF ");
+                printOperand(p->code.arg1);
+                printRelop(p->code.relop);
+                printOperand(p->code.arg2);
+                printf(" GOTO label%d\n", label_true);
+                printOperand(p->code.result);
+                printf(" := #0\n");
+                printf("GOTO label%d\n", label_end);
+                printf("LABEL label%d :\n", label_true);
+                printOperand(p->code.result);
+                printf(" := #1\n");
+                printf("LABEL label%d :\n", label_end);
+                break;
+            }
+            case IR_CMOV: {
+                // likewise, skip the move when the condition does not hold
+                int label_skip = newLabelId();
+                printf("IF ");
+                printOperand(p->code.arg2);
+                printRelop(get_reverse_relop(p->code.relop));
+                printf("#0 GOTO label%d\n", label_skip);
+                printOperand(p->code.result);
+                printf(" := ");
+                printOperand(p->code.arg1);
+                printf("\n");
+                printf("LABEL label%d :\n", label_skip);
+                break;
+            }
             case IR_DEC: {
                 printf("DEC ");
                 printOperand(p->code.result);
@@ -1135,9 +1323,16 @@ void generate_ir(ASTNode* Program) {
                 printf("\n");
                 break;
             }
+            case IR_COUNT: {
+                // read by run_ir -P, other readers take it for a comment
+                printf("# block %08x\n", (unsigned)p->code.result.u.value);
+                break;
+            }
             default: assert(0);
         }
     }
+    timer_end();
+    mem_checkpoint("print IR");
 }
 
 InterCodes* optmize_copyPropagation(InterCodes* inCodes) {
@@ -1196,7 +1391,8 @@ void peek_basic_block(InterCodes* codes, InterCodes** start_, InterCodes** end_)
     for(start = codes; start != NULL; start = start->next) {
         if (start->code.kind == IR_ASSIGN || start->code.kind == IR_ADD || 
             start->code.kind == IR_SUB  || start->code.kind == IR_MUL ||
-            start->code.kind == IR_DIV || start->code.kind == IR_ARG) {
+            start->code.kind == IR_DIV || start->code.kind == IR_ARG ||
+            start->code.kind == IR_SETREL || start->code.kind == IR_CMOV) {
                 break;
             }
     }
@@ -1204,7 +1400,8 @@ void peek_basic_block(InterCodes* codes, InterCodes** start_, InterCodes** end_)
     for(end = start; end != NULL; end = end->next) {
         if (end->code.kind != IR_ASSIGN && end->code.kind != IR_ADD && 
             end->code.kind != IR_SUB  && end->code.kind != IR_MUL &&
-            end->code.kind != IR_DIV && end->code.kind != IR_ARG &&
+            end->code.kind != IR_DIV && end->code.kind != IR_ARG && end->code.kind != IR_SETREL &&
+            end->code.kind != IR_CMOV &&
             end->code.kind != IR_DEREF_L && end->code.kind != IR_DEREF_R && end->code.kind != IR_ADDR) {
                 end = end->next;
                 break;
@@ -1216,10 +1413,116 @@ void peek_basic_block(InterCodes* codes, InterCodes** start_, InterCodes** end_)
 }
 
 struct GenNode {
+    int size, capacity;
+    InterCodes** gen;
+};
+
+static void initGenNode(struct GenNode* node) {
+    node->size = 0;
+    node->capacity = 16;
+    node->gen = (InterCodes**)malloc(sizeof(InterCodes*) * node->capacity);
+}
+
+static void pushGen(struct GenNode* node, InterCodes* code) {
+    if (node->size == node->capacity) {
+        node->capacity *= 2;
+        node->gen = (InterCodes**)realloc(node->gen, sizeof(InterCodes*) * node->capacity);
+    }
+    node->gen[node->size++] = code;
+}
+
+// variables numbered 0, 1, ... in the order they are added, open
+// addressing on the symbol pointer
+struct SymbolMap {
+    int size, capacity;
+    Symbol* keys;
+    int* values;
+};
+
+static void initSymbolMap(struct SymbolMap* map) {
+    map->size = 0;
+    map->capacity = 64;
+    map->keys = (Symbol*)calloc(map->capacity, sizeof(Symbol));
+    map->values = (int*)malloc(sizeof(int) * map->capacity);
+}
+
+static void freeSymbolMap(struct SymbolMap* map) {
+    free(map->keys);
+    free(map->values);
+}
+
+static unsigned hashSymbol(Symbol sym) {
+    return (unsigned)((size_t)sym >> 4) * 2654435761u;
+}
+
+static unsigned symbolSlot(struct SymbolMap* map, Symbol sym) {
+    unsigned i = hashSymbol(sym) & (map->capacity - 1);
+    while (map->keys[i] != NULL && map->keys[i] != sym) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+    return i;
+}
+
+// number of sym, -1 if it was not added
+static int findSymbol(struct SymbolMap* map, Symbol sym) {
+    unsigned i = symbolSlot(map, sym);
+    return map->keys[i] != NULL ? map->values[i] : -1;
+}
+
+static int addSymbol(struct SymbolMap* map, Symbol sym) {
+    unsigned i = symbolSlot(map, sym);
+    if (map->keys[i] != NULL) return map->values[i];
+    if (2 * (map->size + 1) > map->capacity) {
+        struct SymbolMap old = *map;
+        map->capacity *= 2;
+        map->keys = (Symbol*)calloc(map->capacity, sizeof(Symbol));
+        map->values = (int*)malloc(sizeof(int) * map->capacity);
+        for (int j = 0; j < old.capacity; j++) {
+            if (old.keys[j] != NULL) {
+                unsigned k = symbolSlot(map, old.keys[j]);
+                map->keys[k] = old.keys[j];
+                map->values[k] = old.values[j];
+            }
+        }
+        freeSymbolMap(&old);
+        i = symbolSlot(map, sym);
+    }
+    map->keys[i] = sym;
+    map->values[i] = map->size;
+    return map->size++;
+}
+
+// numbering of the temporaries and variables of the code, for tables
+// indexed by operand: temporaries by id, variables after them
+struct OperandNumbers {
+    struct SymbolMap vars;
+    int temps;      // temporaries that existed when numbering
     int size;
-    InterCodes* gen[200];
 };
 
+static void numberOperands(InterCodes* codes, struct OperandNumbers* numbers) {
+    initSymbolMap(&numbers->vars);
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        Operand named[3] = { p->code.result, p->code.arg1, p->code.arg2 };
+        for (int i = 0; i < 3; i++) {
+            if (named[i].kind == OP_VARIABLE) addSymbol(&numbers->vars, named[i].symbol);
+        }
+    }
+    numbers->temps = variableId + 1;
+    numbers->size = numbers->temps + numbers->vars.size;
+}
+
+// -1 for constants and operands made after numbering
+static int operandIndex(struct OperandNumbers* numbers, Operand op) {
+    if (op.kind == OP_TEMP) {
+        return op.u.var_id < numbers->temps ? op.u.var_id : -1;
+    } else if (op.kind == OP_VARIABLE) {
+        int i = findSymbol(&numbers->vars, op.symbol);
+        return i < 0 ? -1 : numbers->temps + i;
+    }
+    return -1;
+}
+
 bool isOperandEqual(Operand op1, Operand op2) {
     if (op1.kind == op2.kind) {
         if (op1.kind == OP_TEMP && op1.u.var_id == op2.u.var_id) {
@@ -1231,13 +1534,67 @@ bool isOperandEqual(Operand op1, Operand op2) {
     return false;
 }
 
+// does p write its result operand?
+bool isDefinition(InterCodes* p) {
+    switch (p->code.kind) {
+        case IR_ASSIGN: case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_SETREL:
+        case IR_CMOV: case IR_ADDR: case IR_DEREF_R: case IR_CALL: case IR_READ: case IR_PARAM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// operands read by p, returns how many; PARAM, READ and DEC count as
+// uses of their result so that these are never considered dead
+int getUsedOperands(InterCodes* p, Operand uses[3]) {
+    int n = 0;
+    switch (p->code.kind) {
+        case IR_CMOV:   // keeps the old value of result when not moving
+            uses[n++] = p->code.result;
+            uses[n++] = p->code.arg1;
+            uses[n++] = p->code.arg2;
+            break;
+        case IR_ASSIGN: case IR_ADDR: case IR_DEREF_R:
+            uses[n++] = p->code.arg1;
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_RELOP: case IR_SETREL:
+            uses[n++] = p->code.arg1;
+            uses[n++] = p->code.arg2;
+            break;
+        case IR_DEREF_L:
+            uses[n++] = p->code.result;
+            uses[n++] = p->code.arg1;
+            break;
+        case IR_RETURN: case IR_DEC: case IR_ARG: case IR_PARAM: case IR_READ: case IR_WRITE:
+            uses[n++] = p->code.result;
+            break;
+        default: break;
+    }
+    return n;
+}
+
+static int evalRelop(enum RELOP_TYPE relop, int a, int b) {
+    switch (relop) {
+        case RELOP_LT: return a < b;
+        case RELOP_LE: return a <= b;
+        case RELOP_EQ: return a == b;
+        case RELOP_GT: return a > b;
+        case RELOP_GE: return a >= b;
+        case RELOP_NE: return a != b;
+        default: assert(0);
+    }
+    return 0;
+}
+
 InterCodes* optimize_one_run(InterCodes* codes, bool *changed) {
     *changed = false;
+    stats_ir_before(codes);
     InterCodes *start, *end = codes;
     while (end != NULL) {
         peek_basic_block(end, &start, &end);
         struct GenNode gens;
-        gens.size = 0;
+        initGenNode(&gens);
         for (InterCodes *p = start; p != end; p = p->next) {
             if (p->code.kind == IR_ASSIGN) {
                 // replace
@@ -1245,33 +1602,38 @@ InterCodes* optimize_one_run(InterCodes* codes, bool *changed) {
                    if (isOperandEqual(p->code.arg1, gens.gen[i]->code.result)) {
                        p->code.arg1 = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    }
                 }
 
                 // kill all previous gen
                 for (int i = 0; i < gens.size; ) {
-                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)) {
+                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)
+                    || isOperandEqual(p->code.result, gens.gen[i]->code.arg1)) {
                        gens.gen[i] = gens.gen[gens.size - 1];
                        (gens.size)--;
                    } else {
                        i++;
                    }
                 }
-                // add new gen
-                gens.gen[gens.size] = p;
-                gens.size++;
+                // add new gen, unless it copies itself (t := t)
+                if (!isOperandEqual(p->code.result, p->code.arg1)) {
+                    pushGen(&gens, p);
+                }
             } else if (p->code.kind == IR_ADDR || p->code.kind == IR_DEREF_R) {
                 // replace
                 for (int i = 0; i < gens.size; i++) {
                    if (isOperandEqual(p->code.arg1, gens.gen[i]->code.result)) {
                        p->code.arg1 = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    }
                 }
 
                 // kill all previous gen
                 for (int i = 0; i < gens.size; ) {
-                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)) {
+                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)
+                    || isOperandEqual(p->code.result, gens.gen[i]->code.arg1)) {
                        gens.gen[i] = gens.gen[gens.size - 1];
                        (gens.size)--;
                    } else {
@@ -1284,56 +1646,84 @@ InterCodes* optimize_one_run(InterCodes* codes, bool *changed) {
                    if (isOperandEqual(p->code.arg1, gens.gen[i]->code.result)) {
                        p->code.arg1 = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
+                   }
+                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)
+                    && gens.gen[i]->code.arg1.kind != OP_CONSTANT) {
+                       p->code.result = gens.gen[i]->code.arg1;
+                       *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    }
                 }
             } else if (p->code.kind == IR_ADD || p->code.kind == IR_SUB ||
-                        p->code.kind == IR_MUL || p->code.kind == IR_DIV || p->code.kind == IR_RELOP) {
+                        p->code.kind == IR_MUL || p->code.kind == IR_DIV || p->code.kind == IR_RELOP ||
+                        p->code.kind == IR_SETREL || p->code.kind == IR_CMOV) {
                 // replace
                 for (int i = 0; i < gens.size; i++) {
                    if (isOperandEqual(p->code.arg1, gens.gen[i]->code.result)) {
                        p->code.arg1 = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    }
                    if (isOperandEqual(p->code.arg2, gens.gen[i]->code.result)) {
                        p->code.arg2 = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    } 
                 }
 
                 // kill all previous gen
                 for (int i = 0; i < gens.size; ) {
-                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)) {
+                   if (isOperandEqual(p->code.result, gens.gen[i]->code.result)
+                    || isOperandEqual(p->code.result, gens.gen[i]->code.arg1)) {
                        gens.gen[i] = gens.gen[gens.size - 1];
                        (gens.size)--;
                    } else {
                        i++;
                    }
                 }
-            } else if (p->code.kind == IR_RETURN || p->code.kind == IR_ARG) {
+            } else if (p->code.kind == IR_RETURN || p->code.kind == IR_ARG || p->code.kind == IR_WRITE) {
                 // replace
                 for (int i = 0; i < gens.size; i++) {
                    if (isOperandEqual(p->code.result, gens.gen[i]->code.result)) {
                        p->code.result = gens.gen[i]->code.arg1;
                        *changed = true;
+                       stats_add("copy propagation", "copies propagated", 1);
                    }
                 }
             }
         }
+        free(gens.gen);
     }
 
+    stats_ir_after("copy propagation", codes);
+
     // constant pre-computation: t98 := #0 * #4  -> t98 := #0
+    stats_ir_before(codes);
     for (InterCodes *p = codes; p != NULL; p = p->next) {
         if (p->code.kind == IR_ADD || p->code.kind == IR_SUB || p->code.kind == IR_MUL || p->code.kind == IR_DIV) {
             if (p->code.arg1.kind == OP_CONSTANT && p->code.arg2.kind == OP_CONSTANT) {
-                *changed = true;
+                unsigned v1 = p->code.arg1.u.value, v2 = p->code.arg2.u.value;
                 int new_val;
+                // wrap around like the target machine does
                 switch (p->code.kind) {
-                    case IR_ADD: new_val = p->code.arg1.u.value + p->code.arg2.u.value; break;
-                    case IR_SUB: new_val = p->code.arg1.u.value - p->code.arg2.u.value; break;
-                    case IR_MUL: new_val = p->code.arg1.u.value * p->code.arg2.u.value; break;
-                    case IR_DIV: new_val = p->code.arg1.u.value / p->code.arg2.u.value; break;
+                    case IR_ADD: new_val = (int)(v1 + v2); break;
+                    case IR_SUB: new_val = (int)(v1 - v2); break;
+                    case IR_MUL: new_val = (int)(v1 * v2); break;
+                    case IR_DIV: {
+                        if (v2 == 0) {
+                            continue;   // leave it to the runtime
+                        } else if ((int)v2 == -1) {
+                            new_val = (int)(0u - v1);
+                        } else {
+                            new_val = (int)v1 / (int)v2;
+                        }
+                        break;
+                    }
                     default: assert(0); break;
                 }
+                *changed = true;
+                stats_add("constant folding", "constants folded", 1);
                 p->code.kind = IR_ASSIGN;
                 p->code.arg1.kind = OP_CONSTANT;
                 p->code.arg1.u.value = new_val;
@@ -1341,58 +1731,1084 @@ InterCodes* optimize_one_run(InterCodes* codes, bool *changed) {
         }
     }
 
-    // optimize zero addtion: t32 := v_r + #0 -> t32 := v_r
+    // t := #1 < #2  -> t := #1
     for (InterCodes *p = codes; p != NULL; p = p->next) {
-        if (p->code.kind == IR_ADD && p->code.arg2.kind == OP_CONSTANT && p->code.arg2.u.value == 0) {
+        if (p->code.kind == IR_SETREL && p->code.arg1.kind == OP_CONSTANT && p->code.arg2.kind == OP_CONSTANT) {
             *changed = true;
+            stats_add("constant folding", "constants folded", 1);
             p->code.kind = IR_ASSIGN;
+            p->code.arg1.u.value = evalRelop(p->code.relop, p->code.arg1.u.value, p->code.arg2.u.value);
         }
     }
 
+    stats_ir_after("constant folding", codes);
+
+    timer_begin("algebraic");
+    stats_ir_before(codes);
+    codes = optimize_algebraic(codes, changed);
+    stats_ir_after("algebraic", codes);
+    timer_end();
+    timer_begin("memory");
+    stats_ir_before(codes);
+    codes = optimize_memory(codes, changed);
+    stats_ir_after("memory", codes);
+    timer_end();
+
     // remove dead code
+    stats_ir_before(codes);
+    // how many instructions read each temporary
+    int* temp_used = (int*)calloc(variableId + 1, sizeof(int));
+    // variables named by an instruction that reads a variable
+    struct SymbolMap var_used;
     struct GenNode dead_codes;
-    dead_codes.size = 0;
-    // add dead codes
+    initSymbolMap(&var_used);
+    initGenNode(&dead_codes);
     for (InterCodes *p = codes; p != NULL; p = p->next) {
-        if (p->code.kind == IR_ASSIGN) {
-            dead_codes.gen[dead_codes.size] = p;
-            (dead_codes.size)++;
+        Operand uses[3];
+        int n = getUsedOperands(p, uses);
+        switch (p->code.kind) {
+            // results defined by these are candidates
+            case IR_ASSIGN: case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_SETREL:
+            case IR_ADDR: case IR_DEREF_R:
+                pushGen(&dead_codes, p);
+                break;
+            default: break;
+        }
+        bool reads_variable = false;
+        for (int i = 0; i < n; i++) {
+            if (uses[i].kind == OP_TEMP) {
+                temp_used[uses[i].u.var_id]++;
+            } else if (uses[i].kind == OP_VARIABLE) {
+                reads_variable = true;
+            }
+        }
+        if (reads_variable) {
+            Operand named[3] = { p->code.result, p->code.arg1, p->code.arg2 };
+            for (int i = 0; i < 3; i++) {
+                if (named[i].kind == OP_VARIABLE) addSymbol(&var_used, named[i].symbol);
+            }
         }
     }
-    // check dead codes
-    for (InterCodes *p = codes; p != NULL; p = p->next) {
-        for (int i = 0; i < dead_codes.size; ) {
-            if ((p->code.kind == IR_ASSIGN || p->code.kind == IR_ADDR || p->code.kind == IR_DEREF_R) && isOperandEqual(p->code.arg1, dead_codes.gen[i]->code.result)) {
-                dead_codes.gen[i] = dead_codes.gen[dead_codes.size - 1];
-                (dead_codes.size)--;
-            } else if (p->code.kind == IR_DEREF_L && (isOperandEqual(p->code.result, dead_codes.gen[i]->code.result) || isOperandEqual(p->code.arg1, dead_codes.gen[i]->code.result))) {
-                dead_codes.gen[i] = dead_codes.gen[dead_codes.size - 1];
-                (dead_codes.size)--;
-            } else if ((p->code.kind == IR_RETURN || p->code.kind == IR_DEC || p->code.kind == IR_ARG || p->code.kind == IR_PARAM || p->code.kind == IR_READ || p->code.kind == IR_WRITE) && isOperandEqual(p->code.result, dead_codes.gen[i]->code.result)) {
-                dead_codes.gen[i] = dead_codes.gen[dead_codes.size - 1];
-                (dead_codes.size)--;
-            } else if ((p->code.kind == IR_ADD || p->code.kind == IR_SUB || p->code.kind == IR_MUL || p->code.kind == IR_DIV || p->code.kind == IR_RELOP) 
-                        && (isOperandEqual(p->code.arg1, dead_codes.gen[i]->code.result) || isOperandEqual(p->code.arg2, dead_codes.gen[i]->code.result))) {
-                dead_codes.gen[i] = dead_codes.gen[dead_codes.size - 1];
-                (dead_codes.size)--;
+    // remove dead codes, last first: what a deleted code read may become
+    // dead itself, so a whole chain goes in one run
+    for (int i = dead_codes.size - 1; i >= 0; i--) {
+        InterCodes* dead = dead_codes.gen[i];
+        if (dead->code.result.kind == OP_TEMP) {
+            if (temp_used[dead->code.result.u.var_id] > 0) continue;
+        } else if (dead->code.result.kind == OP_VARIABLE) {
+            if (findSymbol(&var_used, dead->code.result.symbol) >= 0) continue;
+        }
+        Operand uses[3];
+        int n = getUsedOperands(dead, uses);
+        for (int j = 0; j < n; j++) {
+            if (uses[j].kind == OP_TEMP) temp_used[uses[j].u.var_id]--;
+        }
+        *changed = true;
+        stats_add("dead code", "instructions deleted", 1);
+        codes = deleteInterCode(codes, dead);
+    }
+    free(temp_used);
+    freeSymbolMap(&var_used);
+    free(dead_codes.gen);
+    stats_ir_after("dead code", codes);
+
+    return codes;
+}
+
+static bool isConstantOf(Operand op, int value) {
+    return op.kind == OP_CONSTANT && op.u.value == value;
+}
+
+static void rewriteAsAssign(InterCodes* p, Operand src) {
+    p->code.kind = IR_ASSIGN;
+    p->code.arg1 = src;
+}
+
+static void rewriteAsNegation(InterCodes* p, Operand src) {
+    p->code.kind = IR_SUB;
+    p->code.arg1 = constantOperand(0);
+    p->code.arg2 = src;
+}
+
+// constant chains x := y + #c, x := y * #c and x := #0 - y defined earlier
+// in the same extended basic block, indexed by operand
+struct ChainTable {
+    struct OperandNumbers operands;
+    InterCodes** def;   // the last definition of the operand if it is a chain
+    int* def_seq;       // when the operand was last defined
+    int seq;            // instructions seen
+    int block_seq;      // seq at the start of the extended basic block
+};
+
+
+static Operand chainSource(InterCodes* p) {
+    return p->code.kind == IR_SUB ? p->code.arg2 : p->code.arg1;
+}
+
+// the definition of op in the chain table, if neither op nor its source
+// was written since
+static InterCodes* findChainDef(struct ChainTable* chains, Operand op) {
+    int i = operandIndex(&chains->operands, op);
+    if (i < 0 || chains->def[i] == NULL || chains->def_seq[i] < chains->block_seq) {
+        return NULL;
+    }
+    int src = operandIndex(&chains->operands, chainSource(chains->def[i]));
+    if (src >= 0 && chains->def_seq[src] > chains->def_seq[i]) {
+        return NULL;
+    }
+    return chains->def[i];
+}
+
+// fold (y + #c1) + #c2, (y * #c1) * #c2 and #0 - (#0 - y) into a single
+// instruction; the defining instruction is left for dead code elimination
+static bool reassociate(InterCodes* p, struct ChainTable* chains) {
+    InterCodes* def = findChainDef(chains, chainSource(p));
+    if (def == NULL || def->code.kind != p->code.kind) {
+        return false;
+    }
+    unsigned c1 = def->code.arg2.u.value, c2 = p->code.arg2.u.value;
+    if (p->code.kind == IR_ADD && p->code.arg2.kind == OP_CONSTANT) {
+        p->code.arg1 = def->code.arg1;
+        p->code.arg2.u.value = (int)(c1 + c2);
+        return true;
+    } else if (p->code.kind == IR_MUL && p->code.arg2.kind == OP_CONSTANT) {
+        p->code.arg1 = def->code.arg1;
+        p->code.arg2.u.value = (int)(c1 * c2);
+        return true;
+    } else if (p->code.kind == IR_SUB && isConstantOf(p->code.arg1, 0)) {
+        rewriteAsAssign(p, def->code.arg2);
+        return true;
+    }
+    return false;
+}
+
+// identities on a single instruction, assuming canonical operand order
+static bool simplify(InterCodes* p) {
+    Operand a1 = p->code.arg1, a2 = p->code.arg2;
+    switch (p->code.kind) {
+        case IR_ADD:
+            if (isConstantOf(a2, 0)) {                  // x + #0
+                rewriteAsAssign(p, a1);
+                return true;
+            }
+            break;
+        case IR_SUB:
+            if (isConstantOf(a2, 0)) {                  // x - #0
+                rewriteAsAssign(p, a1);
+                return true;
+            } else if (isOperandEqual(a1, a2)) {        // x - x
+                rewriteAsAssign(p, constantOperand(0));
+                return true;
+            }
+            break;
+        case IR_MUL:
+            if (isConstantOf(a2, 1)) {                  // x * #1
+                rewriteAsAssign(p, a1);
+                return true;
+            } else if (isConstantOf(a2, 0)) {           // x * #0
+                rewriteAsAssign(p, constantOperand(0));
+                return true;
+            } else if (isConstantOf(a2, -1)) {          // x * #-1
+                rewriteAsNegation(p, a1);
+                return true;
+            }
+            break;
+        case IR_DIV:
+            if (isConstantOf(a2, 1)) {                  // x / #1
+                rewriteAsAssign(p, a1);
+                return true;
+            } else if (isConstantOf(a2, -1)) {          // x / #-1
+                rewriteAsNegation(p, a1);
+                return true;
+            } else if (isConstantOf(a1, 0) && a2.kind != OP_CONSTANT) {  // #0 / x
+                rewriteAsAssign(p, constantOperand(0));
+                return true;
+            }
+            break;
+        case IR_SETREL:
+            if (isOperandEqual(a1, a2)) {                // x < x, x == x, ...
+                rewriteAsAssign(p, constantOperand(evalRelop(p->code.relop, 0, 0)));
+                return true;
+            }
+            break;
+        case IR_CMOV:
+            if (a2.kind == OP_CONSTANT) {               // known condition, x := x is deleted later
+                bool moves = evalRelop(p->code.relop, a2.u.value, 0);
+                rewriteAsAssign(p, moves ? a1 : p->code.result);
+                return true;
+            } else if (isOperandEqual(a1, p->code.result)) {
+                rewriteAsAssign(p, a1);
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+// put constants on the right: #4 + x -> x + #4, x - #4 -> x + #-4,
+// IF #0 < x -> IF x > #0
+static bool canonicalize(InterCodes* p) {
+    Operand a1 = p->code.arg1, a2 = p->code.arg2;
+    switch (p->code.kind) {
+        case IR_ADD:
+        case IR_MUL:
+            if (a1.kind == OP_CONSTANT && a2.kind != OP_CONSTANT) {
+                p->code.arg1 = a2;
+                p->code.arg2 = a1;
+                return true;
+            }
+            break;
+        case IR_SUB:
+            if (a2.kind == OP_CONSTANT && a1.kind != OP_CONSTANT && a2.u.value != 0
+                && a2.u.value != INT_MIN) {
+                p->code.kind = IR_ADD;
+                p->code.arg2.u.value = -a2.u.value;
+                return true;
+            }
+            break;
+        case IR_RELOP:
+        case IR_SETREL:
+            if (a1.kind == OP_CONSTANT && a2.kind != OP_CONSTANT) {
+                p->code.arg1 = a2;
+                p->code.arg2 = a1;
+                p->code.relop = get_mirror_relop(p->code.relop);
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+InterCodes* optimize_algebraic(InterCodes* codes, bool *changed) {
+    struct ChainTable chains;
+    numberOperands(codes, &chains.operands);
+    chains.def = (InterCodes**)calloc(chains.operands.size, sizeof(InterCodes*));
+    chains.def_seq = (int*)calloc(chains.operands.size, sizeof(int));
+    chains.seq = chains.block_seq = 1;
+
+    InterCodes* p = codes;
+    while (p != NULL) {
+        InterCodes* next = p->next;
+        chains.seq++;
+        if (p->code.kind == IR_LABEL || p->code.kind == IR_FUNC) {
+            chains.block_seq = chains.seq;
+        }
+        if (canonicalize(p)) {
+            *changed = true;
+            stats_add("algebraic", "operands canonicalized", 1);
+        }
+        if (reassociate(p, &chains)) {
+            *changed = true;
+            stats_add("algebraic", "chains reassociated", 1);
+        }
+        if (simplify(p)) {
+            *changed = true;
+            stats_add("algebraic", "identities simplified", 1);
+        }
+
+        if (p->code.kind == IR_ASSIGN && isOperandEqual(p->code.result, p->code.arg1)) {
+            // t := t
+            *changed = true;
+            stats_add("algebraic", "self copies deleted", 1);
+            codes = deleteInterCode(codes, p);
+            p = next;
+            continue;
+        }
+
+        int i = isDefinition(p) ? operandIndex(&chains.operands, p->code.result) : -1;
+        if (i >= 0) {
+            Operand src = chainSource(p);
+            bool is_chain = ((p->code.kind == IR_ADD || p->code.kind == IR_MUL) && p->code.arg2.kind == OP_CONSTANT)
+                || (p->code.kind == IR_SUB && isConstantOf(p->code.arg1, 0));
+            bool keep = is_chain && (src.kind == OP_TEMP || src.kind == OP_VARIABLE)
+                && !isOperandEqual(p->code.result, src);
+            chains.def[i] = keep ? p : NULL;
+            chains.def_seq[i] = chains.seq;
+        }
+        p = next;
+    }
+    freeSymbolMap(&chains.operands.vars);
+    free(chains.def);
+    free(chains.def_seq);
+    return codes;
+}
+
+// address of a store or load as base operand + constant offset
+struct MemRef {
+    InterCodes* code;
+    Operand base;
+    int off;
+};
+
+struct MemRefList {
+    int size, capacity;
+    struct MemRef* refs;
+};
+
+static void pushMemRef(struct MemRefList* list, InterCodes* code, Operand base, int off) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->refs = (struct MemRef*)realloc(list->refs, sizeof(struct MemRef) * list->capacity);
+    }
+    list->refs[list->size].code = code;
+    list->refs[list->size].base = base;
+    list->refs[list->size].off = off;
+    list->size++;
+}
+
+// resolve addr through a still valid definition addr := base + #off
+static void resolveAddress(struct GenNode* offsets, Operand addr, Operand* base, int* off) {
+    for (int i = 0; i < offsets->size; i++) {
+        if (isOperandEqual(offsets->gen[i]->code.result, addr)) {
+            *base = offsets->gen[i]->code.arg1;
+            *off = offsets->gen[i]->code.arg2.u.value;
+            return;
+        }
+    }
+    *base = addr;
+    *off = 0;
+}
+
+// remove stores that are overwritten before any load could observe them,
+// within an extended basic block
+static InterCodes* eliminateOverwrittenStores(InterCodes* codes, bool *changed) {
+    struct GenNode offsets;
+    struct MemRefList pending = { 0, 0, NULL };
+    initGenNode(&offsets);
+    InterCodes* p = codes;
+    while (p != NULL) {
+        InterCodes* next = p->next;
+        Operand base;
+        int off;
+        switch (p->code.kind) {
+            case IR_LABEL: case IR_FUNC:
+                offsets.size = 0;
+                pending.size = 0;
+                break;
+            case IR_GOTO: case IR_RELOP: case IR_CALL: case IR_RETURN:
+                // the stored values may be read after the jump or by the callee
+                pending.size = 0;
+                break;
+            case IR_DEREF_R: {
+                // only a load from the same base at another offset cannot alias
+                resolveAddress(&offsets, p->code.arg1, &base, &off);
+                for (int i = 0; i < pending.size; ) {
+                    if (!isOperandEqual(pending.refs[i].base, base) || pending.refs[i].off == off) {
+                        pending.refs[i] = pending.refs[--pending.size];
+                    } else {
+                        i++;
+                    }
+                }
+                break;
+            }
+            case IR_DEREF_L: {
+                resolveAddress(&offsets, p->code.result, &base, &off);
+                for (int i = 0; i < pending.size; ) {
+                    if (isOperandEqual(pending.refs[i].base, base) && pending.refs[i].off == off) {
+                        *changed = true;
+                        stats_add("memory", "overwritten stores deleted", 1);
+                        codes = deleteInterCode(codes, pending.refs[i].code);
+                        pending.refs[i] = pending.refs[--pending.size];
+                    } else {
+                        i++;
+                    }
+                }
+                if (base.kind != OP_CONSTANT) {
+                    pushMemRef(&pending, p, base, off);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (isDefinition(p)) {
+            for (int i = 0; i < pending.size; ) {
+                if (isOperandEqual(pending.refs[i].base, p->code.result)) {
+                    pending.refs[i] = pending.refs[--pending.size];
+                } else {
+                    i++;
+                }
+            }
+            for (int i = 0; i < offsets.size; ) {
+                if (isOperandEqual(offsets.gen[i]->code.result, p->code.result)
+                    || isOperandEqual(offsets.gen[i]->code.arg1, p->code.result)) {
+                    offsets.gen[i] = offsets.gen[--offsets.size];
+                } else {
+                    i++;
+                }
+            }
+            if (p->code.kind == IR_ADD && p->code.arg2.kind == OP_CONSTANT
+                && p->code.arg1.kind != OP_CONSTANT && !isOperandEqual(p->code.result, p->code.arg1)) {
+                pushGen(&offsets, p);
+            }
+        }
+        p = next;
+    }
+    free(offsets.gen);
+    free(pending.refs);
+    return codes;
+}
+
+#define AGG_NONE     (-1)   // not derived from a local aggregate
+#define AGG_CONFLICT (-2)   // may point into more than one aggregate
+
+// which aggregate (index of its DEC) a pointer operand is derived from
+struct AggLabels {
+    int* temp;      // indexed by temporary id
+    bool* temp_ext;
+    struct AggVar {
+        Symbol symbol;
+        int label;
+        bool ext;
+    } *var;         // only variables with a label, open addressing on symbol
+    int var_size, var_capacity;
+};
+
+// slot of sym in the variable table, or the free slot it would go into
+static int aggVarSlot(struct AggLabels* labels, Symbol sym) {
+    unsigned i = hashSymbol(sym) & (labels->var_capacity - 1);
+    while (labels->var[i].symbol != NULL && labels->var[i].symbol != sym) {
+        i = (i + 1) & (labels->var_capacity - 1);
+    }
+    return i;
+}
+
+static int getAggLabel(struct AggLabels* labels, Operand op, bool** ext) {
+    static bool no_ext = false;
+    *ext = &no_ext;
+    if (op.kind == OP_TEMP) {
+        *ext = &labels->temp_ext[op.u.var_id];
+        return labels->temp[op.u.var_id];
+    } else if (op.kind == OP_VARIABLE) {
+        struct AggVar* var = &labels->var[aggVarSlot(labels, op.symbol)];
+        if (var->symbol != NULL) {
+            *ext = &var->ext;
+            return var->label;
+        }
+    }
+    return AGG_NONE;
+}
+
+static int joinAggLabel(int a, int b) {
+    if (b == AGG_NONE || a == b) return a;
+    if (a == AGG_NONE) return b;
+    return AGG_CONFLICT;
+}
+
+// merge label into op, returns whether op changed
+static bool addAggLabel(struct AggLabels* labels, Operand op, int label) {
+    bool* ext;
+    int old = getAggLabel(labels, op, &ext);
+    int now = joinAggLabel(old, label);
+    if (now == old) return false;
+    if (op.kind == OP_TEMP) {
+        labels->temp[op.u.var_id] = now;
+        return true;
+    }
+    assert(op.kind == OP_VARIABLE);
+    struct AggVar* var = &labels->var[aggVarSlot(labels, op.symbol)];
+    if (var->symbol != NULL) {
+        var->label = now;
+        return true;
+    }
+    if (2 * (labels->var_size + 1) > labels->var_capacity) {
+        struct AggVar* old_var = labels->var;
+        int old_capacity = labels->var_capacity;
+        labels->var_capacity *= 2;
+        labels->var = calloc(labels->var_capacity, sizeof(labels->var[0]));
+        for (int i = 0; i < old_capacity; i++) {
+            if (old_var[i].symbol != NULL) {
+                labels->var[aggVarSlot(labels, old_var[i].symbol)] = old_var[i];
+            }
+        }
+        free(old_var);
+    }
+    var = &labels->var[aggVarSlot(labels, op.symbol)];
+    var->symbol = op.symbol;
+    var->label = now;
+    var->ext = false;
+    labels->var_size++;
+    return true;
+}
+
+// operands a definition derives its (pointer) value from
+static int pointerSources(InterCodes* p, Operand sources[2]) {
+    switch (p->code.kind) {
+        case IR_ASSIGN: case IR_ADDR:
+            sources[0] = p->code.arg1;
+            return 1;
+        case IR_ADD:
+            sources[0] = p->code.arg1;
+            sources[1] = p->code.arg2;
+            return 2;
+        case IR_SUB: case IR_CMOV:
+            sources[0] = p->code.arg1;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void freeAggLabels(struct AggLabels* labels) {
+    free(labels->temp);
+    free(labels->temp_ext);
+    free(labels->var);
+}
+
+// label every operand with the local aggregate (the DEC in decs) it points
+// into; returns false, with nothing left to free, when there is none
+static bool computeAggLabels(InterCodes* codes, struct GenNode* decs, struct AggLabels* labels) {
+    initGenNode(decs);
+    labels->temp = (int*)malloc(sizeof(int) * (variableId + 1));
+    labels->temp_ext = (bool*)calloc(variableId + 1, sizeof(bool));
+    labels->var_size = 0;
+    labels->var_capacity = 16;
+    labels->var = calloc(labels->var_capacity, sizeof(labels->var[0]));
+    for (int i = 0; i <= variableId; i++) {
+        labels->temp[i] = AGG_NONE;
+    }
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_DEC && p->code.result.kind == OP_TEMP) {
+            labels->temp[p->code.result.u.var_id] = decs->size;
+            pushGen(decs, p);
+        }
+    }
+    if (decs->size == 0) {
+        free(decs->gen);
+        freeAggLabels(labels);
+        return false;
+    }
+
+    // propagate labels along copies and address arithmetic
+    bool again = true;
+    while (again) {
+        again = false;
+        for (InterCodes* p = codes; p != NULL; p = p->next) {
+            Operand sources[2];
+            int n = pointerSources(p, sources);
+            for (int i = 0; i < n; i++) {
+                bool* ext;
+                int label = getAggLabel(labels, sources[i], &ext);
+                if (label != AGG_NONE && addAggLabel(labels, p->code.result, label)) {
+                    again = true;
+                }
+            }
+        }
+    }
+    // a labelled operand that may also hold some other address (a struct
+    // parameter, say) is "external": stores through it must stay
+    again = true;
+    while (again) {
+        again = false;
+        for (InterCodes* p = codes; p != NULL; p = p->next) {
+            if (!isDefinition(p) || p->code.kind == IR_DEC) continue;
+            bool* ext;
+            if (getAggLabel(labels, p->code.result, &ext) == AGG_NONE || *ext) continue;
+            Operand sources[2];
+            int n = pointerSources(p, sources);
+            bool derived = false, external = false;
+            for (int i = 0; i < n; i++) {
+                bool* src_ext;
+                if (getAggLabel(labels, sources[i], &src_ext) != AGG_NONE) {
+                    derived = true;
+                    external = external || *src_ext;
+                }
+            }
+            if (!derived || external) {
+                *ext = true;
+                again = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+// remove stores into local aggregates that are never loaded from and do not
+// escape, together with their DEC and address-of
+static InterCodes* eliminateUnobservedAggregates(InterCodes* codes, bool *changed) {
+    struct GenNode decs;
+    struct AggLabels labels;
+    if (!computeAggLabels(codes, &decs, &labels)) {
+        return codes;
+    }
+
+    // an aggregate is observed when it is loaded from or its address escapes
+    bool* observed = (bool*)calloc(decs.size, sizeof(bool));
+    bool give_up = false;
+    for (InterCodes* p = codes; p != NULL && !give_up; p = p->next) {
+        Operand escapes[2];
+        int n = 0;
+        switch (p->code.kind) {
+            case IR_DEREF_R: escapes[n++] = p->code.arg1; break;
+            case IR_DEREF_L: escapes[n++] = p->code.arg1; break;
+            case IR_SUB: case IR_CMOV: escapes[n++] = p->code.arg2; break;
+            case IR_MUL: case IR_DIV: case IR_RELOP: case IR_SETREL:
+                escapes[n++] = p->code.arg1;
+                escapes[n++] = p->code.arg2;
+                break;
+            case IR_ARG: case IR_RETURN: case IR_WRITE:
+                escapes[n++] = p->code.result;
+                break;
+            default: break;
+        }
+        for (int i = 0; i < n; i++) {
+            bool* ext;
+            int label = getAggLabel(&labels, escapes[i], &ext);
+            if (label == AGG_CONFLICT) {
+                give_up = true;
+            } else if (label != AGG_NONE) {
+                observed[label] = true;
+            }
+        }
+    }
+
+    if (!give_up) {
+        bool* kept = (bool*)calloc(decs.size, sizeof(bool));
+        for (InterCodes* p = codes; p != NULL; ) {
+            InterCodes* next = p->next;
+            if (p->code.kind == IR_DEREF_L) {
+                bool* ext;
+                int label = getAggLabel(&labels, p->code.result, &ext);
+                if (label >= 0 && !observed[label]) {
+                    if (*ext) {
+                        kept[label] = true;
+                    } else {
+                        *changed = true;
+                        stats_add("memory", "unread aggregate code deleted", 1);
+                        codes = deleteInterCode(codes, p);
+                    }
+                }
+            }
+            p = next;
+        }
+        for (InterCodes* p = codes; p != NULL; ) {
+            InterCodes* next = p->next;
+            int label = AGG_NONE;
+            if (p->code.kind == IR_DEC && p->code.result.kind == OP_TEMP) {
+                label = labels.temp[p->code.result.u.var_id];
+            } else if (p->code.kind == IR_ADDR && p->code.arg1.kind == OP_TEMP) {
+                label = labels.temp[p->code.arg1.u.var_id];
+            }
+            if (label >= 0 && !observed[label] && !kept[label]) {
+                *changed = true;
+                stats_add("memory", "unread aggregate code deleted", 1);
+                codes = deleteInterCode(codes, p);
+            }
+            p = next;
+        }
+        free(kept);
+    }
+
+    free(observed);
+    free(decs.gen);
+    freeAggLabels(&labels);
+    return codes;
+}
+
+#define SRA_MAX_SIZE 64     // bytes of an aggregate worth splitting into temps
+
+// a labelled operand used anywhere but where an address may go makes the
+// aggregate unsplittable
+static void checkAggUse(struct AggLabels* labels, bool* splittable, Operand op, bool address_use) {
+    bool* ext;
+    int label = getAggLabel(labels, op, &ext);
+    if (label >= 0 && !address_use) splittable[label] = false;
+}
+
+// the single definition of each address into an aggregate, by operand
+struct AggDefs {
+    struct OperandNumbers operands;
+    InterCodes** def;
+    int var_defs;   // how many are definitions of variables
+};
+
+static InterCodes* findAggDef(struct AggDefs* defs, Operand op) {
+    int i = operandIndex(&defs->operands, op);
+    return i < 0 ? NULL : defs->def[i];
+}
+
+// constant offset of the address op into its aggregate
+static bool resolveAggOffset(struct AggDefs* defs, Operand op, int* off) {
+    *off = 0;
+    // single definitions may still form a cycle, x := x + #4 in a loop
+    for (int depth = 0; depth <= defs->var_defs + SRA_MAX_SIZE; depth++) {
+        InterCodes* def = findAggDef(defs, op);
+        if (def == NULL) return false;
+        switch (def->code.kind) {
+            case IR_ADDR: return true;
+            case IR_ASSIGN: break;
+            case IR_ADD: *off += def->code.arg2.u.value; break;
+            default: return false;
+        }
+        op = def->code.arg1;
+    }
+    return false;
+}
+
+// replace arrays and structs that do not escape and are only accessed at
+// constant offsets by one temporary per word
+static InterCodes* scalarReplaceAggregates(InterCodes* codes, bool *changed) {
+    struct GenNode decs;
+    struct AggLabels labels;
+    if (!computeAggLabels(codes, &decs, &labels)) {
+        return codes;
+    }
+    bool* splittable = (bool*)malloc(sizeof(bool) * decs.size);
+    for (int i = 0; i < decs.size; i++) {
+        splittable[i] = decs.gen[i]->code.size <= SRA_MAX_SIZE;
+    }
+
+    // every address derived from the aggregate has one definition, a copy
+    // or a constant offset of another address, and is only dereferenced
+    struct AggDefs defs;
+    numberOperands(codes, &defs.operands);
+    defs.def = (InterCodes**)calloc(defs.operands.size, sizeof(InterCodes*));
+    defs.var_defs = 0;
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        bool* ext;
+        int label;
+        if (isDefinition(p) && (label = getAggLabel(&labels, p->code.result, &ext)) != AGG_NONE) {
+            if (label == AGG_CONFLICT) {
+                for (int i = 0; i < decs.size; i++) splittable[i] = false;
+                break;
+            }
+            bool is_address = p->code.kind == IR_ADDR || p->code.kind == IR_ASSIGN
+                || (p->code.kind == IR_ADD && p->code.arg2.kind == OP_CONSTANT);
+            if (*ext || !is_address || findAggDef(&defs, p->code.result) != NULL) {
+                splittable[label] = false;
             } else {
-                i++;
+                defs.def[operandIndex(&defs.operands, p->code.result)] = p;
+                if (p->code.result.kind == OP_VARIABLE) defs.var_defs++;
+            }
+        }
+        switch (p->code.kind) {
+            case IR_DEC: break;
+            case IR_ASSIGN: case IR_ADDR: case IR_DEREF_R:
+                checkAggUse(&labels, splittable, p->code.arg1, true);
+                break;
+            case IR_ADD:
+                checkAggUse(&labels, splittable, p->code.arg1, p->code.arg2.kind == OP_CONSTANT);
+                checkAggUse(&labels, splittable, p->code.arg2, false);
+                break;
+            case IR_DEREF_L:
+                checkAggUse(&labels, splittable, p->code.result, true);
+                checkAggUse(&labels, splittable, p->code.arg1, false);
+                break;
+            default: {
+                Operand uses[3];
+                int n = getUsedOperands(p, uses);
+                for (int i = 0; i < n; i++) {
+                    checkAggUse(&labels, splittable, uses[i], false);
+                }
+                break;
             }
         }
     }
-    // remove dead codes
-    for (int i = 0; i < dead_codes.size; i++) {
+
+    // every access lands on a whole word inside the aggregate
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind != IR_DEREF_R && p->code.kind != IR_DEREF_L) continue;
+        Operand addr = p->code.kind == IR_DEREF_R ? p->code.arg1 : p->code.result;
+        bool* ext;
+        int label = getAggLabel(&labels, addr, &ext), off;
+        if (label < 0 || !splittable[label]) continue;
+        if (!resolveAggOffset(&defs, addr, &off)
+            || off < 0 || off >= decs.gen[label]->code.size || off % 4 != 0) {
+            splittable[label] = false;
+        }
+    }
+
+    // rewrite loads and stores as copies from and to the word temporaries
+    int** words = (int**)calloc(decs.size, sizeof(int*));
+    bool** read_first = (bool**)calloc(decs.size, sizeof(bool*));
+    for (int i = 0; i < decs.size; i++) {
+        if (splittable[i]) {
+            words[i] = (int*)calloc(decs.gen[i]->code.size / 4, sizeof(int));
+            read_first[i] = (bool*)calloc(decs.gen[i]->code.size / 4, sizeof(bool));
+        }
+    }
+    for (InterCodes* p = codes; p != NULL; ) {
+        InterCodes* next = p->next;
+        bool* ext;
+        int label, off;
+        if (p->code.kind == IR_DEREF_R || p->code.kind == IR_DEREF_L) {
+            Operand addr = p->code.kind == IR_DEREF_R ? p->code.arg1 : p->code.result;
+            label = getAggLabel(&labels, addr, &ext);
+            if (label >= 0 && splittable[label]) {
+                resolveAggOffset(&defs, addr, &off);
+                int* word = &words[label][off / 4];
+                if (*word == 0) {
+                    *word = newVariableId();
+                    read_first[label][off / 4] = p->code.kind == IR_DEREF_R;
+                }
+                if (p->code.kind == IR_DEREF_R) {
+                    p->code.arg1 = tempOperand(*word);
+                } else {
+                    p->code.result = tempOperand(*word);
+                }
+                p->code.kind = IR_ASSIGN;
+                *changed = true;
+                stats_add("memory", "accesses scalar-replaced", 1);
+            }
+        } else if (isDefinition(p) && (label = getAggLabel(&labels, p->code.result, &ext)) >= 0
+                   && splittable[label]) {
+            codes = deleteInterCode(codes, p);
+        }
+        p = next;
+    }
+    // a word that may be read before it is written starts out as zero where
+    // the aggregate was declared
+    for (int i = 0; i < decs.size; i++) {
+        if (!splittable[i]) continue;
+        InterCodes* dec = decs.gen[i];
+        for (int w = 0; w < dec->code.size / 4; w++) {
+            if (words[i][w] == 0 || !read_first[i][w]) continue;
+            InterCodes* init = newInterCodes();
+            init->code.kind = IR_ASSIGN;
+            init->code.result = tempOperand(words[i][w]);
+            init->code.arg1 = constantOperand(0);
+            insertBefore(dec, init);
+        }
+        *changed = true;
+        stats_add("memory", "aggregates split", 1);
+        codes = deleteInterCode(codes, dec);
+        free(words[i]);
+        free(read_first[i]);
+    }
+
+    free(words);
+    free(read_first);
+    free(defs.def);
+    freeSymbolMap(&defs.operands.vars);
+    free(splittable);
+    free(decs.gen);
+    freeAggLabels(&labels);
+    return codes;
+}
+
+InterCodes* optimize_memory(InterCodes* codes, bool *changed) {
+    codes = scalarReplaceAggregates(codes, changed);
+    codes = eliminateOverwrittenStores(codes, changed);
+    codes = eliminateUnobservedAggregates(codes, changed);
+    return codes;
+}
+
+// limits on what is worth executing unconditionally
+#define IFCONV_MAX_ARM   3  // instructions in one arm
+#define IFCONV_MAX_TOTAL 4  // instructions in both arms
+#define IFCONV_MAX_MERGE 2  // values selected at the join
+
+// side effect free instructions that are safe to run speculatively
+static bool isSpeculatableCode(InterCodes* p) {
+    switch (p->code.kind) {
+        case IR_ASSIGN: case IR_ADD: case IR_SUB: case IR_MUL: case IR_SETREL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// instructions of an arm starting at p, NULL if the arm is too long
+static InterCodes* scanArm(InterCodes* p, int* count) {
+    *count = 0;
+    while (p != NULL && isSpeculatableCode(p)) {
+        if (++(*count) > IFCONV_MAX_ARM) return NULL;
+        p = p->next;
+    }
+    return p;
+}
+
+struct ArmRenames {
+    int size;
+    Operand orig[IFCONV_MAX_ARM];
+    Operand now[IFCONV_MAX_ARM];
+};
+
+static Operand *findRename(struct ArmRenames* r, Operand op) {
+    for (int i = 0; i < r->size; i++) {
+        if (isOperandEqual(r->orig[i], op)) return &r->now[i];
+    }
+    return NULL;
+}
+
+// let the arm [first, last) write fresh temporaries instead of its results;
+// it now also runs when the branch skipped it, so it must not trap
+static void renameArm(InterCodes* first, InterCodes* last, struct ArmRenames* r) {
+    r->size = 0;
+    for (InterCodes* p = first; p != last; p = p->next) {
+        p->code.wraps = true;
+        Operand* now = findRename(r, p->code.arg1);
+        if (now != NULL) p->code.arg1 = *now;
+        if (p->code.kind != IR_ASSIGN) {
+            now = findRename(r, p->code.arg2);
+            if (now != NULL) p->code.arg2 = *now;
+        }
+        Operand fresh = tempOperand(newVariableId());
+        now = findRename(r, p->code.result);
+        if (now == NULL) {
+            r->orig[r->size] = p->code.result;
+            now = &r->now[r->size++];
+        }
+        *now = fresh;
+        p->code.result = fresh;
+    }
+}
+
+static InterCodes* genCMovCode(Operand result, Operand value, enum RELOP_TYPE relop, Operand cond) {
+    InterCodes* codes = newInterCodes();
+    codes->code.kind = IR_CMOV;
+    codes->code.relop = relop;
+    codes->code.result = result;
+    codes->code.arg1 = value;
+    codes->code.arg2 = cond;
+    return codes;
+}
+
+// does a merge need to be emitted for what the arm wrote to op?
+static bool isLiveAfterArm(Operand op, int* temp_uses, int* arm_uses) {
+    if (op.kind != OP_TEMP) return true;
+    if (op.u.var_id > variableId || temp_uses == NULL) return true;
+    return temp_uses[op.u.var_id] > arm_uses[op.u.var_id];
+}
+
+// add delta to arm_uses for every temporary the arm [first, last) reads
+static void countArmUses(InterCodes* first, InterCodes* last, int* arm_uses, int delta) {
+    for (InterCodes* p = first; p != last; p = p->next) {
+        Operand uses[3];
+        int n = getUsedOperands(p, uses);
+        for (int i = 0; i < n; i++) {
+            if (uses[i].kind == OP_TEMP) arm_uses[uses[i].u.var_id] += delta;
+        }
+    }
+}
+
+// turn short if-then and if-then-else regions into straight line code:
+//      IF a < b GOTO Lj            tc := a < b
+//      <fall arm>                  <fall arm, writing fresh temps>
+//      GOTO Le             ->      <jump arm, writing fresh temps>
+//      LABEL Lj                    x := vFall
+//      <jump arm>                  IF tc != #0 THEN x := vJump
+//      LABEL Le
+// and the same without the jump arm for IF a < b GOTO Lj; <fall arm>; LABEL Lj
+InterCodes* optimize_if_conversion(InterCodes* codes, bool *changed) {
+    int* label_refs = (int*)calloc(labelId + 1, sizeof(int));
+    int* temp_uses = (int*)calloc(variableId + 1, sizeof(int));
+    int* arm_uses = (int*)calloc(variableId + 1, sizeof(int));
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if ((p->code.kind == IR_GOTO || p->code.kind == IR_RELOP) && p->code.result.u.label_id <= labelId) {
+            label_refs[p->code.result.u.label_id]++;
+        }
+        Operand uses[3];
+        int n = getUsedOperands(p, uses);
+        for (int i = 0; i < n; i++) {
+            if (uses[i].kind == OP_TEMP) temp_uses[uses[i].u.var_id]++;
+        }
+    }
+
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind != IR_RELOP) continue;
+        int label_jump = p->code.result.u.label_id;
+
+        // shape of the region
+        int fall_count, jump_count = 0;
+        InterCodes* fall_first = p->next;
+        InterCodes* fall_end = scanArm(fall_first, &fall_count);
+        InterCodes *jump_first = NULL, *jump_end = NULL, *join;
+        if (fall_end == NULL) continue;
+        if (fall_end->code.kind == IR_LABEL && fall_end->code.result.u.label_id == label_jump) {
+            join = fall_end;
+        } else if (fall_end->code.kind == IR_GOTO && fall_end->next != NULL
+                   && fall_end->next->code.kind == IR_LABEL
+                   && fall_end->next->code.result.u.label_id == label_jump
+                   && label_refs[label_jump] == 1) {
+            jump_first = fall_end->next->next;
+            jump_end = scanArm(jump_first, &jump_count);
+            if (jump_end == NULL || jump_end->code.kind != IR_LABEL
+                || jump_end->code.result.u.label_id != fall_end->code.result.u.label_id) {
+                continue;
+            }
+            join = jump_end;
+        } else {
+            continue;
+        }
+        if (fall_count + jump_count > IFCONV_MAX_TOTAL) continue;
+
+        // values written by the arms that are read after the join
+        countArmUses(fall_first, fall_end, arm_uses, 1);
+        if (jump_first != NULL) countArmUses(jump_first, jump_end, arm_uses, 1);
+        int nmerges = 0;
+        Operand merges[2 * IFCONV_MAX_ARM];
+        InterCodes* first[2] = { fall_first, jump_first };
+        InterCodes* last[2] = { fall_end, jump_end };
+        for (int a = 0; a < 2; a++) {
+            for (InterCodes* q = first[a]; q != NULL && q != last[a]; q = q->next) {
+                bool seen = false;
+                for (int i = 0; i < nmerges && !seen; i++) {
+                    seen = isOperandEqual(merges[i], q->code.result);
+                }
+                if (!seen && isLiveAfterArm(q->code.result, temp_uses, arm_uses)) {
+                    merges[nmerges++] = q->code.result;
+                }
+            }
+        }
+        // back to all zero, clearing the whole array per branch is quadratic
+        countArmUses(fall_first, fall_end, arm_uses, -1);
+        if (jump_first != NULL) countArmUses(jump_first, jump_end, arm_uses, -1);
+        if (nmerges > IFCONV_MAX_MERGE) continue;
+
+        // rewrite
         *changed = true;
-        if (dead_codes.gen[i]->next != NULL) {
-            dead_codes.gen[i]->next->prev = dead_codes.gen[i]->prev;
+        stats_add("if-conversion", "branches converted", 1);
+        Operand cond = tempOperand(newVariableId());
+        struct ArmRenames fall, jump;
+        renameArm(fall_first, fall_end, &fall);
+        jump.size = 0;
+        if (jump_first != NULL) {
+            renameArm(jump_first, jump_end, &jump);
+            codes = deleteInterCode(codes, fall_end->next);     // LABEL Lj
+            codes = deleteInterCode(codes, fall_end);           // GOTO Le
+            stats_add("if-conversion", "labels removed", 1);
+        }
+        p->code.kind = IR_SETREL;
+        p->code.result = cond;
+        for (int i = 0; i < nmerges; i++) {
+            Operand *v_fall = findRename(&fall, merges[i]);
+            Operand *v_jump = findRename(&jump, merges[i]);
+            InterCodes* merge;
+            if (v_fall != NULL && v_jump != NULL) {
+                merge = newInterCodes();
+                merge->code.kind = IR_ASSIGN;
+                merge->code.result = merges[i];
+                merge->code.arg1 = *v_fall;
+                insertBefore(join, merge);
+                merge = genCMovCode(merges[i], *v_jump, RELOP_NE, cond);
+            } else if (v_jump != NULL) {
+                merge = genCMovCode(merges[i], *v_jump, RELOP_NE, cond);
+            } else {
+                merge = genCMovCode(merges[i], *v_fall, RELOP_EQ, cond);
+            }
+            insertBefore(join, merge);
+            stats_add("if-conversion", "conditional moves", 1);
         }
-        if (dead_codes.gen[i]->prev != NULL) {
-            dead_codes.gen[i]->prev->next = dead_codes.gen[i]->next;
+        // the join stays a label when something else jumps there
+        if (--label_refs[join->code.result.u.label_id] == 0) {
+            stats_add("if-conversion", "labels removed", 1);
+            p = join->prev;
+            codes = deleteInterCode(codes, join);
         } else {
-            codes = dead_codes.gen[i]->next;
+            p = join;
         }
     }
 
+    free(label_refs);
+    free(temp_uses);
+    free(arm_uses);
     return codes;
 }
 
@@ -1400,8 +2816,27 @@ InterCodes* optimize_ir(InterCodes* codes) {
     bool changed = false;
     int step = 1;
     do {
-        codes = optimize_one_run(codes, &changed);
-        // fprintf(stderr, "optim %d\n", step++);
+        stats_add("optimize", "iterations", 1);
+        do {
+            stats_add("optimize", "local iterations", 1);
+            timer_begin("local passes");
+            codes = optimize_one_run(codes, &changed);
+            timer_end();
+            // fprintf(stderr, "optim %d\n", step++);
+        } while (changed);
+        // dead functions, parameters and return values
+        timer_begin("call graph");
+        stats_ir_before(codes);
+        codes = optimize_call_graph(codes, &changed);
+        stats_ir_after("call graph", codes);
+        timer_end();
+        bool converted = false;
+        timer_begin("if-conversion");
+        stats_ir_before(codes);
+        codes = optimize_if_conversion(codes, &converted);
+        stats_ir_after("if-conversion", codes);
+        timer_end();
+        changed = changed || converted;
     } while (changed);
     return codes;
 }
\ No newline at end of file
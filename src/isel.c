@@ -0,0 +1,164 @@
+#include "isel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// how far back from a load or store its address computation is looked for
+#define ISEL_MAX_DISTANCE 8
+
+// indexed by temp id
+static InterCodes **def_of;
+static int *ndefs, *nuses;
+static bool *folded;
+static int capacity;
+
+// upper bound of the frame size of the function being selected, so that
+// frame offsets are known to fit in an immediate
+static int frame_bound;
+
+static bool is_folded_temp(Operand* op) {
+    return op->kind == OP_TEMP && op->u.var_id < capacity && folded[op->u.var_id];
+}
+
+// the single definition of the single-use temp op, if it is in the block of
+// use and not too far before it
+static InterCodes* local_def(Operand* op, InterCodes* use) {
+    if (op->kind != OP_TEMP || op->u.var_id >= capacity) return NULL;
+    int id = op->u.var_id;
+    if (ndefs[id] != 1 || nuses[id] != 1) return NULL;
+    InterCodes* p = use->prev;
+    for (int k = 0; p != NULL && k < ISEL_MAX_DISTANCE; p = p->prev, k++) {
+        if (p == def_of[id]) return p;
+        switch (p->code.kind) {
+            case IR_LABEL: case IR_FUNC: case IR_GOTO: case IR_RELOP: case IR_RETURN:
+                return NULL;
+            default: break;
+        }
+    }
+    return NULL;
+}
+
+// d computes base + off
+static bool offset_form(InterCodes* d, Operand** base, int* off) {
+    Operand *a1 = &d->code.arg1, *a2 = &d->code.arg2;
+    if (d->code.kind == IR_ADD && a2->kind == OP_CONSTANT && a1->kind != OP_CONSTANT) {
+        *base = a1;
+        *off = a2->u.value;
+    } else if (d->code.kind == IR_ADD && a1->kind == OP_CONSTANT && a2->kind != OP_CONSTANT) {
+        *base = a2;
+        *off = a1->u.value;
+    } else if (d->code.kind == IR_SUB && a2->kind == OP_CONSTANT && a1->kind != OP_CONSTANT
+        && a2->u.value != IMM_MIN) {
+        *base = a1;
+        *off = -a2->u.value;
+    } else {
+        return false;
+    }
+    return *off >= IMM_MIN && *off <= IMM_MAX;
+}
+
+// op may change between from and to, both excluded
+static bool clobbered(InterCodes* from, InterCodes* to, Operand* op) {
+    for (InterCodes* p = from->next; p != to; p = p->next) {
+        if (isDefinition(p) && isOperandEqual(p->code.result, *op)) return true;
+        if (op->kind == OP_VARIABLE && (p->code.kind == IR_DEREF_L || p->code.kind == IR_CALL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// fold the address op read by use, off being the offset folded so far
+static void fold_address(Operand* op, InterCodes* use, int off) {
+    InterCodes* d = local_def(op, use);
+    if (d == NULL) return;
+    if (d->code.kind == IR_ADDR) {
+        if (frame_bound + abs(off) <= IMM_MAX) folded[op->u.var_id] = true;
+        return;
+    }
+    Operand* base;
+    int c;
+    if (!offset_form(d, &base, &c)) return;
+    off += c;
+    if (off < IMM_MIN || off > IMM_MAX || clobbered(d, use, base)) return;
+    folded[op->u.var_id] = true;
+    fold_address(base, use, off);
+}
+
+void isel_select(InterCodes* ics) {
+    capacity = variableId + 1;
+    def_of = (InterCodes**)realloc(def_of, sizeof(InterCodes*) * capacity);
+    ndefs = (int*)realloc(ndefs, sizeof(int) * capacity);
+    nuses = (int*)realloc(nuses, sizeof(int) * capacity);
+    folded = (bool*)realloc(folded, sizeof(bool) * capacity);
+    memset(ndefs, 0, sizeof(int) * capacity);
+    memset(nuses, 0, sizeof(int) * capacity);
+    memset(folded, 0, sizeof(bool) * capacity);
+
+    for (InterCodes* p = ics; p != NULL; p = p->next) {
+        if (isDefinition(p) && p->code.result.kind == OP_TEMP) {
+            assert(p->code.result.u.var_id < capacity);
+            ndefs[p->code.result.u.var_id]++;
+            def_of[p->code.result.u.var_id] = p;
+        }
+        Operand uses[3];
+        int n = getUsedOperands(p, uses);
+        for (int i = 0; i < n; i++) {
+            if (uses[i].kind == OP_TEMP) nuses[uses[i].u.var_id]++;
+        }
+    }
+
+    for (InterCodes* func = ics; func != NULL; ) {
+        InterCodes* end = func->next;
+        while (end != NULL && end->code.kind != IR_FUNC) end = end->next;
+        // arrays, saved registers and a word for every operand
+        frame_bound = 64;
+        for (InterCodes* p = func; p != end; p = p->next) {
+            frame_bound += p->code.kind == IR_DEC ? p->code.size : 12;
+        }
+        for (InterCodes* p = func; p != end; p = p->next) {
+            if (p->code.kind == IR_DEREF_R) {
+                fold_address(&p->code.arg1, p, 0);
+            } else if (p->code.kind == IR_DEREF_L) {
+                fold_address(&p->code.result, p, 0);
+            }
+        }
+        func = end;
+    }
+}
+
+bool isel_folded(InterCodes* p) {
+    return isDefinition(p) && is_folded_temp(&p->code.result);
+}
+
+bool isel_defines(InterCodes* p) {
+    return isDefinition(p) && !is_folded_temp(&p->code.result);
+}
+
+int isel_uses(InterCodes* p, Operand uses[3]) {
+    if (isel_folded(p)) return 0;
+    int n = getUsedOperands(p, uses);
+    for (int i = 0; i < n; i++) {
+        IselAddr a = isel_address(&uses[i]);
+        uses[i] = a.base;
+    }
+    return n;
+}
+
+IselAddr isel_address(Operand* opd) {
+    IselAddr a = { *opd, false, 0 };
+    while (is_folded_temp(&a.base)) {
+        InterCodes* d = def_of[a.base.u.var_id];
+        if (d->code.kind == IR_ADDR) {
+            a.base = d->code.arg1;
+            a.in_frame = true;
+            break;
+        }
+        Operand* base;
+        int c;
+        offset_form(d, &base, &c);
+        a.base = *base;
+        a.off += c;
+    }
+    return a;
+}
@@ -0,0 +1,133 @@
+#include "memstat.h"
+#include <stdlib.h>
+#include <string.h>
+
+// in front of every tracked block, keeping the alignment of malloc
+typedef union {
+    struct {
+        size_t size;
+        MemTag tag;
+    } h;
+    max_align_t align;
+} Header;
+
+typedef struct {
+    long long objects, bytes, peak_bytes;
+} TagUsage;
+
+typedef struct {
+    const char *phase;
+    TagUsage tags[MEM_NUM];
+    long long peak;         // of all tags together, up to the end of the phase
+} Checkpoint;
+
+#define MEM_MAX_CHECKPOINTS 16
+
+static const char *tag_names[MEM_NUM] = { "ast", "symbol", "type", "ir", "lva" };
+
+static bool started;
+static long long alloc_count, alloc_bytes;
+static long long budget;
+static TagUsage usage[MEM_NUM];
+static long long live, peak;
+static Checkpoint checkpoints[MEM_MAX_CHECKPOINTS];
+static int ncheckpoints;
+
+static void track(MemTag tag, long long objects, long long bytes) {
+    usage[tag].objects += objects;
+    usage[tag].bytes += bytes;
+    if (usage[tag].bytes > usage[tag].peak_bytes) usage[tag].peak_bytes = usage[tag].bytes;
+    live += bytes;
+    if (live > peak) peak = live;
+}
+
+static void* wrap(Header *h, MemTag tag, size_t size) {
+    if (h == NULL) return NULL;
+    h->h.size = size;
+    h->h.tag = tag;
+    track(tag, 1, (long long)size);
+    return h + 1;
+}
+
+static void count_alloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += (long long)size;
+}
+
+void* mem_alloc(MemTag tag, size_t size) {
+    count_alloc(size);
+    if (!started) return malloc(size);
+    return wrap((Header*)malloc(sizeof(Header) + size), tag, size);
+}
+
+void* mem_calloc(MemTag tag, size_t n, size_t size) {
+    count_alloc(n * size);
+    if (!started) return calloc(n, size);
+    return wrap((Header*)calloc(1, sizeof(Header) + n * size), tag, n * size);
+}
+
+void* mem_realloc(MemTag tag, void *p, size_t size) {
+    if (p == NULL) return mem_alloc(tag, size);
+    count_alloc(size);
+    if (!started) return realloc(p, size);
+    Header *h = (Header*)p - 1;
+    MemTag old_tag = h->h.tag;
+    track(old_tag, -1, -(long long)h->h.size);
+    return wrap((Header*)realloc(h, sizeof(Header) + size), tag, size);
+}
+
+void mem_free(void *p) {
+    if (!started) {
+        free(p);
+        return;
+    }
+    if (p == NULL) return;
+    Header *h = (Header*)p - 1;
+    track(h->h.tag, -1, -(long long)h->h.size);
+    free(h);
+}
+
+void mem_allocations(long long *count, long long *bytes) {
+    *count = alloc_count;
+    *bytes = alloc_bytes;
+}
+
+void mem_start(long long limit) {
+    started = true;
+    budget = limit;
+}
+
+void mem_checkpoint(const char *phase) {
+    if (!started || ncheckpoints == MEM_MAX_CHECKPOINTS) return;
+    Checkpoint *c = &checkpoints[ncheckpoints++];
+    c->phase = phase;
+    memcpy(c->tags, usage, sizeof(usage));
+    c->peak = peak;
+}
+
+void mem_report(FILE *out) {
+    if (!started) return;
+    fprintf(out, "%-12s %-8s %10s %12s %12s\n", "after", "tag", "objects", "live KB", "peak KB");
+    for (int i = 0; i < ncheckpoints; i++) {
+        Checkpoint *c = &checkpoints[i];
+        long long objects = 0, bytes = 0;
+        for (int t = 0; t < MEM_NUM; t++) {
+            TagUsage *u = &c->tags[t];
+            objects += u->objects;
+            bytes += u->bytes;
+            if (u->peak_bytes == 0) continue;
+            fprintf(out, "%-12s %-8s %10lld %12.1f %12.1f\n", c->phase, tag_names[t],
+                u->objects, u->bytes / 1024.0, u->peak_bytes / 1024.0);
+        }
+        fprintf(out, "%-12s %-8s %10lld %12.1f %12.1f\n", c->phase, "total", objects, bytes / 1024.0, c->peak / 1024.0);
+    }
+    fprintf(out, "peak of all tags: %.1f KB", peak / 1024.0);
+    if (budget > 0) fprintf(out, ", budget %.1f KB", budget / 1024.0);
+    fprintf(out, "\n");
+}
+
+bool mem_over_budget(FILE *out) {
+    if (!started || budget <= 0 || peak <= budget) return false;
+    fprintf(out, "error: tracked memory peaked at %lld bytes, over the budget of %lld bytes\n", peak, budget);
+    return true;
+}
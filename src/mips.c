@@ -0,0 +1,485 @@
+#include "mips.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+
+const MipsOpInfo mips_ops[MI_NUM_OPS] = {
+    [MI_ENTRY]   = { "",        MF_L,    0, 0, 0 },
+    [MI_LABEL]   = { "",        MF_L,    0, 0, 0 },
+    [MI_LI]      = { "li",      MF_RI,   1, 0, 1 },
+    [MI_LA]      = { "la",      MF_RL,   1, 0, 1 },
+    [MI_MOVE]    = { "move",    MF_RR,   1, 2, 1 },
+    [MI_ADD]     = { "add",     MF_RRR,  1, 6, 1 },
+    [MI_ADDU]    = { "addu",    MF_RRR,  1, 6, 1 },
+    [MI_SUB]     = { "sub",     MF_RRR,  1, 6, 1 },
+    [MI_SUBU]    = { "subu",    MF_RRR,  1, 6, 1 },
+    [MI_MUL]     = { "mul",     MF_RRR,  1, 6, 2 },
+    [MI_SLT]     = { "slt",     MF_RRR,  1, 6, 1 },
+    [MI_SLTU]    = { "sltu",    MF_RRR,  1, 6, 1 },
+    [MI_XOR]     = { "xor",     MF_RRR,  1, 6, 1 },
+    [MI_MOVN]    = { "movn",    MF_RRR,  1, 7, 1 },
+    [MI_MOVZ]    = { "movz",    MF_RRR,  1, 7, 1 },
+    [MI_ADDI]    = { "addi",    MF_RRI,  1, 2, 1 },
+    [MI_ADDIU]   = { "addiu",   MF_RRI,  1, 2, 1 },
+    [MI_XORI]    = { "xori",    MF_RRI,  1, 2, 1 },
+    [MI_SLTI]    = { "slti",    MF_RRI,  1, 2, 1 },
+    [MI_SLTIU]   = { "sltiu",   MF_RRI,  1, 2, 1 },
+    [MI_SLL]     = { "sll",     MF_RRI,  1, 2, 1 },
+    [MI_SRA]     = { "sra",     MF_RRI,  1, 2, 1 },
+    [MI_SRL]     = { "srl",     MF_RRI,  1, 2, 1 },
+    [MI_MULT]    = { "mult",    MF_RR,   0, 3, 4 },
+    [MI_DIV]     = { "div",     MF_RR,   0, 3, 12 },
+    [MI_MFHI]    = { "mfhi",    MF_R,    1, 0, 1 },
+    [MI_MFLO]    = { "mflo",    MF_R,    1, 0, 1 },
+    [MI_LW]      = { "lw",      MF_MEM,  1, 2, 2 },
+    [MI_SW]      = { "sw",      MF_MEM,  0, 3, 1 },
+    [MI_BEQ]     = { "beq",     MF_RRL,  0, 3, 1 },
+    [MI_BNE]     = { "bne",     MF_RRL,  0, 3, 1 },
+    [MI_BGT]     = { "bgt",     MF_RRL,  0, 3, 1 },
+    [MI_BLT]     = { "blt",     MF_RRL,  0, 3, 1 },
+    [MI_BGE]     = { "bge",     MF_RRL,  0, 3, 1 },
+    [MI_BLE]     = { "ble",     MF_RRL,  0, 3, 1 },
+    [MI_BEQZ]    = { "beqz",    MF_RL,   0, 1, 1 },
+    [MI_BNEZ]    = { "bnez",    MF_RL,   0, 1, 1 },
+    [MI_BGTZ]    = { "bgtz",    MF_RL,   0, 1, 1 },
+    [MI_BLTZ]    = { "bltz",    MF_RL,   0, 1, 1 },
+    [MI_BGEZ]    = { "bgez",    MF_RL,   0, 1, 1 },
+    [MI_BLEZ]    = { "blez",    MF_RL,   0, 1, 1 },
+    [MI_J]       = { "j",       MF_L,    0, 0, 1 },
+    [MI_JAL]     = { "jal",     MF_L,    0, 0, 1 },
+    [MI_JR]      = { "jr",      MF_R,    0, 1, 1 },
+    [MI_SYSCALL] = { "syscall", MF_NONE, 0, 0, 1 },
+    [MI_NOP]     = { "nop",     MF_NONE, 0, 0, 1 },
+};
+
+const char *mips_reg_names[MIPS_NUM_REGS] = {
+    "$0", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+static MipsIns *head, *tail;
+static MipsIns *removed;    // unlinked by the peephole pass, freed by mips_flush
+static int current_line;
+
+#define BIT(r) (1u << (r))
+#define ARG_REGS (BIT(MR_A0) | BIT(MR_A0 + 1) | BIT(MR_A0 + 2) | BIT(MR_A0 + 3))
+#define CALLEE_SAVED (0xffu << MR_S0)
+
+int mips_reg(const char *name) {
+    for (int i = 0; i < MIPS_NUM_REGS; i++) {
+        if (strcmp(name, mips_reg_names[i]) == 0) return i;
+    }
+    assert(0);
+    return -1;
+}
+
+MipsIns* mips_new(MipsOp op, int r0, int r1, int r2, int imm, const char *label) {
+    MipsIns *ins = (MipsIns*)malloc(sizeof(MipsIns));
+    ins->op = op;
+    ins->r[0] = r0;
+    ins->r[1] = r1;
+    ins->r[2] = r2;
+    ins->imm = imm;
+    ins->label = label != NULL ? strdup(label) : NULL;
+    ins->line = 0;
+    ins->prev = ins->next = NULL;
+    return ins;
+}
+
+void mips_set_line(int line) {
+    current_line = line;
+}
+
+MipsIns* mips_emit(MipsOp op, int r0, int r1, int r2, int imm, const char *label) {
+    MipsIns *ins = mips_new(op, r0, r1, r2, imm, label);
+    ins->line = current_line;
+    mips_insert_after(tail, ins);
+    return ins;
+}
+
+MipsIns* mips_first() {
+    return head;
+}
+
+void mips_insert_after(MipsIns *pos, MipsIns *ins) {
+    ins->prev = pos;
+    ins->next = pos != NULL ? pos->next : head;
+    if (ins->next != NULL) ins->next->prev = ins; else tail = ins;
+    if (pos != NULL) pos->next = ins; else head = ins;
+}
+
+void mips_unlink(MipsIns *ins) {
+    if (ins->prev != NULL) ins->prev->next = ins->next; else head = ins->next;
+    if (ins->next != NULL) ins->next->prev = ins->prev; else tail = ins->prev;
+    ins->prev = ins->next = NULL;
+}
+
+MipsIns* mips_emit_label(MipsOp op, const char *format, ...) {
+    char label[64];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(label, sizeof(label), format, ap);
+    va_end(ap);
+    return mips_emit(op, 0, 0, 0, 0, label);
+}
+
+unsigned mips_defs(MipsIns *ins) {
+    unsigned mask = 0;
+    for (int i = 0; i < 3; i++) {
+        if (mips_ops[ins->op].defs & (1u << i)) mask |= BIT(ins->r[i]);
+    }
+    switch (ins->op) {
+        // read and write leave the $t registers alone, so a call is only
+        // known to write its result and the return address
+        case MI_JAL: mask |= BIT(MR_V0) | BIT(MR_RA); break;
+        case MI_SYSCALL: mask |= BIT(MR_V0); break;
+        default: break;
+    }
+    return mask;
+}
+
+unsigned mips_uses(MipsIns *ins) {
+    unsigned mask = 0;
+    for (int i = 0; i < 3; i++) {
+        if (mips_ops[ins->op].uses & (1u << i)) mask |= BIT(ins->r[i]);
+    }
+    switch (ins->op) {
+        case MI_JAL: mask |= ARG_REGS | BIT(MR_SP); break;
+        case MI_JR: mask |= BIT(MR_V0) | BIT(MR_SP) | BIT(MR_FP) | CALLEE_SAVED; break;
+        case MI_SYSCALL: mask |= BIT(MR_V0) | BIT(MR_A0); break;
+        default: break;
+    }
+    return mask;
+}
+
+static bool is_branch(MipsOp op) {
+    return op >= MI_BEQ && op <= MI_BLEZ;
+}
+
+bool mips_has_delay_slot(MipsIns *ins) {
+    return is_branch(ins->op) || ins->op == MI_J || ins->op == MI_JAL || ins->op == MI_JR;
+}
+
+bool mips_is_boundary(MipsIns *ins) {
+    return ins->op == MI_ENTRY || ins->op == MI_LABEL || mips_has_delay_slot(ins)
+        || ins->op == MI_SYSCALL;
+}
+
+static void remove_ins(MipsIns *ins) {
+    MipsIns *prev = ins->prev;
+    mips_unlink(ins);
+    // keep ins->prev, the pass steps back through it
+    ins->prev = prev;
+    ins->next = removed;
+    removed = ins;
+}
+
+static bool ends_block(MipsIns *ins) {
+    return is_branch(ins->op) || ins->op == MI_J || ins->op == MI_JR;
+}
+
+typedef struct {
+    MipsIns *first, *last;
+    int succ[2], nsucc;
+    unsigned use, def, in, out;
+} MipsBlock;
+
+static unsigned hash_label(const char *s) {
+    unsigned h = 5381;
+    while (*s) h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+// registers live before every label and after every branch or jump, stored
+// in their live field; the rules only ever remove uses or move them within
+// a block, so the sets stay safe while the buffer is rewritten
+static void compute_liveness() {
+    int nblocks = 0, nlabels = 0;
+    for (MipsIns *p = head; p != NULL; p = p->next) {
+        if (p->op == MI_LABEL || p->op == MI_ENTRY) nlabels++;
+        if (p == head || p->op == MI_LABEL || p->op == MI_ENTRY || ends_block(p->prev)) nblocks++;
+    }
+    MipsBlock *blocks = (MipsBlock*)calloc(nblocks + 1, sizeof(MipsBlock));
+    int capacity = 16;
+    while (capacity < nlabels * 2) capacity *= 2;
+    MipsIns **labels = (MipsIns**)calloc(capacity, sizeof(MipsIns*));
+
+    int b = -1;
+    for (MipsIns *p = head; p != NULL; p = p->next) {
+        if (p == head || p->op == MI_LABEL || p->op == MI_ENTRY || ends_block(p->prev)) {
+            blocks[++b].first = p;
+        }
+        blocks[b].last = p;
+        p->block = b;
+        if (p->op == MI_LABEL || p->op == MI_ENTRY) {
+            unsigned h = hash_label(p->label) & (capacity - 1);
+            while (labels[h] != NULL) h = (h + 1) & (capacity - 1);
+            labels[h] = p;
+        }
+        blocks[b].use |= mips_uses(p) & ~blocks[b].def;
+        blocks[b].def |= mips_defs(p);
+    }
+    for (b = 0; b < nblocks; b++) {
+        MipsIns *last = blocks[b].last;
+        if (is_branch(last->op) || last->op == MI_J) {
+            unsigned h = hash_label(last->label) & (capacity - 1);
+            while (strcmp(labels[h]->label, last->label) != 0) h = (h + 1) & (capacity - 1);
+            blocks[b].succ[blocks[b].nsucc++] = labels[h]->block;
+        }
+        if (last->op != MI_J && last->op != MI_JR && b + 1 < nblocks
+            && blocks[b + 1].first->op != MI_ENTRY) {
+            blocks[b].succ[blocks[b].nsucc++] = b + 1;
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (b = nblocks - 1; b >= 0; b--) {
+            MipsBlock *blk = &blocks[b];
+            unsigned out = 0;
+            for (int i = 0; i < blk->nsucc; i++) out |= blocks[blk->succ[i]].in;
+            unsigned in = blk->use | (out & ~blk->def);
+            if (in != blk->in || out != blk->out) {
+                blk->in = in;
+                blk->out = out;
+                changed = true;
+            }
+        }
+    }
+    for (b = 0; b < nblocks; b++) {
+        blocks[b].first->live = blocks[b].in;
+        blocks[b].last->live = blocks[b].out;
+    }
+
+    free(labels);
+    free(blocks);
+}
+
+// the value in reg is not read after ins
+static bool dead_after(MipsIns *ins, int reg) {
+    for (MipsIns *p = ins->next; p != NULL; p = p->next) {
+        if (p->op == MI_ENTRY) return true;
+        if (p->op == MI_LABEL) return !(p->live & BIT(reg));
+        if (mips_uses(p) & BIT(reg)) return false;
+        if (ends_block(p)) return !(p->live & BIT(reg));
+        if (mips_defs(p) & BIT(reg)) return true;
+    }
+    return true;
+}
+
+// only writes its first register operand
+static bool is_pure_def(MipsIns *ins) {
+    const MipsOpInfo *info = &mips_ops[ins->op];
+    return info->defs == 1 && !(info->uses & 1) && ins->r[0] != MR_ZERO;
+}
+
+// move a, a
+static bool rule_self_move(MipsIns *ins) {
+    if (ins->op != MI_MOVE || ins->r[0] != ins->r[1]) return false;
+    remove_ins(ins);
+    return true;
+}
+
+// j L; L:
+static bool rule_jump_to_next(MipsIns *ins) {
+    if (ins->op != MI_J) return false;
+    for (MipsIns *p = ins->next; p != NULL && p->op == MI_LABEL; p = p->next) {
+        if (strcmp(p->label, ins->label) == 0) {
+            remove_ins(ins);
+            return true;
+        }
+    }
+    return false;
+}
+
+// blt a, b, L1; j L2; L1:  ->  bge a, b, L2; L1:
+static bool rule_branch_over_jump(MipsIns *ins) {
+    static const MipsOp inverse[] = {
+        [MI_BEQ] = MI_BNE, [MI_BNE] = MI_BEQ, [MI_BGT] = MI_BLE,
+        [MI_BLT] = MI_BGE, [MI_BGE] = MI_BLT, [MI_BLE] = MI_BGT,
+        [MI_BEQZ] = MI_BNEZ, [MI_BNEZ] = MI_BEQZ, [MI_BGTZ] = MI_BLEZ,
+        [MI_BLTZ] = MI_BGEZ, [MI_BGEZ] = MI_BLTZ, [MI_BLEZ] = MI_BGTZ,
+    };
+    if (!is_branch(ins->op)) return false;
+    MipsIns *jump = ins->next;
+    if (jump == NULL || jump->op != MI_J) return false;
+    for (MipsIns *p = jump->next; p != NULL && p->op == MI_LABEL; p = p->next) {
+        if (strcmp(p->label, ins->label) == 0) {
+            ins->op = inverse[ins->op];
+            free(ins->label);
+            ins->label = jump->label;
+            jump->label = NULL;
+            remove_ins(jump);
+            return true;
+        }
+    }
+    return false;
+}
+
+// addi r, r, a; addi r, r, b  ->  addi r, r, a+b, and the same for addiu
+static bool rule_merge_addi(MipsIns *ins) {
+    MipsIns *next = ins->next;
+    if ((ins->op != MI_ADDI && ins->op != MI_ADDIU) || ins->r[0] != ins->r[1] || next == NULL || next->op != ins->op
+        || next->r[0] != ins->r[0] || next->r[1] != ins->r[0]) return false;
+    int sum = ins->imm + next->imm;
+    if (sum < -32768 || sum > 32767) return false;
+    next->imm = sum;
+    remove_ins(ins);
+    if (sum == 0) remove_ins(next);
+    return true;
+}
+
+// sw v, o(b) or lw v, o(b), then lw d, o(b) with v and b unchanged and no
+// store in between: the load becomes move d, v
+static bool rule_forward_memory(MipsIns *ins) {
+    if (ins->op != MI_SW && ins->op != MI_LW) return false;
+    int v = ins->r[0], base = ins->r[1];
+    if (ins->op == MI_LW && v == base) return false;
+    for (MipsIns *p = ins->next; p != NULL && !mips_is_boundary(p) && p->op != MI_SW; p = p->next) {
+        if (p->op == MI_LW && p->r[1] == base && p->imm == ins->imm) {
+            p->op = MI_MOVE;
+            p->r[1] = v;
+            p->imm = 0;
+            return true;
+        }
+        if (mips_defs(p) & (BIT(v) | BIT(base))) break;
+    }
+    return false;
+}
+
+// li r, k; ...; li r, k with r unchanged in between
+static bool rule_redundant_li(MipsIns *ins) {
+    if (ins->op != MI_LI) return false;
+    for (MipsIns *p = ins->next; p != NULL && !mips_is_boundary(p); p = p->next) {
+        if (p->op == MI_LI && p->r[0] == ins->r[0] && p->imm == ins->imm) {
+            remove_ins(p);
+            return true;
+        }
+        if (mips_defs(p) & BIT(ins->r[0])) break;
+    }
+    return false;
+}
+
+// move d, s; op ..., d, ...  ->  op ..., s, ...
+static bool rule_forward_copy(MipsIns *ins) {
+    MipsIns *next = ins->next;
+    if (ins->op != MI_MOVE || next == NULL || ins->r[0] == ins->r[1]) return false;
+    int d = ins->r[0], s = ins->r[1];
+    bool changed = false;
+    for (int i = 0; i < 3; i++) {
+        const MipsOpInfo *info = &mips_ops[next->op];
+        if ((info->uses & ~info->defs & (1u << i)) && next->r[i] == d) {
+            next->r[i] = s;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// op d, ...; move e, d with d dead afterwards  ->  op e, ...
+static bool rule_def_into_move(MipsIns *ins) {
+    MipsIns *next = ins->next;
+    if (!is_pure_def(ins) || next == NULL || next->op != MI_MOVE
+        || next->r[1] != ins->r[0] || next->r[0] == ins->r[0]) return false;
+    if (!dead_after(next, ins->r[0])) return false;
+    ins->r[0] = next->r[0];
+    remove_ins(next);
+    return true;
+}
+
+// op d, ... with d never read afterwards
+static bool rule_dead_def(MipsIns *ins) {
+    if (!is_pure_def(ins) || !dead_after(ins, ins->r[0])) return false;
+    remove_ins(ins);
+    return true;
+}
+
+static bool (*const rules[])(MipsIns*) = {
+    rule_self_move,
+    rule_jump_to_next,
+    rule_branch_over_jump,
+    rule_merge_addi,
+    rule_forward_memory,
+    rule_redundant_li,
+    rule_forward_copy,
+    rule_def_into_move,
+    rule_dead_def,
+};
+
+void mips_peephole() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_liveness();
+        MipsIns *p = head;
+        while (p != NULL) {
+            // rules only rewrite or remove p and what follows it, so after a
+            // change the window moves back by one to catch new matches
+            MipsIns *prev = p->prev;
+            bool hit = false;
+            for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]) && !hit; i++) {
+                hit = rules[i](p);
+            }
+            if (hit) {
+                changed = true;
+                p = prev != NULL ? prev : head;
+            } else {
+                p = p->next;
+            }
+        }
+    }
+}
+
+static void print_ins(FILE *out, MipsIns *ins) {
+    const MipsOpInfo *info = &mips_ops[ins->op];
+    const char **r = mips_reg_names;
+    if (ins->op == MI_ENTRY) {
+        fprintf(out, "\n%s:\n", ins->label);
+        return;
+    }
+    if (ins->op == MI_LABEL) {
+        fprintf(out, "%s:\n", ins->label);
+        return;
+    }
+    fprintf(out, "  %s", info->name);
+    switch (info->format) {
+        case MF_NONE: break;
+        case MF_L: fprintf(out, " %s", ins->label); break;
+        case MF_R: fprintf(out, " %s", r[ins->r[0]]); break;
+        case MF_RR: fprintf(out, " %s, %s", r[ins->r[0]], r[ins->r[1]]); break;
+        case MF_RRR: fprintf(out, " %s, %s, %s", r[ins->r[0]], r[ins->r[1]], r[ins->r[2]]); break;
+        case MF_RI: fprintf(out, " %s, %d", r[ins->r[0]], ins->imm); break;
+        case MF_RRI: fprintf(out, " %s, %s, %d", r[ins->r[0]], r[ins->r[1]], ins->imm); break;
+        case MF_MEM: fprintf(out, " %s, %d(%s)", r[ins->r[0]], ins->imm, r[ins->r[1]]); break;
+        case MF_RL: fprintf(out, " %s, %s", r[ins->r[0]], ins->label); break;
+        case MF_RRL: fprintf(out, " %s, %s, %s", r[ins->r[0]], r[ins->r[1]], ins->label); break;
+    }
+    fprintf(out, "\n");
+}
+
+static void free_list(MipsIns *p) {
+    while (p != NULL) {
+        MipsIns *next = p->next;
+        free(p->label);
+        free(p);
+        p = next;
+    }
+}
+
+void mips_flush(FILE *out) {
+    int line = 0;
+    for (MipsIns *p = head; p != NULL; p = p->next) {
+        if (p->line != 0 && p->line != line && p->op != MI_ENTRY && p->op != MI_LABEL) {
+            line = p->line;
+            fprintf(out, "  .loc 1 %d\n", line);
+        }
+        print_ins(out, p);
+    }
+    free_list(head);
+    free_list(removed);
+    head = tail = removed = NULL;
+}
@@ -0,0 +1,627 @@
+#include "mipssim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "mips.h"
+
+#define MAX_LINE 512
+// a register number standing for HI/LO in the ready times of the pipeline
+#define HILO MIPS_NUM_REGS
+// jump targets that are not instructions: none pending, and the return of main
+#define NO_TARGET (-1)
+#define EXIT_TARGET (-2)
+
+const char *mipssim_class_names[MC_NUM] = {
+    "alu", "mul", "div", "load", "store", "branch", "jump", "syscall", "nop"
+};
+
+typedef struct {
+    MipsOp op;
+    int r[3];
+    int32_t imm;            // immediate, data address of la, or instruction index of a label
+    int line;
+    int src_line;           // from the last .loc, 0 before the first
+} SimIns;
+
+struct MipsProgram {
+    const char *name;
+    SimIns *code;
+    int ncode, code_capacity;
+    unsigned char *data;
+    int ndata, data_capacity;
+    int main_index;
+    bool noreorder;
+    long long *counts, *cycles;     // of each instruction, NULL when not profiling
+};
+
+typedef struct {
+    char *name;
+    bool in_text;
+    int32_t value;          // instruction index or data address
+} Symbol;
+
+typedef struct {
+    int ins;                // instruction whose imm is the label
+    char *name;
+} Fixup;
+
+// state of mipssim_load
+static struct {
+    MipsProgram *prog;
+    int line;
+    int src_line;
+    bool failed;
+    Symbol *syms;
+    int nsyms, sym_capacity;
+    Fixup *fixups;
+    int nfixups, fixup_capacity;
+} L;
+
+static void load_error(const char *format, ...) {
+    if (L.failed) return;
+    L.failed = true;
+    va_list ap;
+    va_start(ap, format);
+    fprintf(stderr, "%s:%d: error: ", L.prog->name, L.line);
+    vfprintf(stderr, format, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+}
+
+static MipsClass op_class(MipsOp op) {
+    switch (op) {
+        case MI_MUL: case MI_MULT: return MC_MUL;
+        case MI_DIV: return MC_DIV;
+        case MI_LW: return MC_LOAD;
+        case MI_SW: return MC_STORE;
+        case MI_J: case MI_JAL: case MI_JR: return MC_JUMP;
+        case MI_SYSCALL: return MC_SYSCALL;
+        case MI_NOP: return MC_NOP;
+        default: return op >= MI_BEQ && op <= MI_BLEZ ? MC_BRANCH : MC_ALU;
+    }
+}
+
+static Symbol *find_symbol(const char *name) {
+    for (int i = 0; i < L.nsyms; i++) {
+        if (strcmp(L.syms[i].name, name) == 0) return &L.syms[i];
+    }
+    return NULL;
+}
+
+static void define_symbol(const char *name, bool in_text, int32_t value) {
+    if (find_symbol(name) != NULL) {
+        load_error("label %s is defined twice", name);
+        return;
+    }
+    if (L.nsyms == L.sym_capacity) {
+        L.sym_capacity = L.sym_capacity ? L.sym_capacity * 2 : 64;
+        L.syms = (Symbol*)realloc(L.syms, sizeof(Symbol) * L.sym_capacity);
+    }
+    L.syms[L.nsyms].name = strdup(name);
+    L.syms[L.nsyms].in_text = in_text;
+    L.syms[L.nsyms].value = value;
+    L.nsyms++;
+}
+
+static void add_fixup(int ins, const char *name) {
+    if (L.nfixups == L.fixup_capacity) {
+        L.fixup_capacity = L.fixup_capacity ? L.fixup_capacity * 2 : 64;
+        L.fixups = (Fixup*)realloc(L.fixups, sizeof(Fixup) * L.fixup_capacity);
+    }
+    L.fixups[L.nfixups].ins = ins;
+    L.fixups[L.nfixups].name = strdup(name);
+    L.nfixups++;
+}
+
+static void add_data(unsigned char c) {
+    MipsProgram *p = L.prog;
+    if (p->ndata == p->data_capacity) {
+        p->data_capacity = p->data_capacity ? p->data_capacity * 2 : 256;
+        p->data = (unsigned char*)realloc(p->data, p->data_capacity);
+    }
+    p->data[p->ndata++] = c;
+}
+
+static char *skip_space(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    return s;
+}
+
+// the operand at *s up to the next comma or space
+static char *next_operand(char **s) {
+    char *p = skip_space(*s);
+    char *start = p;
+    while (*p != '\0' && *p != ',' && !isspace((unsigned char)*p)) p++;
+    char *end = p;
+    p = skip_space(p);
+    if (*p == ',') p++;
+    *end = '\0';
+    *s = p;
+    return start;
+}
+
+static int parse_reg(const char *s) {
+    if (s[0] != '$') return -1;
+    if (isdigit((unsigned char)s[1])) {
+        char *end;
+        long n = strtol(s + 1, &end, 10);
+        return *end == '\0' && n < MIPS_NUM_REGS ? (int)n : -1;
+    }
+    if (strcmp(s, "$zero") == 0) return MR_ZERO;
+    if (strcmp(s, "$s8") == 0) return MR_FP;
+    for (int i = 0; i < MIPS_NUM_REGS; i++) {
+        if (strcmp(s, mips_reg_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int32_t parse_imm(const char *s) {
+    char *end;
+    long long v = strtoll(s, &end, 0);
+    if (end == s || *end != '\0' || v < INT32_MIN || v > UINT32_MAX) {
+        load_error("bad immediate '%s'", s);
+        return 0;
+    }
+    return (int32_t)v;
+}
+
+static void parse_ins(char *s) {
+    char *mnemonic = next_operand(&s);
+    int op = 0;
+    while (op < MI_NUM_OPS && (mips_ops[op].name[0] == '\0' || strcmp(mips_ops[op].name, mnemonic) != 0)) {
+        op++;
+    }
+    if (op == MI_NUM_OPS) {
+        load_error("unknown instruction '%s'", mnemonic);
+        return;
+    }
+    MipsProgram *p = L.prog;
+    if (p->ncode == p->code_capacity) {
+        p->code_capacity = p->code_capacity ? p->code_capacity * 2 : 256;
+        p->code = (SimIns*)realloc(p->code, sizeof(SimIns) * p->code_capacity);
+    }
+    SimIns *ins = &p->code[p->ncode];
+    memset(ins, 0, sizeof(SimIns));
+    ins->op = (MipsOp)op;
+    ins->line = L.line;
+    ins->src_line = L.src_line;
+
+    int nregs = 0;
+    bool imm = false, label = false, mem = false;
+    switch (mips_ops[op].format) {
+        case MF_NONE: break;
+        case MF_L: label = true; break;
+        case MF_R: nregs = 1; break;
+        case MF_RR: nregs = 2; break;
+        case MF_RRR: nregs = 3; break;
+        case MF_RI: nregs = 1; imm = true; break;
+        case MF_RRI: nregs = 2; imm = true; break;
+        case MF_MEM: nregs = 1; mem = true; break;
+        case MF_RL: nregs = 1; label = true; break;
+        case MF_RRL: nregs = 2; label = true; break;
+    }
+    for (int i = 0; i < nregs; i++) {
+        char *r = next_operand(&s);
+        if ((ins->r[i] = parse_reg(r)) < 0) load_error("bad register '%s'", r);
+    }
+    if (imm) ins->imm = parse_imm(next_operand(&s));
+    if (mem) {
+        // off(base)
+        char *operand = next_operand(&s);
+        char *open = strchr(operand, '('), *close = strrchr(operand, ')');
+        if (open == NULL || close == NULL || close[1] != '\0') {
+            load_error("bad memory operand '%s'", operand);
+            return;
+        }
+        *open = *close = '\0';
+        ins->imm = open == operand ? 0 : parse_imm(operand);
+        if ((ins->r[1] = parse_reg(open + 1)) < 0) load_error("bad register '%s'", open + 1);
+    }
+    if (label) {
+        char *name = next_operand(&s);
+        if (*name == '\0') load_error("missing label");
+        add_fixup(p->ncode, name);
+    }
+    if (*skip_space(s) != '\0') load_error("extra operands '%s'", skip_space(s));
+    p->ncode++;
+}
+
+// "..." with C escapes, to the data segment with a terminating 0
+static void parse_string(char *s) {
+    s = skip_space(s);
+    if (*s++ != '"') {
+        load_error("missing string");
+        return;
+    }
+    for (; *s != '"'; s++) {
+        if (*s == '\0') {
+            load_error("unterminated string");
+            return;
+        }
+        if (*s != '\\') {
+            add_data((unsigned char)*s);
+            continue;
+        }
+        switch (*++s) {
+            case 'n': add_data('\n'); break;
+            case 't': add_data('\t'); break;
+            case '0': add_data('\0'); break;
+            case '\\': case '"': add_data((unsigned char)*s); break;
+            default: load_error("bad escape in string"); return;
+        }
+    }
+    add_data('\0');
+}
+
+static void parse_line(char *s, bool *in_text) {
+    // comments, outside of strings
+    bool quoted = false;
+    for (char *c = s; *c; c++) {
+        if (*c == '"' && (c == s || c[-1] != '\\')) quoted = !quoted;
+        if (*c == '#' && !quoted) {
+            *c = '\0';
+            break;
+        }
+    }
+    s = skip_space(s);
+    // labels
+    for (;;) {
+        char *colon = s;
+        while (isalnum((unsigned char)*colon) || *colon == '_' || *colon == '.') colon++;
+        if (colon == s || *colon != ':') break;
+        *colon = '\0';
+        define_symbol(s, *in_text, *in_text ? L.prog->ncode : MIPSSIM_DATA_BASE + L.prog->ndata);
+        s = skip_space(colon + 1);
+    }
+    if (*s == '\0') return;
+    if (*s != '.') {
+        if (!*in_text) load_error("instruction outside of .text");
+        parse_ins(s);
+        return;
+    }
+    char *directive = next_operand(&s);
+    if (strcmp(directive, ".text") == 0) {
+        *in_text = true;
+    } else if (strcmp(directive, ".data") == 0) {
+        *in_text = false;
+    } else if (strcmp(directive, ".globl") == 0 || strcmp(directive, ".file") == 0) {
+        // everything is visible, and there is one source file
+    } else if (strcmp(directive, ".loc") == 0) {
+        // .loc file line [column]
+        next_operand(&s);
+        L.src_line = parse_imm(next_operand(&s));
+    } else if (strcmp(directive, ".set") == 0) {
+        char *mode = next_operand(&s);
+        if (strcmp(mode, "noreorder") == 0) {
+            L.prog->noreorder = true;
+        } else if (strcmp(mode, "reorder") != 0) {
+            load_error("unknown .set %s", mode);
+        }
+    } else if (strcmp(directive, ".asciiz") == 0 && !*in_text) {
+        parse_string(s);
+    } else {
+        load_error("unsupported directive %s", directive);
+    }
+}
+
+MipsProgram* mipssim_load(FILE* in, const char* name) {
+    memset(&L, 0, sizeof(L));
+    L.prog = (MipsProgram*)calloc(1, sizeof(MipsProgram));
+    L.prog->name = name;
+    char line[MAX_LINE];
+    bool in_text = true;
+    while (!L.failed && fgets(line, sizeof(line), in) != NULL) {
+        L.line++;
+        if (strchr(line, '\n') == NULL && !feof(in)) {
+            load_error("line too long");
+            break;
+        }
+        parse_line(line, &in_text);
+    }
+
+    MipsProgram *p = L.prog;
+    for (int i = 0; i < L.nfixups && !L.failed; i++) {
+        SimIns *ins = &p->code[L.fixups[i].ins];
+        Symbol *sym = find_symbol(L.fixups[i].name);
+        L.line = ins->line;
+        if (sym == NULL) {
+            load_error("undefined label %s", L.fixups[i].name);
+        } else if (sym->in_text != (ins->op != MI_LA)) {
+            load_error("%s is not a %s label", sym->name, ins->op == MI_LA ? "data" : "text");
+        } else {
+            ins->imm = sym->value;
+        }
+    }
+    Symbol *main_sym = find_symbol("main");
+    if (!L.failed && (main_sym == NULL || !main_sym->in_text)) {
+        L.line = 0;
+        load_error("no main function");
+    }
+    if (!L.failed) p->main_index = main_sym->value;
+
+    for (int i = 0; i < L.nsyms; i++) free(L.syms[i].name);
+    for (int i = 0; i < L.nfixups; i++) free(L.fixups[i].name);
+    free(L.syms);
+    free(L.fixups);
+    if (L.failed) {
+        mipssim_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void mipssim_free(MipsProgram* prog) {
+    if (prog == NULL) return;
+    free(prog->code);
+    free(prog->data);
+    free(prog->counts);
+    free(prog->cycles);
+    free(prog);
+}
+
+// registers read and written by ins for the pipeline model; HI/LO is HILO
+static void operand_masks(SimIns *ins, uint64_t *uses, uint64_t *defs) {
+    const MipsOpInfo *info = &mips_ops[ins->op];
+    *uses = *defs = 0;
+    for (int i = 0; i < 3; i++) {
+        if (info->uses & (1u << i)) *uses |= 1ull << ins->r[i];
+        if (info->defs & (1u << i)) *defs |= 1ull << ins->r[i];
+    }
+    switch (ins->op) {
+        case MI_MULT: case MI_DIV: *defs |= 1ull << HILO; break;
+        case MI_MFHI: case MI_MFLO: *uses |= 1ull << HILO; break;
+        case MI_SYSCALL: *uses |= (1ull << MR_V0) | (1ull << MR_A0); *defs |= 1ull << MR_V0; break;
+        case MI_JAL: *defs |= 1ull << MR_RA; break;
+        default: break;
+    }
+    *defs &= ~1ull;
+}
+
+int mipssim_run(MipsProgram* prog, FILE* input, FILE* output, const MipsSimOptions* options,
+    MipsSimStats* stats) {
+    const uint32_t stack_base = MIPSSIM_STACK_TOP - 4u * MIPSSIM_STACK_WORDS;
+    int32_t *stack = (int32_t*)calloc(MIPSSIM_STACK_WORDS, sizeof(int32_t));
+    int32_t reg[MIPS_NUM_REGS] = { 0 }, hi = 0, lo = 0;
+    long long ready[MIPS_NUM_REGS + 1] = { 0 };     // cycle each value can be used
+    MipsSimStats st;
+    memset(&st, 0, sizeof(st));
+    reg[MR_SP] = (int32_t)(MIPSSIM_STACK_TOP - 16);
+    reg[MR_FP] = reg[MR_SP];
+
+    const char *error = NULL;
+    int pc = prog->main_index;
+    int pending = NO_TARGET;    // where to go after the delay slot that is executing
+    SimIns *ins = NULL;
+    if (options->profile) {
+        free(prog->counts);
+        free(prog->cycles);
+        prog->counts = (long long*)calloc(prog->ncode, sizeof(long long));
+        prog->cycles = (long long*)calloc(prog->ncode, sizeof(long long));
+    }
+    while (true) {
+        if (pc < 0 || pc >= prog->ncode) {
+            error = "execution left the text segment";
+            break;
+        }
+        if (options->max_steps > 0 && st.instructions == options->max_steps) {
+            error = "step limit reached";
+            break;
+        }
+        ins = &prog->code[pc];
+        int32_t *r = reg;
+        int a = ins->r[0], b = ins->r[1], c = ins->r[2];
+        int target = ins->imm;
+        bool jumps = false, exits = false;
+
+        st.instructions++;
+        st.by_class[op_class(ins->op)]++;
+        uint64_t uses, defs;
+        operand_masks(ins, &uses, &defs);
+        long long issue = st.cycles;
+        for (int i = 0; i <= HILO; i++) {
+            if ((uses >> i & 1) && ready[i] > issue) issue = ready[i];
+        }
+        if (options->profile) {
+            prog->counts[pc]++;
+            prog->cycles[pc] += issue + 1 - st.cycles;
+        }
+        st.stalls += issue - st.cycles;
+        st.cycles = issue + 1;
+        for (int i = 0; i <= HILO; i++) {
+            if (defs >> i & 1) ready[i] = issue + mips_ops[ins->op].latency;
+        }
+
+        int32_t v;
+        uint32_t addr;
+        switch (ins->op) {
+            case MI_ENTRY: case MI_LABEL: case MI_NOP: break;
+            case MI_LI: case MI_LA: r[a] = ins->imm; break;
+            case MI_MOVE: r[a] = r[b]; break;
+            case MI_ADD:
+                if (__builtin_add_overflow(r[b], r[c], &v)) error = "arithmetic overflow";
+                r[a] = v;
+                break;
+            case MI_SUB:
+                if (__builtin_sub_overflow(r[b], r[c], &v)) error = "arithmetic overflow";
+                r[a] = v;
+                break;
+            case MI_ADDI:
+                if (__builtin_add_overflow(r[b], ins->imm, &v)) error = "arithmetic overflow";
+                r[a] = v;
+                break;
+            case MI_ADDU: r[a] = (int32_t)((uint32_t)r[b] + (uint32_t)r[c]); break;
+            case MI_ADDIU: r[a] = (int32_t)((uint32_t)r[b] + (uint32_t)ins->imm); break;
+            case MI_SUBU: r[a] = (int32_t)((uint32_t)r[b] - (uint32_t)r[c]); break;
+            case MI_MUL: r[a] = (int32_t)((uint32_t)r[b] * (uint32_t)r[c]); break;
+            case MI_SLT: r[a] = r[b] < r[c]; break;
+            case MI_SLTU: r[a] = (uint32_t)r[b] < (uint32_t)r[c]; break;
+            case MI_XOR: r[a] = r[b] ^ r[c]; break;
+            case MI_MOVN: if (r[c] != 0) r[a] = r[b]; break;
+            case MI_MOVZ: if (r[c] == 0) r[a] = r[b]; break;
+            case MI_XORI: r[a] = r[b] ^ (ins->imm & 0xffff); break;
+            case MI_SLTI: r[a] = r[b] < ins->imm; break;
+            case MI_SLTIU: r[a] = (uint32_t)r[b] < (uint32_t)ins->imm; break;
+            case MI_SLL: r[a] = (int32_t)((uint32_t)r[b] << (ins->imm & 31)); break;
+            case MI_SRA: r[a] = r[b] >> (ins->imm & 31); break;
+            case MI_SRL: r[a] = (int32_t)((uint32_t)r[b] >> (ins->imm & 31)); break;
+            case MI_MULT: {
+                int64_t prod = (int64_t)r[a] * r[b];
+                hi = (int32_t)(prod >> 32);
+                lo = (int32_t)prod;
+                break;
+            }
+            case MI_DIV:
+                if (r[b] == 0) {
+                    error = "division by zero";
+                } else if (r[b] == -1) {
+                    lo = (int32_t)(0u - (uint32_t)r[a]);
+                    hi = 0;
+                } else {
+                    lo = r[a] / r[b];
+                    hi = r[a] % r[b];
+                }
+                break;
+            case MI_MFHI: r[a] = hi; break;
+            case MI_MFLO: r[a] = lo; break;
+            case MI_LW: case MI_SW:
+                addr = (uint32_t)r[b] + (uint32_t)ins->imm;
+                if (addr & 3) {
+                    error = "unaligned address";
+                } else if (addr - stack_base < 4u * MIPSSIM_STACK_WORDS) {
+                    if (ins->op == MI_LW) r[a] = stack[(addr - stack_base) >> 2];
+                    else stack[(addr - stack_base) >> 2] = r[a];
+                } else if (ins->op == MI_LW && addr - MIPSSIM_DATA_BASE + 4 <= (uint32_t)prog->ndata) {
+                    memcpy(&r[a], prog->data + (addr - MIPSSIM_DATA_BASE), 4);
+                } else {
+                    error = "bad address";
+                }
+                break;
+            case MI_BEQ: jumps = r[a] == r[b]; break;
+            case MI_BNE: jumps = r[a] != r[b]; break;
+            case MI_BGT: jumps = r[a] > r[b]; break;
+            case MI_BLT: jumps = r[a] < r[b]; break;
+            case MI_BGE: jumps = r[a] >= r[b]; break;
+            case MI_BLE: jumps = r[a] <= r[b]; break;
+            case MI_BEQZ: jumps = r[a] == 0; break;
+            case MI_BNEZ: jumps = r[a] != 0; break;
+            case MI_BGTZ: jumps = r[a] > 0; break;
+            case MI_BLTZ: jumps = r[a] < 0; break;
+            case MI_BGEZ: jumps = r[a] >= 0; break;
+            case MI_BLEZ: jumps = r[a] <= 0; break;
+            case MI_J: jumps = true; break;
+            case MI_JAL:
+                jumps = true;
+                st.calls++;
+                r[MR_RA] = (int32_t)(MIPSSIM_TEXT_BASE + 4u * (pc + (prog->noreorder ? 2 : 1)));
+                break;
+            case MI_JR:
+                jumps = true;
+                addr = (uint32_t)r[a];
+                if (addr == 0) {
+                    target = EXIT_TARGET;
+                } else if ((addr & 3) || addr - MIPSSIM_TEXT_BASE >= 4u * prog->ncode) {
+                    error = "bad jump target";
+                } else {
+                    target = (int)((addr - MIPSSIM_TEXT_BASE) >> 2);
+                }
+                break;
+            case MI_SYSCALL:
+                switch (r[MR_V0]) {
+                    case 1:
+                        fprintf(output, options->print_strings ? "%d" : "%d\n", r[MR_A0]);
+                        break;
+                    case 4:
+                        addr = (uint32_t)r[MR_A0] - MIPSSIM_DATA_BASE;
+                        if (addr >= (uint32_t)prog->ndata) {
+                            error = "bad string address";
+                        } else if (options->print_strings) {
+                            fputs((const char*)prog->data + addr, output);
+                        }
+                        break;
+                    case 5:
+                        if (fscanf(input, "%d", &r[MR_V0]) != 1) error = "read after the end of the input";
+                        break;
+                    case 10: exits = true; break;
+                    default: error = "unknown syscall";
+                }
+                break;
+            case MI_NUM_OPS: break;
+        }
+        reg[MR_ZERO] = 0;
+        if (error != NULL) break;
+
+        MipsClass cls = op_class(ins->op);
+        if (cls == MC_BRANCH && jumps) st.taken_branches++;
+        if (exits) break;
+        if (pending != NO_TARGET) {
+            // ins was in a delay slot
+            if (cls == MC_BRANCH || cls == MC_JUMP) {
+                error = "branch in a delay slot";
+                break;
+            }
+            if (pending == EXIT_TARGET) break;
+            pc = pending;
+            pending = NO_TARGET;
+        } else if (!jumps) {
+            pc++;
+        } else if (prog->noreorder) {
+            pending = target;
+            pc++;
+        } else {
+            st.bubbles++;
+            st.cycles++;
+            if (options->profile) prog->cycles[pc]++;
+            if (target == EXIT_TARGET) break;
+            pc = target;
+        }
+    }
+    if (error != NULL) {
+        fprintf(stderr, "%s:%d: runtime error: %s\n", prog->name, ins != NULL ? ins->line : 0, error);
+    }
+    if (stats != NULL) *stats = st;
+    free(stack);
+    return error != NULL;
+}
+
+typedef struct {
+    int line;
+    long long instructions, cycles;
+} LineCost;
+
+static int by_cycles(const void *a, const void *b) {
+    const LineCost *x = (const LineCost*)a, *y = (const LineCost*)b;
+    if (x->cycles != y->cycles) return x->cycles < y->cycles ? 1 : -1;
+    return x->line - y->line;
+}
+
+void mipssim_report_lines(MipsProgram* prog, FILE* out) {
+    if (prog->counts == NULL) return;
+    int nlines = 1;
+    for (int i = 0; i < prog->ncode; i++) {
+        if (prog->code[i].src_line >= nlines) nlines = prog->code[i].src_line + 1;
+    }
+    LineCost *lines = (LineCost*)calloc(nlines, sizeof(LineCost));
+    long long total = 0;
+    for (int i = 0; i < nlines; i++) lines[i].line = i;
+    for (int i = 0; i < prog->ncode; i++) {
+        LineCost *l = &lines[prog->code[i].src_line];
+        l->instructions += prog->counts[i];
+        l->cycles += prog->cycles[i];
+        total += prog->cycles[i];
+    }
+    qsort(lines, nlines, sizeof(LineCost), by_cycles);
+    fprintf(out, "%-8s %14s %14s %8s\n", "line", "instructions", "cycles", "%");
+    for (int i = 0; i < nlines && lines[i].cycles > 0; i++) {
+        char name[16];
+        if (lines[i].line == 0) {
+            snprintf(name, sizeof(name), "?");
+        } else {
+            snprintf(name, sizeof(name), "%d", lines[i].line);
+        }
+        fprintf(out, "%-8s %14lld %14lld %8.2f\n", name, lines[i].instructions, lines[i].cycles,
+            100.0 * lines[i].cycles / total);
+    }
+    free(lines);
+}
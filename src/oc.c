@@ -4,15 +4,47 @@
 #include <assert.h>
 #include <string.h>
 #include "debug.h"
+#include "options.h"
+#include "timer.h"
+#include "memstat.h"
+#include "regalloc.h"
+#include "mips.h"
+#include "isel.h"
+#include "sched.h"
 
 #define println(format, ...) printf(format "\n", ## __VA_ARGS__)
-#define printIns(format, ...) printf("  " format "\n", ## __VA_ARGS__)
 
-LvaList *lva_list = NULL;
-int lva_off = 0, param_off = 0;
-Reg t_regs[10];
+LocalVarAddr *lvas = NULL;  // stack slots, indexed by ra_index
+int lva_capacity = 0;
+int frame_size = 0;         // bytes below the saved $fp
 
-void generate_oc(ASTNode* program) {
+// the first NUM_ARG_REGS arguments are passed in $a0-$a3, the rest on the
+// stack with the fifth argument at the lowest address
+#define NUM_ARG_REGS 4
+
+// frame of the function being generated
+bool saves_ra;          // makes calls, $ra is saved in the prologue
+bool frameless;         // leaf that keeps everything in registers
+int param_count;        // PARAMs seen so far
+int arg_index, stack_args;  // position of the next ARG, ARGs passed on the stack
+
+// an inlined write leaves the address of the newline string here, where
+// the next write finds it unless a label, call or argument came between;
+// a function that writes and calls nothing loads it once after its PARAMs
+#define NEWLINE_REG (MR_A0 + 1)
+bool newline_loaded;
+bool newline_pinned;
+
+Reg t_regs[10];         // scratch registers, live for one IR instruction
+int num_scratch_regs;
+Reg ra_regs[RA_NUM_REGS];
+Reg zero_reg = { .no = MR_ZERO, .allocated = true };
+Reg fp_reg = { .no = MR_FP, .allocated = true };
+
+void generate_oc(ASTNode* program, const char* source) {
+    if (options.line_info) {
+        println(".file 1 \"%s\"", source);
+    }
     gen_data_seg();
     gen_global_seg();
     InterCodes *ics = translate_Program(program);
@@ -30,218 +62,487 @@ void gen_global_seg() {
 }
 
 void gen_read_func() {
-    println();
-    println("read:");
-    printIns("li $v0, 4");
-    printIns("la $a0, _prompt");
-    printIns("syscall");
-    printIns("li $v0, 5");
-    printIns("syscall");
-    printIns("jr $ra");
+    mips_emit_label(MI_ENTRY, "read");
+    mips_ri(MI_LI, MR_V0, 4);
+    mips_emit(MI_LA, MR_A0, 0, 0, 0, "_prompt");
+    mips_none(MI_SYSCALL);
+    mips_ri(MI_LI, MR_V0, 5);
+    mips_none(MI_SYSCALL);
+    mips_r(MI_JR, MR_RA);
 }
 
 void gen_write_func() {
-    println();
-    println("write:");
-    printIns("li $v0, 1");
-    printIns("syscall");
-    printIns("li $v0, 4");
-    printIns("la $a0, _ret");
-    printIns("syscall");
-    printIns("move $v0, $0");
-    printIns("jr $ra");
+    mips_emit_label(MI_ENTRY, "write");
+    mips_ri(MI_LI, MR_V0, 1);
+    mips_none(MI_SYSCALL);
+    mips_ri(MI_LI, MR_V0, 4);
+    mips_emit(MI_LA, MR_A0, 0, 0, 0, "_ret");
+    mips_none(MI_SYSCALL);
+    mips_rr(MI_MOVE, MR_V0, MR_ZERO);
+    mips_r(MI_JR, MR_RA);
+}
+
+// some instruction of ics is a kind
+static bool uses_code(InterCodes* ics, enum IR_KIND kind) {
+    for (InterCodes* p = ics; p != NULL; p = p->next) {
+        if (p->code.kind == kind) return true;
+    }
+    return false;
 }
 
 void gen_text_seg(InterCodes* ics) {
+    timer_begin("codegen");
     init_reg();
     println(".text");
-    gen_read_func();
-    gen_write_func();
+    if (options.delay_slots) {
+        println(".set noreorder");
+    }
+    if (!options.inline_io && uses_code(ics, IR_READ)) gen_read_func();
+    if (!options.inline_io && uses_code(ics, IR_WRITE)) gen_write_func();
+    timer_begin("select");
+    isel_select(ics);
+    timer_end();
+    timer_begin("emit");
+    // global declarations come before the first function: they have no
+    // frame to live in and execution starts at main, so nothing is emitted
     InterCodes* ic = ics;
+    while (ic != NULL && ic->code.kind != IR_FUNC) ic = ic->next;
     for (; ic != NULL; ic = ic->next) {
+        if (isel_folded(ic)) continue;
+        if (options.line_info) mips_set_line(ic->code.lineno);
+        if (newline_pinned && !newline_loaded && ic->code.kind != IR_FUNC
+            && ic->code.kind != IR_PARAM) {
+            mips_emit(MI_LA, NEWLINE_REG, 0, 0, 0, "_ret");
+            newline_loaded = true;
+        }
         switch (ic->code.kind) {
             case IR_LABEL: {
-                println("label%d:", ic->code.result.u.label_id);
+                mips_emit_label(MI_LABEL, "label%d", ic->code.result.u.label_id);
+                if (!newline_pinned) newline_loaded = false;
                 break;
             }
             case IR_FUNC: {
-                println();
-                println("%s:", ic->code.result.symbol->name);
-                clear_lvas();
+                mips_emit_label(MI_ENTRY, "%s", ic->code.result.symbol->name);
+                timer_begin("regalloc");
+                ra_allocate(ic, options.regalloc);
+                timer_end();
+                plan_frame(ic);
                 gen_prologue();
+                newline_loaded = false;
                 break;
             }
             case IR_ASSIGN: {
-                Reg* rr = get_reg(&ic->code.result);
+                Reg* rr = get_def_reg(&ic->code.result);
+                if (ic->code.arg1.kind == OP_CONSTANT) {
+                    mips_ri(MI_LI, rr->no, ic->code.arg1.u.value);
+                    spill_reg(rr);
+                    break;
+                }
                 Reg* r1 = get_reg(&ic->code.arg1);
-                printIns("move %s, %s", rr->name, r1->name);
+                mips_rr(MI_MOVE, rr->no, r1->no);
                 spill_reg(rr);
                 free_reg(r1);
                 break;
             }
             case IR_ADD: {
-                Reg* rr = get_reg(&ic->code.result);
+                if (ic->code.arg2.kind == OP_CONSTANT && is_imm(ic->code.arg2.u.value)) {
+                    gen_addi(&ic->code.result, &ic->code.arg1, ic->code.arg2.u.value, ic->code.wraps);
+                    break;
+                }
+                if (ic->code.arg1.kind == OP_CONSTANT && is_imm(ic->code.arg1.u.value)) {
+                    gen_addi(&ic->code.result, &ic->code.arg2, ic->code.arg1.u.value, ic->code.wraps);
+                    break;
+                }
+                Reg* rr = get_def_reg(&ic->code.result);
                 Reg* r1 = get_reg(&ic->code.arg1);
                 Reg* r2 = get_reg(&ic->code.arg2);
-                printIns("add %s, %s, %s", rr->name, r1->name, r2->name);
+                mips_rrr(ic->code.wraps ? MI_ADDU : MI_ADD, rr->no, r1->no, r2->no);
                 spill_reg(rr);
                 free_reg(r1);
                 free_reg(r2);
                 break;
             }
             case IR_SUB: {
-                Reg* rr = get_reg(&ic->code.result);
+                if (ic->code.arg2.kind == OP_CONSTANT && is_imm(-ic->code.arg2.u.value)
+                    && ic->code.arg2.u.value != IMM_MIN) {
+                    gen_addi(&ic->code.result, &ic->code.arg1, -ic->code.arg2.u.value, ic->code.wraps);
+                    break;
+                }
+                Reg* rr = get_def_reg(&ic->code.result);
                 Reg* r1 = get_reg(&ic->code.arg1);
                 Reg* r2 = get_reg(&ic->code.arg2);
-                printIns("sub %s, %s, %s", rr->name, r1->name, r2->name);
+                mips_rrr(ic->code.wraps ? MI_SUBU : MI_SUB, rr->no, r1->no, r2->no);
                 spill_reg(rr);
                 free_reg(r1);
                 free_reg(r2);
                 break;
             }
             case IR_MUL: {
-                Reg* rr = get_reg(&ic->code.result);
+                SRSeq seq;
+                if (ic->code.arg2.kind == OP_CONSTANT && sr_mul_const(ic->code.arg2.u.value, &seq)) {
+                    gen_strength_reduced(&seq, &ic->code.result, &ic->code.arg1);
+                    break;
+                }
+                if (ic->code.arg1.kind == OP_CONSTANT && sr_mul_const(ic->code.arg1.u.value, &seq)) {
+                    gen_strength_reduced(&seq, &ic->code.result, &ic->code.arg2);
+                    break;
+                }
+                Reg* rr = get_def_reg(&ic->code.result);
                 Reg* r1 = get_reg(&ic->code.arg1);
                 Reg* r2 = get_reg(&ic->code.arg2);
-                printIns("mul %s, %s, %s", rr->name, r1->name, r2->name);
+                mips_rrr(MI_MUL, rr->no, r1->no, r2->no);
                 spill_reg(rr);
                 free_reg(r1);
                 free_reg(r2);
                 break;
             }
             case IR_DIV: {
-                Reg* rr = get_reg(&ic->code.result);
+                SRSeq seq;
+                if (ic->code.arg2.kind == OP_CONSTANT && sr_div_const(ic->code.arg2.u.value, &seq)) {
+                    gen_strength_reduced(&seq, &ic->code.result, &ic->code.arg1);
+                    break;
+                }
+                Reg* rr = get_def_reg(&ic->code.result);
                 Reg* r1 = get_reg(&ic->code.arg1);
                 Reg* r2 = get_reg(&ic->code.arg2);
-                printIns("div %s, %s", r1->name, r2->name);
-                printIns("mflo %s", rr->name);
+                mips_rr(MI_DIV, r1->no, r2->no);
+                mips_r(MI_MFLO, rr->no);
                 spill_reg(rr);
                 free_reg(r1);
                 free_reg(r2);
                 break;
             }
             case IR_ADDR: {
-                Reg* rr = get_reg(&ic->code.result);
+                Reg* rr = get_def_reg(&ic->code.result);
                 gen_addr(rr, &ic->code.arg1);
                 spill_reg(rr);
                 break;
             }
             case IR_DEREF_L: {
-                Reg* rr = get_reg(&ic->code.result);
+                int off;
+                Reg* rr = get_addr_reg(&ic->code.result, &off);
                 Reg* r1 = get_reg(&ic->code.arg1);
-                printIns("sw %s, 0(%s)", r1->name, rr->name);
+                mips_mem(MI_SW, r1->no, off, rr->no);
                 free_reg(rr);
                 free_reg(r1);
                 break;
             }
             case IR_DEREF_R: {
-                Reg* rr = get_reg(&ic->code.result);
-                Reg* r1 = get_reg(&ic->code.arg1);
-                printIns("lw %s, 0(%s)", rr->name, r1->name);
+                int off;
+                Reg* rr = get_def_reg(&ic->code.result);
+                Reg* r1 = get_addr_reg(&ic->code.arg1, &off);
+                mips_mem(MI_LW, rr->no, off, r1->no);
                 spill_reg(rr);
                 free_reg(r1);
                 break;
             }
             case IR_GOTO: {
-                printIns("j label%d", ic->code.result.u.label_id);
+                mips_emit_label(MI_J, "label%d", ic->code.result.u.label_id);
                 break;
             }
             case IR_RELOP: {
-                char *ins;
+                if (gen_branch_zero(ic)) break;
+                MipsOp op;
+                switch (ic->code.relop) {
+                    case RELOP_EQ: op = MI_BEQ; break;
+                    case RELOP_NE: op = MI_BNE; break;
+                    case RELOP_GT: op = MI_BGT; break;
+                    case RELOP_LT: op = MI_BLT; break;
+                    case RELOP_GE: op = MI_BGE; break;
+                    case RELOP_LE: op = MI_BLE; break;
+                    default: assert(0);
+                }
+                Reg* r1 = get_reg(&ic->code.arg1);
+                Reg* r2 = get_reg(&ic->code.arg2);
+                char label[16];
+                sprintf(label, "label%d", ic->code.result.u.label_id);
+                mips_emit(op, r1->no, r2->no, 0, 0, label);
+                free_reg(r1);
+                free_reg(r2);
+                break;
+            }
+            case IR_SETREL: {
+                if (gen_setrel_imm(ic)) break;
+                Reg* rr = get_def_reg(&ic->code.result);
+                Reg* r1 = get_reg(&ic->code.arg1);
+                Reg* r2 = get_reg(&ic->code.arg2);
                 switch (ic->code.relop) {
-                    case RELOP_EQ: ins = "beq"; break;
-                    case RELOP_NE: ins = "bne"; break;
-                    case RELOP_GT: ins = "bgt"; break;
-                    case RELOP_LT: ins = "blt"; break;
-                    case RELOP_GE: ins = "bge"; break;
-                    case RELOP_LE: ins = "ble"; break;
+                    case RELOP_LT: mips_rrr(MI_SLT, rr->no, r1->no, r2->no); break;
+                    case RELOP_GT: mips_rrr(MI_SLT, rr->no, r2->no, r1->no); break;
+                    case RELOP_LE: {
+                        mips_rrr(MI_SLT, rr->no, r2->no, r1->no);
+                        mips_rri(MI_XORI, rr->no, rr->no, 1);
+                        break;
+                    }
+                    case RELOP_GE: {
+                        mips_rrr(MI_SLT, rr->no, r1->no, r2->no);
+                        mips_rri(MI_XORI, rr->no, rr->no, 1);
+                        break;
+                    }
+                    case RELOP_EQ: {
+                        mips_rrr(MI_XOR, rr->no, r1->no, r2->no);
+                        mips_rri(MI_SLTIU, rr->no, rr->no, 1);
+                        break;
+                    }
+                    case RELOP_NE: {
+                        mips_rrr(MI_XOR, rr->no, r1->no, r2->no);
+                        mips_rrr(MI_SLTU, rr->no, MR_ZERO, rr->no);
+                        break;
+                    }
                     default: assert(0);
                 }
+                spill_reg(rr);
+                free_reg(r1);
+                free_reg(r2);
+                break;
+            }
+            case IR_CMOV: {
+                Reg* rr = get_reg(&ic->code.result);
                 Reg* r1 = get_reg(&ic->code.arg1);
                 Reg* r2 = get_reg(&ic->code.arg2);
-                printIns("%s %s, %s, label%d", ins, r1->name, r2->name,
-                    ic->code.result.u.label_id);
+                mips_rrr(ic->code.relop == RELOP_NE ? MI_MOVN : MI_MOVZ, rr->no, r1->no, r2->no);
+                spill_reg(rr);
                 free_reg(r1);
                 free_reg(r2);
                 break;
             }
             case IR_RETURN: {
                 Reg* rr = get_reg(&ic->code.result);
-                printIns("move $v0, %s", rr->name);
+                mips_rr(MI_MOVE, MR_V0, rr->no);
                 // invoke gen_epilogue() after get_reg(...)
                 // avoid to reset $fp early
                 gen_epilogue();
-                printIns("jr $ra");
+                mips_r(MI_JR, MR_RA);
                 free_reg(rr);
                 break;
             }
             case IR_DEC: {
-                add_array2lva(&ic->code.result, ic->code.size);
+                // the slot is part of the frame
                 break;
             }
             case IR_ARG: {
-                // put all args on stack
-                Reg* rr = get_reg(&ic->code.result);
-                printIns("addi $sp, $sp, -4");
-                printIns("sw %s, 0($sp)", rr->name);
-                free_reg(rr);
+                // ARGs come last argument first, right before their CALL
+                if (ic->prev == NULL || ic->prev->code.kind != IR_ARG) {
+                    int n = 0;
+                    for (InterCodes* p = ic; p != NULL && p->code.kind == IR_ARG; p = p->next) n++;
+                    arg_index = n - 1;
+                    stack_args = n > NUM_ARG_REGS ? n - NUM_ARG_REGS : 0;
+                }
+                newline_loaded = false;
+                if (arg_index < NUM_ARG_REGS) {
+                    load_operand(MR_A0 + arg_index, &ic->code.result);
+                } else {
+                    Reg* rr = get_reg(&ic->code.result);
+                    mips_rri(MI_ADDI, MR_SP, MR_SP, -4);
+                    mips_mem(MI_SW, rr->no, 0, MR_SP);
+                    free_reg(rr);
+                }
+                arg_index--;
                 break;
             }
             case IR_CALL: {
-                printIns("addi $sp, $sp, -4");
-                printIns("sw $ra, 0($sp)");
-                printIns("jal %s", ic->code.arg1.symbol->name);
-                printIns("lw $ra, 0($sp)");
-                printIns("addi $sp, $sp, 4");
-                // don't invoke get_reg(...) before 'jal ...'
-                // avoid to allocate stack between ARG... and CALL...
-                Reg* rr = get_reg(&ic->code.result);
-                printIns("move %s, $v0", rr->name);
+                mips_emit_label(MI_JAL, "%s", ic->code.arg1.symbol->name);
+                if (ic->prev != NULL && ic->prev->code.kind == IR_ARG && stack_args > 0) {
+                    mips_rri(MI_ADDI, MR_SP, MR_SP, 4 * stack_args);
+                }
+                stack_args = 0;
+                newline_loaded = false;
+                Reg* rr = get_def_reg(&ic->code.result);
+                mips_rr(MI_MOVE, rr->no, MR_V0);
                 spill_reg(rr);
                 break;
             }
             case IR_PARAM: {
-                add_param2lva(&ic->code.result);
+                if (param_count < NUM_ARG_REGS) {
+                    Reg* rr = get_def_reg(&ic->code.result);
+                    mips_rr(MI_MOVE, rr->no, MR_A0 + param_count);
+                    spill_reg(rr);
+                } else {
+                    Reg* rr = get_def_reg(&ic->code.result);
+                    if (rr->allocated) {
+                        mips_mem(MI_LW, rr->no, get_lva(&ic->code.result)->off, MR_FP);
+                    }
+                    free_reg(rr);
+                }
+                param_count++;
                 break;
             }
             case IR_READ: {
-                Reg* rr = get_reg(&ic->code.result);
-                printIns("addi $sp, $sp, -4");
-                printIns("sw $ra, 0($sp)");
-                printIns("jal read");
-                printIns("lw $ra, 0($sp)");
-                printIns("addi $sp, $sp, 4");
-                printIns("move %s, $v0", rr->name);
+                Reg* rr = get_def_reg(&ic->code.result);
+                if (options.inline_io) {
+                    mips_ri(MI_LI, MR_V0, 4);
+                    mips_emit(MI_LA, MR_A0, 0, 0, 0, "_prompt");
+                    mips_none(MI_SYSCALL);
+                    mips_ri(MI_LI, MR_V0, 5);
+                    mips_none(MI_SYSCALL);
+                } else {
+                    mips_emit_label(MI_JAL, "read");
+                }
+                mips_rr(MI_MOVE, rr->no, MR_V0);
                 spill_reg(rr);
                 break;
             }
             case IR_WRITE: {
-                Reg* rr = get_reg(&ic->code.result);
-                printIns("move $a0, %s", rr->name);
-                free_reg(rr);
-
-                printIns("addi $sp, $sp, -4");
-                printIns("sw $ra, 0($sp)");
-                printIns("jal write");
-                printIns("lw $ra, 0($sp)");
-                printIns("addi $sp, $sp, 4");
+                load_operand(MR_A0, &ic->code.result);
+                if (!options.inline_io) {
+                    mips_emit_label(MI_JAL, "write");
+                    break;
+                }
+                mips_ri(MI_LI, MR_V0, 1);
+                mips_none(MI_SYSCALL);
+                mips_ri(MI_LI, MR_V0, 4);
+                if (!newline_loaded) {
+                    mips_emit(MI_LA, NEWLINE_REG, 0, 0, 0, "_ret");
+                    newline_loaded = true;
+                }
+                mips_rr(MI_MOVE, MR_A0, NEWLINE_REG);
+                mips_none(MI_SYSCALL);
                 break;
             }
             default: assert(0);
         }
     }
+    timer_end();
+    if (options.peephole) {
+        timer_begin("peephole");
+        mips_peephole();
+        timer_end();
+    }
+    if (options.schedule) {
+        timer_begin("schedule");
+        mips_schedule();
+        timer_end();
+    }
+    if (options.delay_slots) {
+        timer_begin("delay slots");
+        mips_fill_delay_slots();
+        timer_end();
+    }
+    timer_begin("output");
+    mips_flush(stdout);
+    timer_end();
+    timer_end();
+    mem_checkpoint("codegen");
+}
+
+// register the allocator assigned to opd, if any
+static Reg* get_allocated_reg(Operand* opd) {
+    if (!options.regalloc) return NULL;
+    int reg = ra_lookup(opd);
+    return reg == RA_NO_REG ? NULL : &ra_regs[reg];
+}
+
+// callee-saved registers the allocator used sit right below the saved $fp
+static int saved_reg_count() {
+    return options.regalloc ? __builtin_popcount(ra_saved_regs_used()) : 0;
+}
+
+static void assign_slot(Operand* opd, int off) {
+    LocalVarAddr* lva = &lvas[ra_index(opd)];
+    lva->assigned = true;
+    lva->off = off;
+}
+
+// lay out the frame of the function starting at func before any of its
+// code is emitted, so that the prologue allocates it in one go
+void plan_frame(InterCodes* func) {
+    InterCodes* end = func->next;
+    while (end != NULL && end->code.kind != IR_FUNC) end = end->next;
+
+    int nparams = 0;
+    bool calls = false, reads = false, writes = false;
+    for (InterCodes* p = func->next; p != end; p = p->next) {
+        if (p->code.kind == IR_CALL) {
+            calls = true;
+        } else if (p->code.kind == IR_READ) {
+            reads = true;
+        } else if (p->code.kind == IR_WRITE) {
+            writes = true;
+        } else if (p->code.kind == IR_PARAM) {
+            nparams++;
+        }
+    }
+    saves_ra = calls || (!options.inline_io && (reads || writes));
+    newline_pinned = options.inline_io && writes && !calls;
+
+    if (ra_count() > lva_capacity) {
+        lva_capacity = ra_count() * 2;
+        lvas = (LocalVarAddr*)mem_realloc(MEM_LVA, lvas, sizeof(LocalVarAddr) * lva_capacity);
+    }
+    for (int i = 0; i < ra_count(); i++) {
+        lvas[i].assigned = false;
+    }
+
+    // stack arguments above the saved $fp and $ra, arrays and structs
+    // right below the saved $s registers, then the words of the values
+    // left in memory, shared between values that are never live together
+    int off = -4 * saved_reg_count();
+    int param_off = saves_ra ? 8 : 4, k = 0;
+    for (InterCodes* p = func->next; p != end; p = p->next) {
+        if (p->code.kind == IR_PARAM && k++ >= NUM_ARG_REGS) {
+            assign_slot(&p->code.result, param_off);
+            param_off += 4;
+        } else if (p->code.kind == IR_DEC) {
+            off -= p->code.size;
+            assign_slot(&p->code.result, off);
+        }
+    }
+    bool* want = (bool*)calloc(ra_count() + 1, sizeof(bool));
+    int* slot = (int*)malloc(sizeof(int) * (ra_count() + 1));
+    for (InterCodes* p = func->next; p != end; p = p->next) {
+        Operand opds[4];
+        int n = isel_uses(p, opds);
+        if (isel_defines(p)) opds[n++] = p->code.result;
+        for (int i = 0; i < n; i++) {
+            int index = ra_index(&opds[i]);
+            if (index >= 0 && !lvas[index].assigned && ra_lookup(&opds[i]) == RA_NO_REG) {
+                want[index] = true;
+            }
+        }
+    }
+    int nslots = ra_share_slots(want, slot);
+    for (int i = 0; i < ra_count(); i++) {
+        if (slot[i] >= 0) {
+            lvas[i].assigned = true;
+            lvas[i].off = off - 4 * (slot[i] + 1);
+        }
+    }
+    off -= 4 * nslots;
+    free(slot);
+    free(want);
+    frame_size = -off;
+
+    frameless = options.regalloc && !saves_ra && nparams <= NUM_ARG_REGS && frame_size == 0;
+    param_count = 0;
+}
+
+// put the value of opd into register reg
+void load_operand(int reg, Operand* opd) {
+    if (opd->kind == OP_CONSTANT) {
+        mips_ri(MI_LI, reg, opd->u.value);
+        return;
+    }
+    Reg* r = get_allocated_reg(opd);
+    if (r != NULL) {
+        mips_rr(MI_MOVE, reg, r->no);
+    } else {
+        mips_mem(MI_LW, reg, get_lva(opd)->off, MR_FP);
+    }
 }
 
 Reg* get_reg(Operand* opd) {
-    for (int i = 0; i < 10; i ++) {
+    if (opd->kind == OP_CONSTANT && opd->u.value == 0) return &zero_reg;
+    Reg* allocated = get_allocated_reg(opd);
+    if (allocated != NULL) return allocated;
+    for (int i = 0; i < num_scratch_regs; i ++) {
         if (t_regs[i].unused) {
             t_regs[i].unused = false;
             if (opd->kind == OP_CONSTANT) {
-                printIns("li %s, %d", t_regs[i].name, opd->u.value);
+                mips_ri(MI_LI, t_regs[i].no, opd->u.value);
             }
             else {
                 t_regs[i].lva = get_lva(opd);
-                printIns("lw %s, %d($fp)", t_regs[i].name, t_regs[i].lva->off);
+                mips_mem(MI_LW, t_regs[i].no, t_regs[i].lva->off, MR_FP);
             }
             return t_regs + i;
         }
@@ -249,393 +550,250 @@ Reg* get_reg(Operand* opd) {
     panic();
 }
 
+// register to compute the new value of opd in, without loading the old one
+Reg* get_def_reg(Operand* opd) {
+    Reg* allocated = get_allocated_reg(opd);
+    if (allocated != NULL) return allocated;
+    Reg* r = get_scratch_reg();
+    r->lva = get_lva(opd);
+    return r;
+}
+
+Reg* get_scratch_reg() {
+    for (int i = 0; i < num_scratch_regs; i ++) {
+        if (t_regs[i].unused) {
+            t_regs[i].unused = false;
+            t_regs[i].lva = NULL;
+            return t_regs + i;
+        }
+    }
+    panic();
+}
+
+void gen_strength_reduced(SRSeq* seq, Operand* result, Operand* src) {
+    Reg* rr = get_def_reg(result);
+    Reg* r1 = get_reg(src);
+    Reg* tmp1 = get_scratch_reg();
+    Reg* tmp2 = get_scratch_reg();
+    // indexed by enum SR_REG
+    int regs[] = { MR_ZERO, rr->no, r1->no, tmp1->no, tmp2->no };
+    for (int i = 0; i < seq->len; i++) {
+        SRIns* ins = &seq->ins[i];
+        int rd = regs[ins->rd], rs = regs[ins->rs], rt = regs[ins->rt];
+        switch (ins->op) {
+            case SR_LI: mips_ri(MI_LI, rd, ins->imm); break;
+            case SR_MOVE: mips_rr(MI_MOVE, rd, rs); break;
+            case SR_ADDU: mips_rrr(MI_ADDU, rd, rs, rt); break;
+            case SR_SUBU: mips_rrr(MI_SUBU, rd, rs, rt); break;
+            case SR_SLL: mips_rri(MI_SLL, rd, rs, ins->imm); break;
+            case SR_SRA: mips_rri(MI_SRA, rd, rs, ins->imm); break;
+            case SR_SRL: mips_rri(MI_SRL, rd, rs, ins->imm); break;
+            case SR_MULT_HI: {
+                mips_rr(MI_MULT, rs, rt);
+                mips_r(MI_MFHI, rd);
+                break;
+            }
+            default: assert(0);
+        }
+    }
+    spill_reg(rr);
+    free_reg(r1);
+    free_reg(tmp1);
+    free_reg(tmp2);
+}
+
 void spill_reg(Reg* r) {
+    if (r->allocated) return;
     int off = r->lva->off;
-    printIns("sw %s, %d($fp)", r->name, off);
+    mips_mem(MI_SW, r->no, off, MR_FP);
     free_reg(r);
 }
 
 void free_reg(Reg* r) {
+    if (r->allocated) return;
     r->unused = true;
     r->lva = NULL;
 }
 
 void init_reg() {
-    for (int i = 0; i < 10; i ++) {
-        t_regs[i].name[0] = '$';
-        t_regs[i].name[1] = 't';
-        t_regs[i].name[2] = '0' + i;
+    // without the allocator every $t register is scratch
+    static const char* scratch_names[] = { "$t7", "$t8", "$t9", "$v1" };
+    num_scratch_regs = options.regalloc ? 4 : 10;
+    for (int i = 0; i < num_scratch_regs; i ++) {
+        if (options.regalloc) {
+            t_regs[i].no = mips_reg(scratch_names[i]);
+        } else {
+            t_regs[i].no = i < 8 ? MR_T0 + i : MR_T8 + i - 8;
+        }
         t_regs[i].unused = true;
+        t_regs[i].allocated = false;
         t_regs[i].lva = NULL;
     }
-}
-
-LocalVarAddr* get_lva(Operand* opd) {
-    LvaList *node = lva_list;
-    for (; node != NULL; node = node->next) {
-        if ((opd->kind == OP_TEMP && node->lva->kind == LV_TEMP
-            && opd->u.var_id == node->lva->u.id)
-        || (opd->kind == OP_VARIABLE && node->lva->kind == LV_VAR
-            && strcmp(opd->symbol->name, node->lva->u.name) == 0)) {
-            return node->lva;
-        }
+    for (int i = 0; i < RA_NUM_REGS; i ++) {
+        ra_regs[i].no = mips_reg(ra_reg_names[i]);
+        ra_regs[i].unused = false;
+        ra_regs[i].allocated = true;
+        ra_regs[i].lva = NULL;
     }
-    return add_lva(opd);        
 }
 
-LocalVarAddr* add_lva(Operand* opd) {
-    LocalVarAddr* lva = (LocalVarAddr*)malloc(sizeof(LocalVarAddr));
-    if (opd->kind == OP_TEMP) {
-        lva->kind = LV_TEMP;
-        lva->u.id = opd->u.var_id;
-    } else if (opd->kind == OP_VARIABLE) {
-        lva->kind = LV_VAR;
-        lva->u.name = opd->symbol->name;
-    } else
-        assert(0);
-    lva->off = (lva_off -= 4);
-    LvaList *node = (LvaList*)malloc(sizeof(LvaList));
-    node->lva = lva;
-    node->next = lva_list;
-    lva_list = node;
-    printIns("addi $sp, $sp, -4"); // allocate
-    return lva;
-}
-
-void add_array2lva(Operand* opd, int size) {
-    assert(opd->kind == OP_TEMP);
-    LocalVarAddr* lva = (LocalVarAddr*)malloc(sizeof(LocalVarAddr));
-    lva->kind = LV_TEMP;
-    lva->u.id = opd->u.var_id;
-    lva->off = (lva_off -= size);
-    LvaList *node = (LvaList*)malloc(sizeof(LvaList));
-    node->lva = lva;
-    node->next = lva_list;
-    lva_list = node;
-    printIns("addi $sp, $sp, -%d", size); // allocate
-}
-
-void add_param2lva(Operand* opd) {
-    assert(opd->kind == OP_VARIABLE);
-    LocalVarAddr* lva = (LocalVarAddr*)malloc(sizeof(LocalVarAddr));
-    lva->kind = LV_VAR;
-    lva->u.name = opd->symbol->name;
-    lva->off = (param_off += 4);
-    LvaList *node = (LvaList*)malloc(sizeof(LvaList));
-    node->lva = lva;
-    node->next = lva_list;
-    lva_list = node;
-}
-
-void clear_lvas() {
-    lva_list = NULL;
-    lva_off = 0;
-    param_off = 4;
+LocalVarAddr* get_lva(Operand* opd) {
+    int index = ra_index(opd);
+    assert(index >= 0 && lvas[index].assigned);
+    return &lvas[index];
 }
 
+// $fp points at the saved $fp, with the saved $ra above it and the stack
+// arguments above that; the whole frame is allocated with one addi
 void gen_prologue() {
-    printIns("addi $sp, $sp, -4");
-    printIns("sw $fp, 0($sp)");
-    printIns("move $fp, $sp");
+    if (frameless) return;
+    mips_rri(MI_ADDI, MR_SP, MR_SP, -(frame_size + (saves_ra ? 8 : 4)));
+    if (saves_ra) {
+        mips_mem(MI_SW, MR_RA, frame_size + 4, MR_SP);
+    }
+    mips_mem(MI_SW, MR_FP, frame_size, MR_SP);
+    if (frame_size > 0) {
+        mips_rri(MI_ADDI, MR_FP, MR_SP, frame_size);
+    } else {
+        mips_rr(MI_MOVE, MR_FP, MR_SP);
+    }
+    for (int i = 0, k = 0; i < RA_NUM_SAVED_REGS; i++) {
+        if (ra_saved_regs_used() & (1u << i)) {
+            mips_mem(MI_SW, MR_S0 + i, -4 * ++k, MR_FP);
+        }
+    }
 }
 
 void gen_epilogue() {
-    printIns("move $sp, $fp");
-    printIns("lw $fp, 0($sp)");
-    printIns("addi $sp, $sp, 4");
+    if (frameless) return;
+    if (saved_reg_count() > 0) {
+        for (int i = 0, k = 0; i < RA_NUM_SAVED_REGS; i++) {
+            if (ra_saved_regs_used() & (1u << i)) {
+                mips_mem(MI_LW, MR_S0 + i, -4 * ++k, MR_FP);
+            }
+        }
+    }
+    mips_rr(MI_MOVE, MR_SP, MR_FP);
+    mips_mem(MI_LW, MR_FP, 0, MR_SP);
+    if (saves_ra) {
+        mips_mem(MI_LW, MR_RA, 4, MR_SP);
+        mips_rri(MI_ADDI, MR_SP, MR_SP, 8);
+    } else {
+        mips_rri(MI_ADDI, MR_SP, MR_SP, 4);
+    }
 }
 
 void gen_addr(Reg* r, Operand* opd) {
     LocalVarAddr* lva = get_lva(opd);
-    printIns("la %s, %d($fp)", r->name, lva->off);
+    mips_rri(MI_ADDI, r->no, MR_FP, lva->off);
 }
 
-InterCodes* ic_start, *ic_end;
-
-void peek_basic_block2(InterCodes* codes) {
-    for(ic_start = codes; ic_start != NULL; ic_start = ic_start->next) {
-        if (ic_start->code.kind == IR_ASSIGN || ic_start->code.kind == IR_ADD || 
-            ic_start->code.kind == IR_SUB  || ic_start->code.kind == IR_MUL ||
-            ic_start->code.kind == IR_DIV || ic_start->code.kind == IR_ARG) {
-                break;
-            }
-    }
-
-    for(ic_end = ic_start; ic_end != NULL; ic_end = ic_end->next) {
-        if (ic_end->code.kind != IR_ASSIGN && ic_end->code.kind != IR_ADD && 
-            ic_end->code.kind != IR_SUB  && ic_end->code.kind != IR_MUL &&
-            ic_end->code.kind != IR_DIV && ic_end->code.kind != IR_ARG &&
-            ic_end->code.kind != IR_DEREF_L && ic_end->code.kind != IR_DEREF_R && ic_end->code.kind != IR_ADDR) {
-                ic_end = ic_end->next;
-                break;
-            }
-    }
+bool is_imm(int value) {
+    return value >= IMM_MIN && value <= IMM_MAX;
 }
 
-Reg* alloc_reg(Operand* opd) {
-    Reg* reg = NULL;
-    for (InterCodes* p = ic_end; p != ic_start; p = p->prev) {
-        for (int i = 9; i >= 0; i--) {
-            Reg* r = t_regs + i;
-            if ((p->code.arg1.kind == OP_TEMP && p->code.arg1.u.label_id == r->lva->u.id) ||
-                (p->code.arg1.kind == OP_VARIABLE && strcmp(p->code.arg1.symbol->name, r->name) == 0)) {
-                    reg = r;
-                    goto end;
-                }
-            if ((p->code.arg2.kind == OP_TEMP && p->code.arg2.u.label_id == r->lva->u.id) ||
-                (p->code.arg2.kind == OP_VARIABLE && strcmp(p->code.arg2.symbol->name, r->name) == 0)) {
-                    reg = r;
-                    goto end;
-                }
-            if ((p->code.result.kind == OP_TEMP && p->code.result.u.label_id == r->lva->u.id) ||
-                (p->code.result.kind == OP_VARIABLE && strcmp(p->code.result.symbol->name, r->name) == 0)) {
-                    reg = r;
-                    goto end;
-                }
-        }
-    }
-    end:
-    spill_reg(reg);
-    return reg;
+// result := src + imm, modulo 2^32 if wraps
+void gen_addi(Operand* result, Operand* src, int imm, bool wraps) {
+    Reg* rr = get_def_reg(result);
+    Reg* r1 = get_reg(src);
+    mips_rri(wraps ? MI_ADDIU : MI_ADDI, rr->no, r1->no, imm);
+    spill_reg(rr);
+    free_reg(r1);
 }
 
-Reg* get_reg2(Operand* opd) {
-    for (int i = 0; i < 10; i ++) {
-        if (t_regs[i].unused) {
-            t_regs[i].unused = false;
-            if (opd->kind == OP_CONSTANT) {
-                printIns("li %s, %d", t_regs[i].name, opd->u.value);
-            }
-            else {
-                t_regs[i].lva = get_lva(opd);
-                printIns("lw %s, %d($fp)", t_regs[i].name, t_regs[i].lva->off);
-            }
-            return t_regs + i;
-        }
+// register holding the base of the address opd, with the offset to add to
+// it in *off; folded address computations become the offset
+Reg* get_addr_reg(Operand* opd, int* off) {
+    IselAddr a = isel_address(opd);
+    if (a.in_frame) {
+        *off = get_lva(&a.base)->off + a.off;
+        return &fp_reg;
     }
-    return alloc_reg(opd);
+    *off = a.off;
+    return get_reg(&a.base);
 }
 
-void try_free_reg(InterCodes* current, Reg* r) {
-    bool can_free = true;
-    for (InterCodes* p = current + 1; p != ic_end; p = p->next) {
-        if ((p->code.arg1.kind == OP_TEMP && p->code.arg1.u.label_id == r->lva->u.id) ||
-            (p->code.arg1.kind == OP_VARIABLE && strcmp(p->code.arg1.symbol->name, r->name) == 0)) {
-                can_free = false;
-                break;
-            }
-        if ((p->code.arg2.kind == OP_TEMP && p->code.arg2.u.label_id == r->lva->u.id) ||
-            (p->code.arg2.kind == OP_VARIABLE && strcmp(p->code.arg2.symbol->name, r->name) == 0)) {
-                can_free = false;
-                break;
-            }
-        if ((p->code.result.kind == OP_TEMP && p->code.result.u.label_id == r->lva->u.id) ||
-            (p->code.result.kind == OP_VARIABLE && strcmp(p->code.result.symbol->name, r->name) == 0)) {
-                can_free = false;
-                break;
-            }
-    }
-    if (can_free) {
-        r->unused = true;
-        r->lva = NULL;
+// IF x [relop] #0 GOTO label as one of the branches comparing with zero
+bool gen_branch_zero(InterCodes* ic) {
+    static const MipsOp ops[] = {
+        [RELOP_LT] = MI_BLTZ, [RELOP_LE] = MI_BLEZ, [RELOP_EQ] = MI_BEQZ,
+        [RELOP_GT] = MI_BGTZ, [RELOP_GE] = MI_BGEZ, [RELOP_NE] = MI_BNEZ,
+    };
+    Operand* x;
+    enum RELOP_TYPE relop = ic->code.relop;
+    if (ic->code.arg2.kind == OP_CONSTANT && ic->code.arg2.u.value == 0) {
+        x = &ic->code.arg1;
+    } else if (ic->code.arg1.kind == OP_CONSTANT && ic->code.arg1.u.value == 0) {
+        x = &ic->code.arg2;
+        relop = get_mirror_relop(relop);
+    } else {
+        return false;
     }
+    Reg* r = get_reg(x);
+    char label[16];
+    sprintf(label, "label%d", ic->code.result.u.label_id);
+    mips_emit(ops[relop], r->no, 0, 0, 0, label);
+    free_reg(r);
+    return true;
 }
 
-void spill_all_regs() {
-    for (int i = 0; i < 10; i ++) {
-        if (!t_regs[i].unused) {
-            spill_reg(t_regs + i);
-        }
+// result := x [relop] #c with the immediate forms of slt and xor
+bool gen_setrel_imm(InterCodes* ic) {
+    Operand* x;
+    int c;
+    enum RELOP_TYPE relop = ic->code.relop;
+    if (ic->code.arg2.kind == OP_CONSTANT && ic->code.arg1.kind != OP_CONSTANT) {
+        x = &ic->code.arg1;
+        c = ic->code.arg2.u.value;
+    } else if (ic->code.arg1.kind == OP_CONSTANT && ic->code.arg2.kind != OP_CONSTANT) {
+        x = &ic->code.arg2;
+        c = ic->code.arg1.u.value;
+        relop = get_mirror_relop(relop);
+    } else {
+        return false;
     }
-}
-
-void gen_text_seg2(InterCodes* ics) {
-    init_reg();
-    println(".text");
-    gen_read_func();
-    gen_write_func();
-    InterCodes* ic = ics;
-    ic_start = ic_end = ics;
-    while (ic_end != NULL) {
-        peek_basic_block2(ics);
-        for (ic = ic_start; ic != ic_end; ic = ic->next) {
-            switch (ic->code.kind) {
-                case IR_LABEL: {
-                    println("label%d:", ic->code.result.u.label_id);
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_FUNC: {
-                    println();
-                    println("%s:", ic->code.result.symbol->name);
-                    clear_lvas();
-                    gen_prologue();
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_ASSIGN: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    printIns("move %s, %s", rr->name, r1->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_ADD: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    Reg* r2 = get_reg2(&ic->code.arg2);
-                    printIns("add %s, %s, %s", rr->name, r1->name, r2->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, r2);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_SUB: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    Reg* r2 = get_reg2(&ic->code.arg2);
-                    printIns("sub %s, %s, %s", rr->name, r1->name, r2->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, r2);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_MUL: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    Reg* r2 = get_reg2(&ic->code.arg2);
-                    printIns("mul %s, %s, %s", rr->name, r1->name, r2->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, r2);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_DIV: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    Reg* r2 = get_reg2(&ic->code.arg2);
-                    printIns("div %s, %s", r1->name, r2->name);
-                    printIns("mflo %s", rr->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, r2);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_ADDR: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    gen_addr(rr, &ic->code.arg1);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_DEREF_L: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    printIns("sw %s, 0(%s)", r1->name, rr->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_DEREF_R: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    printIns("lw %s, 0(%s)", rr->name, r1->name);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, rr);
-                    break;
-                }
-                case IR_GOTO: {
-                    printIns("j label%d", ic->code.result.u.label_id);
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_RELOP: {
-                    char *ins;
-                    switch (ic->code.relop) {
-                        case RELOP_EQ: ins = "beq"; break;
-                        case RELOP_NE: ins = "bne"; break;
-                        case RELOP_GT: ins = "bgt"; break;
-                        case RELOP_LT: ins = "blt"; break;
-                        case RELOP_GE: ins = "bge"; break;
-                        case RELOP_LE: ins = "ble"; break;
-                        default: assert(0);
-                    }
-                    Reg* r1 = get_reg2(&ic->code.arg1);
-                    Reg* r2 = get_reg2(&ic->code.arg2);
-                    printIns("%s %s, %s, label%d", ins, r1->name, r2->name,
-                        ic->code.result.u.label_id);
-                    try_free_reg(ic, r1);
-                    try_free_reg(ic, r2);
-                    break;
-                }
-                case IR_RETURN: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    printIns("move $v0, %s", rr->name);
-                    // invoke gen_epilogue() after get_reg(...)
-                    // avoid to reset $fp early
-                    gen_epilogue();
-                    printIns("jr $ra");
-                    free_reg(rr);
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_DEC: {
-                    add_array2lva(&ic->code.result, ic->code.size);
-                    break;
-                }
-                case IR_ARG: {
-                    // put all args on stack
-                    Reg* rr = get_reg2(&ic->code.result);
-                    printIns("addi $sp, $sp, -4");
-                    printIns("sw %s, 0($sp)", rr->name);
-                    free_reg(rr);
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_CALL: {
-                    printIns("addi $sp, $sp, -4");
-                    printIns("sw $ra, 0($sp)");
-                    printIns("jal %s", ic->code.arg1.symbol->name);
-                    printIns("lw $ra, 0($sp)");
-                    printIns("addi $sp, $sp, 4");
-                    // don't invoke get_reg(...) before 'jal ...'
-                    // avoid to allocate stack between ARG... and CALL...
-                    Reg* rr = get_reg2(&ic->code.result);
-                    printIns("move %s, $v0", rr->name);
-                    spill_reg(rr);
-                    assert(ic_start + 1 == ic_end);
-                    break;
-                }
-                case IR_PARAM: {
-                    add_param2lva(&ic->code.result);
-                    break;
-                }
-                case IR_READ: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    printIns("addi $sp, $sp, -4");
-                    printIns("sw $ra, 0($sp)");
-                    printIns("jal read");
-                    printIns("lw $ra, 0($sp)");
-                    printIns("addi $sp, $sp, 4");
-                    printIns("move %s, $v0", rr->name);
-                    spill_reg(rr);
-                    break;
-                }
-                case IR_WRITE: {
-                    Reg* rr = get_reg2(&ic->code.result);
-                    printIns("move $a0, %s", rr->name);
-                    free_reg(rr);
+    // x <= c is x < c + 1, x > c is its negation
+    if ((relop == RELOP_LE || relop == RELOP_GT) && (c == IMM_MAX || !is_imm(c + 1))) return false;
+    if ((relop == RELOP_LT || relop == RELOP_GE) && !is_imm(c)) return false;
+    // xori zero-extends its immediate
+    if ((relop == RELOP_EQ || relop == RELOP_NE) && (c < 0 || c > 0xffff)) return false;
 
-                    printIns("addi $sp, $sp, -4");
-                    printIns("sw $ra, 0($sp)");
-                    printIns("jal write");
-                    printIns("lw $ra, 0($sp)");
-                    printIns("addi $sp, $sp, 4");
-                    break;
-                }
-                default: assert(0);
+    Reg* rr = get_def_reg(&ic->code.result);
+    Reg* r1 = get_reg(x);
+    switch (relop) {
+        case RELOP_LT: mips_rri(MI_SLTI, rr->no, r1->no, c); break;
+        case RELOP_LE: mips_rri(MI_SLTI, rr->no, r1->no, c + 1); break;
+        case RELOP_GT: {
+            mips_rri(MI_SLTI, rr->no, r1->no, c + 1);
+            mips_rri(MI_XORI, rr->no, rr->no, 1);
+            break;
+        }
+        case RELOP_GE: {
+            mips_rri(MI_SLTI, rr->no, r1->no, c);
+            mips_rri(MI_XORI, rr->no, rr->no, 1);
+            break;
+        }
+        case RELOP_EQ: {
+            int r = r1->no;
+            if (c != 0) {
+                mips_rri(MI_XORI, rr->no, r1->no, c);
+                r = rr->no;
+            }
+            mips_rri(MI_SLTIU, rr->no, r, 1);
+            break;
+        }
+        case RELOP_NE: {
+            int r = r1->no;
+            if (c != 0) {
+                mips_rri(MI_XORI, rr->no, r1->no, c);
+                r = rr->no;
             }
+            mips_rrr(MI_SLTU, rr->no, MR_ZERO, r);
+            break;
         }
-        spill_all_regs();
+        default: assert(0);
     }
+    spill_reg(rr);
+    free_reg(r1);
+    return true;
 }
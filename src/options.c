@@ -0,0 +1,94 @@
+#include "options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Options options = {
+    .optimize = true,
+    .regalloc = true,
+    .peephole = true,
+    .schedule = true,
+    .delay_slots = false,
+    .inline_io = true,
+    .line_info = false,
+    .time_report = false,
+    .time_report_json = false,
+    .stats = false,
+    .stats_json = false,
+    .mem_report = false,
+    .mem_budget = 0,
+    .profile_generate = false,
+    .profile_use = NULL,
+};
+
+static const struct {
+    const char *name;
+    bool *flag;
+} flag_table[] = {
+    { "optimize", &options.optimize },
+    { "regalloc", &options.regalloc },
+    { "peephole", &options.peephole },
+    { "schedule", &options.schedule },
+    { "delay-slots", &options.delay_slots },
+    { "inline-io", &options.inline_io },
+    { "line-info", &options.line_info },
+    { "time-report", &options.time_report },
+    { "time-report-json", &options.time_report_json },
+    { "stats", &options.stats },
+    { "stats-json", &options.stats_json },
+    { "mem-report", &options.mem_report },
+    { "profile-generate", &options.profile_generate },
+};
+
+// <n>[K|M|G] bytes
+static bool set_budget(const char *arg) {
+    char *end;
+    long long n = strtoll(arg, &end, 10);
+    switch (*end) {
+        case 'K': n <<= 10; end++; break;
+        case 'M': n <<= 20; end++; break;
+        case 'G': n <<= 30; end++; break;
+        default: break;
+    }
+    if (end == arg || *end != '\0' || n < 0) return false;
+    options.mem_budget = n;
+    return true;
+}
+
+static bool set_flag(const char *arg) {
+    if (strncmp(arg, "mem-budget=", 11) == 0) return set_budget(arg + 11);
+    if (strncmp(arg, "profile-use=", 12) == 0) {
+        options.profile_use = arg + 12;
+        return *options.profile_use != '\0';
+    }
+    bool value = true;
+    if (strncmp(arg, "no-", 3) == 0) {
+        value = false;
+        arg += 3;
+    }
+    for (size_t i = 0; i < sizeof(flag_table) / sizeof(flag_table[0]); i++) {
+        if (strcmp(arg, flag_table[i].name) == 0) {
+            *flag_table[i].flag = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+int parse_options(int argc, char **argv) {
+    int n = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-g") == 0) {
+            options.line_info = true;
+        } else if (strncmp(argv[i], "-f", 2) == 0) {
+            if (!set_flag(argv[i] + 2)) {
+                fprintf(stderr, "unknown option: %s\n", argv[i]);
+                return -1;
+            }
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    argv[n] = NULL;
+    return n;
+}
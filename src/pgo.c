@@ -0,0 +1,768 @@
+#include "pgo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "call_graph.h"
+#include "memstat.h"
+#include "options.h"
+#include "stats.h"
+#include "sym_table.h"
+
+typedef struct {
+    InterCodes *first, *last;   // the LABELs of the block, if any, come first
+    InterCodes *body;           // first code that is not a LABEL, NULL for labels only
+    uint32_t hash;
+    long long count, taken;     // from the profile, -1 when it is not there
+    int size;                   // codes that are not LABELs
+} Block;
+
+// the blocks of one function at a time
+static Block *blocks;
+static int nblocks, block_capacity;
+
+static bool ends_block(InterCodes* p) {
+    return p->code.kind == IR_GOTO || p->code.kind == IR_RELOP || p->code.kind == IR_RETURN;
+}
+
+// the basic blocks of the function whose FUNCTION is func; returns the
+// FUNCTION of the next function, or NULL
+static InterCodes* split_blocks(InterCodes* func) {
+    nblocks = 0;
+    InterCodes* p = func->next;
+    while (p != NULL && p->code.kind != IR_FUNC) {
+        if (nblocks == block_capacity) {
+            block_capacity = block_capacity ? block_capacity * 2 : 64;
+            blocks = (Block*)realloc(blocks, sizeof(Block) * block_capacity);
+        }
+        Block* b = &blocks[nblocks++];
+        memset(b, 0, sizeof(Block));
+        b->count = b->taken = -1;
+        b->first = p;
+        for (; p != NULL && p->code.kind == IR_LABEL; p = p->next) b->last = p;
+        for (; p != NULL && p->code.kind != IR_FUNC && p->code.kind != IR_LABEL; p = p->next) {
+            if (b->body == NULL) b->body = p;
+            b->size++;
+            b->last = p;
+            if (ends_block(p)) {
+                p = p->next;
+                break;
+            }
+        }
+    }
+    return p;
+}
+
+// the operands each kind of instruction has
+static int operands_of(InterCode* c, Operand** ops) {
+    switch (c->kind) {
+        case IR_ASSIGN: case IR_ADDR: case IR_DEREF_R: case IR_DEREF_L: case IR_CALL:
+            ops[0] = &c->result;
+            ops[1] = &c->arg1;
+            return 2;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+        case IR_RELOP: case IR_SETREL: case IR_CMOV:
+            ops[0] = &c->result;
+            ops[1] = &c->arg1;
+            ops[2] = &c->arg2;
+            return 3;
+        default:
+            ops[0] = &c->result;
+            return 1;
+    }
+}
+
+// FNV-1a
+static uint32_t hash_int(uint32_t h, uint32_t v) {
+    for (int i = 0; i < 4; i++, v >>= 8) h = (h ^ (v & 0xff)) * 16777619u;
+    return h;
+}
+
+static uint32_t hash_string(uint32_t h, const char* s) {
+    for (; *s != '\0'; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return hash_int(h, 0);
+}
+
+static uint32_t hash_operand(uint32_t h, Operand* op) {
+    h = hash_int(h, op->kind);
+    if (op->kind == OP_VARIABLE || op->kind == OP_FUNCTION) return hash_string(h, op->symbol->name);
+    if (op->kind == OP_CONSTANT) return hash_int(h, (uint32_t)op->u.value);
+    // temps and labels are numbered anew after any change to the program
+    return h;
+}
+
+static uint32_t hash_block(Block* b) {
+    uint32_t h = 2166136261u;
+    for (InterCodes* p = b->body; p != NULL; p = p->next) {
+        InterCode* c = &p->code;
+        h = hash_int(h, c->kind);
+        if (c->kind == IR_RELOP || c->kind == IR_SETREL || c->kind == IR_CMOV) h = hash_int(h, c->relop);
+        if (c->kind == IR_DEC) h = hash_int(h, (uint32_t)c->size);
+        Operand* ops[3];
+        int n = operands_of(c, ops);
+        for (int i = 0; i < n; i++) h = hash_operand(h, ops[i]);
+        if (p == b->last) break;
+    }
+    return h;
+}
+
+// blocks of a function that compute the same are told apart by how many
+// came before them
+static void hash_blocks() {
+    for (int i = 0; i < nblocks; i++) {
+        blocks[i].hash = blocks[i].body != NULL ? hash_block(&blocks[i]) : 0;
+    }
+    for (int i = nblocks - 1; i > 0; i--) {
+        uint32_t same = 0;
+        for (int j = 0; j < i; j++) {
+            if (blocks[j].hash == blocks[i].hash) same++;
+        }
+        if (same > 0) blocks[i].hash = hash_int(blocks[i].hash, same);
+    }
+}
+
+// pos must not be the head of the list
+static void insert_before(InterCodes* pos, InterCodes* code) {
+    if (code->code.lineno == 0) code->code.lineno = pos->code.lineno;
+    code->prev = pos->prev;
+    code->next = pos;
+    pos->prev->next = code;
+    pos->prev = code;
+}
+
+static InterCodes* first_function(InterCodes* codes) {
+    while (codes != NULL && codes->code.kind != IR_FUNC) codes = codes->next;
+    return codes;
+}
+
+InterCodes* pgo_instrument(InterCodes* codes) {
+    InterCodes* func = first_function(codes);
+    while (func != NULL) {
+        InterCodes* next = split_blocks(func);
+        hash_blocks();
+        for (int i = 0; i < nblocks; i++) {
+            if (blocks[i].body == NULL) continue;
+            InterCodes* count = newInterCodes();
+            count->code.kind = IR_COUNT;
+            count->code.result.kind = OP_CONSTANT;
+            count->code.result.u.value = (int)blocks[i].hash;
+            insert_before(blocks[i].body, count);
+            stats_add("profile", "blocks instrumented", 1);
+        }
+        func = next;
+    }
+    return codes;
+}
+
+// the profile, functions sorted by name and their blocks by hash
+
+typedef struct {
+    uint32_t hash;
+    long long count, taken;
+} ProfileBlock;
+
+typedef struct {
+    char *name;
+    ProfileBlock *blocks;
+    int nblocks, capacity;
+} ProfileFunc;
+
+static ProfileFunc *pfuncs;
+static int npfuncs, pfunc_capacity;
+
+static ProfileFunc* add_profile_func(const char* name) {
+    // the profiles of several runs can be concatenated
+    for (int i = 0; i < npfuncs; i++) {
+        if (strcmp(pfuncs[i].name, name) == 0) return &pfuncs[i];
+    }
+    if (npfuncs == pfunc_capacity) {
+        pfunc_capacity = pfunc_capacity ? pfunc_capacity * 2 : 64;
+        pfuncs = (ProfileFunc*)realloc(pfuncs, sizeof(ProfileFunc) * pfunc_capacity);
+    }
+    ProfileFunc* f = &pfuncs[npfuncs++];
+    memset(f, 0, sizeof(ProfileFunc));
+    f->name = strdup(name);
+    return f;
+}
+
+static void add_profile_block(ProfileFunc* f, uint32_t hash, long long count, long long taken) {
+    if (f->nblocks == f->capacity) {
+        f->capacity = f->capacity ? f->capacity * 2 : 16;
+        f->blocks = (ProfileBlock*)realloc(f->blocks, sizeof(ProfileBlock) * f->capacity);
+    }
+    f->blocks[f->nblocks++] = (ProfileBlock){ hash, count, taken };
+}
+
+static int func_by_name(const void* a, const void* b) {
+    return strcmp(((const ProfileFunc*)a)->name, ((const ProfileFunc*)b)->name);
+}
+
+static int block_by_hash(const void* a, const void* b) {
+    uint32_t x = ((const ProfileBlock*)a)->hash, y = ((const ProfileBlock*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+static bool read_profile(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) return false;
+    char* line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+    ProfileFunc* f = NULL;
+    while (getline(&line, &len, in) != -1) {
+        lineno++;
+        char name[256], taken[32];
+        unsigned hash;
+        long long count;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+        if (sscanf(line, "function %255s", name) == 1) {
+            f = add_profile_func(name);
+        } else if (f != NULL && sscanf(line, "block %x %lld %31s", &hash, &count, taken) == 3) {
+            add_profile_block(f, hash, count, strcmp(taken, "-") == 0 ? -1 : atoll(taken));
+        } else {
+            fprintf(stderr, "warning: %s:%d: not a line of a profile, ignored\n", path, lineno);
+        }
+    }
+    free(line);
+    fclose(in);
+
+    qsort(pfuncs, npfuncs, sizeof(ProfileFunc), func_by_name);
+    for (int i = 0; i < npfuncs; i++) {
+        ProfileFunc* pf = &pfuncs[i];
+        qsort(pf->blocks, pf->nblocks, sizeof(ProfileBlock), block_by_hash);
+        int n = 0;
+        for (int j = 0; j < pf->nblocks; j++) {
+            ProfileBlock* b = &pf->blocks[j];
+            if (n > 0 && pf->blocks[n - 1].hash == b->hash) {
+                ProfileBlock* merged = &pf->blocks[n - 1];
+                merged->count += b->count;
+                if (b->taken >= 0) merged->taken = (merged->taken < 0 ? 0 : merged->taken) + b->taken;
+            } else {
+                pf->blocks[n++] = *b;
+            }
+        }
+        pf->nblocks = n;
+    }
+    return true;
+}
+
+static void free_profile() {
+    for (int i = 0; i < npfuncs; i++) {
+        free(pfuncs[i].name);
+        free(pfuncs[i].blocks);
+    }
+    free(pfuncs);
+    pfuncs = NULL;
+    npfuncs = pfunc_capacity = 0;
+}
+
+static ProfileFunc* find_profile_func(const char* name) {
+    ProfileFunc key;
+    key.name = (char*)name;
+    return (ProfileFunc*)bsearch(&key, pfuncs, npfuncs, sizeof(ProfileFunc), func_by_name);
+}
+
+static ProfileBlock* find_profile_block(ProfileFunc* f, uint32_t hash) {
+    ProfileBlock key = { hash, 0, 0 };
+    return (ProfileBlock*)bsearch(&key, f->blocks, f->nblocks, sizeof(ProfileBlock), block_by_hash);
+}
+
+static long long executions(Block* b) {
+    return b->count > 0 ? b->count : 0;
+}
+
+// block layout
+
+// label id -> block of the function being laid out
+static int *label_block;
+static int label_capacity;
+
+static int label_of(Block* b) {
+    if (b->first->code.kind == IR_LABEL) return b->first->code.result.u.label_id;
+    InterCodes* label = genLabelCode(newLabelId());
+    label->code.lineno = b->first->code.lineno;
+    label->next = b->first;
+    b->first->prev = label;
+    b->first = label;
+    return label->code.result.u.label_id;
+}
+
+static void append_goto(Block* b, int label) {
+    InterCodes* jump = genGotoCode(label);
+    jump->code.lineno = b->last->code.lineno;
+    jump->prev = b->last;
+    b->last->next = jump;
+    b->last = jump;
+    stats_add("block layout", "jumps added", 1);
+}
+
+typedef struct {
+    int from, to;
+    long long weight;
+    bool fall;
+} Edge;
+
+static int edge_by_weight(const void* a, const void* b) {
+    const Edge *x = (const Edge*)a, *y = (const Edge*)b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    if (x->fall != y->fall) return x->fall ? -1 : 1;
+    return x->from - y->from;
+}
+
+// Bottom-up chaining (Pettis and Hansen): going through the edges from the
+// most to the least executed, an edge joins two chains when it leads from
+// the tail of one to the head of another. The chain of the entry comes
+// first, then the chains with executed blocks and then those without, each
+// in the order of their heads. A last block running off the end of the
+// function stays last.
+static void layout_function(InterCodes* func, InterCodes* next) {
+    if (nblocks < 2) return;
+    if (labelId > label_capacity) {
+        label_capacity = labelId * 2;
+        label_block = (int*)realloc(label_block, sizeof(int) * label_capacity);
+    }
+    for (int i = 0; i < nblocks; i++) {
+        for (InterCodes* p = blocks[i].first; p->code.kind == IR_LABEL; p = p->next) {
+            label_block[p->code.result.u.label_id] = i;
+            if (p == blocks[i].last) break;
+        }
+    }
+
+    int *fall = (int*)malloc(sizeof(int) * nblocks), *jump = (int*)malloc(sizeof(int) * nblocks);
+    long long *fall_w = (long long*)malloc(sizeof(long long) * nblocks);
+    long long *jump_w = (long long*)malloc(sizeof(long long) * nblocks);
+    for (int i = 0; i < nblocks; i++) {
+        InterCode* t = &blocks[i].last->code;
+        long long count = executions(&blocks[i]);
+        fall[i] = jump[i] = -1;
+        fall_w[i] = jump_w[i] = 0;
+        if (t->kind == IR_GOTO) {
+            jump[i] = label_block[t->result.u.label_id];
+            jump_w[i] = count;
+        } else if (t->kind != IR_RETURN) {
+            fall[i] = i + 1 < nblocks ? i + 1 : -1;
+            fall_w[i] = count;
+            if (t->kind == IR_RELOP) {
+                long long taken = blocks[i].taken < 0 ? 0 : blocks[i].taken;
+                if (taken > count) taken = count;
+                jump[i] = label_block[t->result.u.label_id];
+                jump_w[i] = taken;
+                fall_w[i] = count - taken;
+            }
+        }
+    }
+    InterCode* end = &blocks[nblocks - 1].last->code;
+    int pinned = end->kind != IR_GOTO && end->kind != IR_RETURN ? nblocks - 1 : -1;
+
+    Edge* edges = (Edge*)malloc(sizeof(Edge) * 2 * nblocks);
+    int nedges = 0;
+    for (int i = 0; i < nblocks; i++) {
+        if (fall[i] >= 0 && fall_w[i] > 0) edges[nedges++] = (Edge){ i, fall[i], fall_w[i], true };
+        if (jump[i] >= 0 && jump_w[i] > 0) edges[nedges++] = (Edge){ i, jump[i], jump_w[i], false };
+    }
+    qsort(edges, nedges, sizeof(Edge), edge_by_weight);
+    int *chain_next = (int*)malloc(sizeof(int) * nblocks), *chain_head = (int*)malloc(sizeof(int) * nblocks);
+    for (int i = 0; i < nblocks; i++) {
+        chain_next[i] = -1;
+        chain_head[i] = i;
+    }
+    for (int e = 0; e < nedges; e++) {
+        int from = edges[e].from, to = edges[e].to;
+        if (chain_next[from] >= 0 || chain_head[to] != to || chain_head[from] == to) continue;
+        // the entry starts the first chain and the pinned block ends the last
+        if (to == 0 || from == pinned || (pinned >= 0 && chain_head[pinned] == to && chain_head[from] == 0)) continue;
+        chain_next[from] = to;
+        for (int i = to; i >= 0; i = chain_next[i]) chain_head[i] = chain_head[from];
+    }
+
+    int* order = (int*)malloc(sizeof(int) * nblocks);
+    int norder = 0;
+    int last_chain = pinned >= 0 ? chain_head[pinned] : -1;
+    for (int pass = 0; pass < 4; pass++) {
+        for (int h = 0; h < nblocks; h++) {
+            if (chain_head[h] != h) continue;
+            long long count = 0;
+            for (int i = h; i >= 0; i = chain_next[i]) count += executions(&blocks[i]);
+            int group = h == 0 ? 0 : h == last_chain ? 3 : count > 0 ? 1 : 2;
+            if (group != pass) continue;
+            for (int i = h; i >= 0; i = chain_next[i]) order[norder++] = i;
+        }
+    }
+    assert(norder == nblocks);
+
+    bool moved = false;
+    for (int k = 0; k < nblocks; k++) {
+        if (order[k] != k) {
+            moved = true;
+            stats_add("block layout", "blocks moved", 1);
+        }
+    }
+    if (moved) {
+        for (int k = 0; k < nblocks; k++) {
+            int i = order[k], nx = k + 1 < nblocks ? order[k + 1] : -1;
+            Block* b = &blocks[i];
+            InterCodes* t = b->last;
+            if (t->code.kind == IR_GOTO) {
+                if (jump[i] == nx && t != b->first) {
+                    b->last = t->prev;
+                    stats_add("block layout", "jumps removed", 1);
+                }
+            } else if (t->code.kind != IR_RETURN && fall[i] != nx) {
+                assert(fall[i] >= 0);
+                if (t->code.kind == IR_RELOP && jump[i] == nx) {
+                    // the branch goes where it fell through before
+                    t->code.relop = get_reverse_relop(t->code.relop);
+                    t->code.result.u.label_id = label_of(&blocks[fall[i]]);
+                    stats_add("block layout", "branches inverted", 1);
+                } else {
+                    append_goto(b, label_of(&blocks[fall[i]]));
+                }
+            }
+        }
+        InterCodes* prev = func;
+        for (int k = 0; k < nblocks; k++) {
+            Block* b = &blocks[order[k]];
+            prev->next = b->first;
+            b->first->prev = prev;
+            prev = b->last;
+        }
+        prev->next = next;
+        if (next != NULL) next->prev = prev;
+    }
+
+    free(fall);
+    free(jump);
+    free(fall_w);
+    free(jump_w);
+    free(edges);
+    free(chain_next);
+    free(chain_head);
+    free(order);
+}
+
+// inlining
+
+typedef struct {
+    InterCodes *call;
+    long long count;
+    int index;
+} CallSite;
+
+static int site_by_count(const void* a, const void* b) {
+    const CallSite *x = (const CallSite*)a, *y = (const CallSite*)b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return x->index - y->index;
+}
+
+// the ARGs of call, first parameter first, as in call_graph.c
+static bool collect_args(InterCodes* call, int nparams, InterCodes** args) {
+    InterCodes* p = call->prev;
+    for (int i = 0; i < nparams; i++, p = p->prev) {
+        if (p == NULL || p->code.kind != IR_ARG) return false;
+        args[i] = p;
+    }
+    return p == NULL || p->code.kind != IR_ARG;
+}
+
+static int fresh_count;
+
+// a variable of its own for each inlined copy; all names are in the one
+// global scope, so they are made unique there
+static Symbol fresh_variable(const char* base, Type type) {
+    Symbol s = (Symbol)mem_alloc(MEM_SYMBOL, sizeof(struct SymbolList_));
+    memset(s, 0, sizeof(struct SymbolList_));
+    s->kind = VAR_DEF;
+    s->u.type = type;
+    do {
+        snprintf(s->name, sizeof(s->name), "%.200s_%d", base, ++fresh_count);
+    } while (lookupSymbol(s->name, true) != NULL);
+    insertSymbol(s);
+    return s;
+}
+
+typedef struct {
+    int *temp_from, *temp_to, ntemps;
+    int *label_from, *label_to, nlabels;
+    Symbol *var_from, *var_to;
+    int nvars;
+} Renames;
+
+static int rename_id(int* from, int* to, int* n, int id, int (*make)()) {
+    for (int i = 0; i < *n; i++) {
+        if (from[i] == id) return to[i];
+    }
+    from[*n] = id;
+    to[*n] = make();
+    return to[(*n)++];
+}
+
+static void rename_operand(Renames* r, Operand* op) {
+    if (op->kind == OP_TEMP && op->u.var_id != VAR_NULL) {
+        op->u.var_id = rename_id(r->temp_from, r->temp_to, &r->ntemps, op->u.var_id, newVariableId);
+    } else if (op->kind == OP_LABEL) {
+        op->u.label_id = rename_id(r->label_from, r->label_to, &r->nlabels, op->u.label_id, newLabelId);
+    } else if (op->kind == OP_VARIABLE) {
+        int i = 0;
+        while (i < r->nvars && r->var_from[i] != op->symbol) i++;
+        if (i == r->nvars) {
+            r->var_from[i] = op->symbol;
+            r->var_to[i] = fresh_variable(op->symbol->name, op->symbol->u.type);
+            r->nvars++;
+        }
+        op->symbol = r->var_to[i];
+    }
+}
+
+static InterCodes* assign_code(Operand result, Operand value, int lineno) {
+    InterCodes* p = newInterCodes();
+    p->code.kind = IR_ASSIGN;
+    p->code.result = result;
+    p->code.arg1 = value;
+    p->code.lineno = lineno;
+    return p;
+}
+
+static void append(InterCodes** head, InterCodes** tail, InterCodes* p) {
+    p->next = NULL;
+    p->prev = *tail;
+    if (*tail != NULL) (*tail)->next = p;
+    else *head = p;
+    *tail = p;
+}
+
+// Replaces the ARGs and the CALL by a copy of the body of f, the PARAMs
+// assigning the arguments and each RETURN the result and jumping to the
+// end. Returns the instructions the copy added, or -1 when f is too big
+// for max_size or has arrays or structures of its own.
+static int inline_call(InterCodes* codes, InterCodes* call, CGFunc* f, int max_size) {
+    int size = 0, ncodes = 0, nreturns = 0;
+    for (InterCodes* p = f->head->next; p != NULL && p->code.kind != IR_FUNC; p = p->next) {
+        if (p->code.kind == IR_DEC || p->code.kind == IR_ADDR) return -1;
+        if (p->code.kind == IR_RETURN) nreturns++;
+        if (p->code.kind != IR_LABEL) size++;
+        ncodes++;
+    }
+    if (size > max_size) return -1;
+    InterCodes** args = (InterCodes**)malloc(sizeof(InterCodes*) * (f->nparams + 1));
+    if (!collect_args(call, f->nparams, args)) {
+        free(args);
+        return -1;
+    }
+
+    Renames r;
+    r.temp_from = (int*)malloc(sizeof(int) * 3 * ncodes);
+    r.temp_to = (int*)malloc(sizeof(int) * 3 * ncodes);
+    r.label_from = (int*)malloc(sizeof(int) * 3 * ncodes);
+    r.label_to = (int*)malloc(sizeof(int) * 3 * ncodes);
+    r.var_from = (Symbol*)malloc(sizeof(Symbol) * 3 * ncodes);
+    r.var_to = (Symbol*)malloc(sizeof(Symbol) * 3 * ncodes);
+    r.ntemps = r.nlabels = r.nvars = 0;
+
+    int line = call->code.lineno;
+    Operand result = call->code.result;
+    bool used = !(result.kind == OP_TEMP && result.u.var_id == VAR_NULL);
+    // a temp is assigned once, several RETURNs need a variable in between
+    Operand ret = result;
+    if (used && nreturns > 1 && result.kind == OP_TEMP) {
+        ret.kind = OP_VARIABLE;
+        ret.symbol = fresh_variable(f->symbol->name, f->symbol->u.func->retType);
+    }
+    int end_label = newLabelId();
+
+    InterCodes *head = NULL, *tail = NULL;
+    int param = 0;
+    for (InterCodes* p = f->head->next; p != NULL && p->code.kind != IR_FUNC; p = p->next) {
+        bool last = p->next == NULL || p->next->code.kind == IR_FUNC;
+        if (p->code.kind == IR_PARAM) {
+            assert(param < f->nparams);
+            Operand var = p->code.result;
+            rename_operand(&r, &var);
+            append(&head, &tail, assign_code(var, args[param++]->code.result, line));
+        } else if (p->code.kind == IR_RETURN) {
+            if (used) {
+                Operand value = p->code.result;
+                rename_operand(&r, &value);
+                append(&head, &tail, assign_code(ret, value, p->code.lineno));
+            }
+            if (!last) {
+                InterCodes* jump = genGotoCode(end_label);
+                jump->code.lineno = p->code.lineno;
+                append(&head, &tail, jump);
+            }
+        } else {
+            InterCodes* q = newInterCodes();
+            q->code = p->code;
+            Operand* ops[3];
+            int n = operands_of(&q->code, ops);
+            for (int i = 0; i < n; i++) rename_operand(&r, ops[i]);
+            append(&head, &tail, q);
+        }
+    }
+    InterCodes* end = genLabelCode(end_label);
+    end->code.lineno = line;
+    append(&head, &tail, end);
+    if (used && ret.kind != result.kind) append(&head, &tail, assign_code(result, ret, line));
+
+    InterCodes* pos = f->nparams > 0 ? args[f->nparams - 1] : call;
+    head->prev = pos->prev;
+    pos->prev->next = head;
+    tail->next = pos;
+    pos->prev = tail;
+    for (int i = 0; i < f->nparams; i++) deleteInterCode(codes, args[i]);
+    deleteInterCode(codes, call);
+
+    free(args);
+    free(r.temp_from);
+    free(r.temp_to);
+    free(r.label_from);
+    free(r.label_to);
+    free(r.var_from);
+    free(r.var_to);
+    return size;
+}
+
+static int inline_hot_calls(InterCodes* codes, CallSite* sites, int nsites, long long max_count) {
+    if (nsites == 0) return 0;
+    qsort(sites, nsites, sizeof(CallSite), site_by_count);
+    long long budget = 0;
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind != IR_LABEL && p->code.kind != IR_FUNC) budget++;
+    }
+    budget = budget * PGO_INLINE_GROWTH / 100;
+    if (budget < PGO_INLINE_MAX_SIZE) budget = PGO_INLINE_MAX_SIZE;
+    CallGraph* cg = build_call_graph(codes);
+    int inlined = 0;
+    for (int i = 0; i < nsites; i++) {
+        if (sites[i].count * 1000 < max_count * PGO_HOT_PERMILLE) break;
+        CGFunc* f = cg_lookup(cg, sites[i].call->code.arg1.symbol);
+        if (f == NULL || f->recursive) continue;
+        int max_size = budget < PGO_INLINE_MAX_SIZE ? (int)budget : PGO_INLINE_MAX_SIZE;
+        int size = inline_call(codes, sites[i].call, f, max_size);
+        if (size < 0) continue;
+        budget -= size;
+        inlined++;
+        stats_add("profile inline", "calls inlined", 1);
+        stats_add("profile inline", "instructions copied", size);
+    }
+    free_call_graph(cg);
+    return inlined;
+}
+
+// function order
+
+typedef struct {
+    Symbol symbol;
+    InterCodes *head, *tail;
+    long long cost;             // instructions executed, 0 when never called
+    int index;
+} FuncCost;
+
+static int func_by_symbol(const void* a, const void* b) {
+    Symbol x = ((const FuncCost*)a)->symbol, y = ((const FuncCost*)b)->symbol;
+    return x < y ? -1 : x > y;
+}
+
+static int func_by_cost(const void* a, const void* b) {
+    const FuncCost *x = (const FuncCost*)a, *y = (const FuncCost*)b;
+    if (x->cost != y->cost) return x->cost > y->cost ? -1 : 1;
+    return x->index - y->index;
+}
+
+// the most expensive function first, those that never ran last in their
+// old order; costs are of the functions before inlining, sorted by symbol
+static InterCodes* order_functions(InterCodes* codes, FuncCost* costs, int ncosts) {
+    if (codes == NULL || codes->code.kind != IR_FUNC) return codes;
+    int n = 0;
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_FUNC) n++;
+    }
+    FuncCost* funcs = (FuncCost*)malloc(sizeof(FuncCost) * n);
+    n = 0;
+    for (InterCodes* p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_FUNC) {
+            funcs[n] = (FuncCost){ p->code.result.symbol, p, p, 0, n };
+            FuncCost* c = (FuncCost*)bsearch(&funcs[n], costs, ncosts, sizeof(FuncCost), func_by_symbol);
+            if (c != NULL) funcs[n].cost = c->cost;
+            n++;
+        }
+        if (p->next == NULL || p->next->code.kind == IR_FUNC) funcs[n - 1].tail = p;
+    }
+
+    qsort(funcs, n, sizeof(FuncCost), func_by_cost);
+    InterCodes* prev = NULL;
+    for (int i = 0; i < n; i++) {
+        if (funcs[i].index != i) stats_add("function order", "functions moved", 1);
+        funcs[i].head->prev = prev;
+        if (prev != NULL) prev->next = funcs[i].head;
+        else codes = funcs[i].head;
+        prev = funcs[i].tail;
+    }
+    prev->next = NULL;
+    free(funcs);
+    return codes;
+}
+
+InterCodes* pgo_use(InterCodes* codes, const char* path) {
+    if (!read_profile(path)) {
+        fprintf(stderr, "warning: cannot read the profile %s, compiling without it\n", path);
+        return codes;
+    }
+
+    FuncCost* costs = NULL;
+    int ncosts = 0, cost_capacity = 0;
+    CallSite* sites = NULL;
+    int nsites = 0, site_capacity = 0;
+    long long max_count = 0;
+    InterCodes* func = first_function(codes);
+    while (func != NULL) {
+        InterCodes* next = split_blocks(func);
+        hash_blocks();
+        ProfileFunc* pf = find_profile_func(func->code.result.symbol->name);
+        long long cost = 0;
+        for (int i = 0; i < nblocks; i++) {
+            Block* b = &blocks[i];
+            if (b->body == NULL) continue;
+            ProfileBlock* pb = pf != NULL ? find_profile_block(pf, b->hash) : NULL;
+            if (pb == NULL) {
+                stats_add("profile", "blocks not in profile", 1);
+                continue;
+            }
+            stats_add("profile", "blocks matched", 1);
+            b->count = pb->count;
+            b->taken = pb->taken;
+            cost += executions(b) * b->size;
+            if (b->count > max_count) max_count = b->count;
+            for (InterCodes* p = b->body; b->count > 0; p = p->next) {
+                if (p->code.kind == IR_CALL) {
+                    if (nsites == site_capacity) {
+                        site_capacity = site_capacity ? site_capacity * 2 : 64;
+                        sites = (CallSite*)realloc(sites, sizeof(CallSite) * site_capacity);
+                    }
+                    sites[nsites] = (CallSite){ p, b->count, nsites };
+                    nsites++;
+                }
+                if (p == b->last) break;
+            }
+        }
+        if (ncosts == cost_capacity) {
+            cost_capacity = cost_capacity ? cost_capacity * 2 : 64;
+            costs = (FuncCost*)realloc(costs, sizeof(FuncCost) * cost_capacity);
+        }
+        costs[ncosts] = (FuncCost){ func->code.result.symbol, func, NULL, cost, ncosts };
+        ncosts++;
+        if (cost > 0) layout_function(func, next);
+        func = next;
+    }
+
+    if (inline_hot_calls(codes, sites, nsites, max_count) > 0 && options.optimize) {
+        codes = optimize_ir(codes);
+    }
+    qsort(costs, ncosts, sizeof(FuncCost), func_by_symbol);
+    codes = order_functions(codes, costs, ncosts);
+
+    free(costs);
+    free(sites);
+    free_profile();
+    return codes;
+}
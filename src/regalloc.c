@@ -0,0 +1,423 @@
+#include "regalloc.h"
+#include "isel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+const char *ra_reg_names[RA_NUM_REGS] = {
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7"
+};
+
+static bool is_saved_reg(int reg) {
+    return reg >= RA_NUM_TEMP_REGS;
+}
+
+typedef struct {
+    int start, end;     // hull of the positions where the value is live
+    double weight;      // occurrences, weighted by loop depth
+    bool in_memory;     // an array or struct, only its address is taken
+    int reg;
+} Interval;
+
+typedef struct {
+    int from, to;       // positions of the first and last instruction
+    int succ[2], nsucc;
+    uint64_t *use, *def, *live_in, *live_out;
+} Block;
+
+// state of the function allocated last
+static InterCodes **codes;
+static int ncodes;
+static Interval *intervals;
+static int nvregs;
+static uintptr_t *slot_key;     // 0 marks an empty slot
+static int *slot_vreg;
+static int slot_capacity;
+static unsigned saved_used;
+
+// label id -> block, only entries of the current function are meaningful
+static int *label_block;
+static int label_capacity;
+
+static bool operand_key(Operand *opd, uintptr_t *key) {
+    if (opd->kind == OP_TEMP) {
+        *key = ((uintptr_t)opd->u.var_id << 1) | 1;
+        return true;
+    } else if (opd->kind == OP_VARIABLE) {
+        *key = (uintptr_t)opd->symbol;
+        return true;
+    }
+    return false;
+}
+
+static int find_slot(uintptr_t key) {
+    uintptr_t h = (key >> 1) * 2654435761u;
+    int i = (int)(h & (uintptr_t)(slot_capacity - 1));
+    while (slot_key[i] != 0 && slot_key[i] != key) {
+        i = (i + 1) & (slot_capacity - 1);
+    }
+    return i;
+}
+
+// virtual register of opd, created on first sight
+static int vreg_of(Operand *opd) {
+    uintptr_t key;
+    if (!operand_key(opd, &key)) return -1;
+    int i = find_slot(key);
+    if (slot_key[i] == 0) {
+        slot_key[i] = key;
+        slot_vreg[i] = nvregs;
+        Interval *it = &intervals[nvregs++];
+        it->start = INT32_MAX;
+        it->end = -1;
+        it->weight = 0;
+        it->in_memory = false;
+        it->reg = RA_NO_REG;
+    }
+    return slot_vreg[i];
+}
+
+int ra_index(Operand *opd) {
+    uintptr_t key;
+    if (slot_capacity == 0 || !operand_key(opd, &key)) return -1;
+    int i = find_slot(key);
+    return slot_key[i] == 0 ? -1 : slot_vreg[i];
+}
+
+int ra_count() {
+    return nvregs;
+}
+
+int ra_lookup(Operand *opd) {
+    int v = ra_index(opd);
+    return v < 0 ? RA_NO_REG : intervals[v].reg;
+}
+
+unsigned ra_saved_regs_used() {
+    return saved_used;
+}
+
+// operands read by p as far as liveness is concerned
+static int read_operands(InterCodes *p, Operand uses[3]) {
+    switch (p->code.kind) {
+        case IR_PARAM: case IR_READ: case IR_DEC:
+            return 0;
+        default:
+            return isel_uses(p, uses);
+    }
+}
+
+static void extend(Interval *it, int pos) {
+    if (pos < it->start) it->start = pos;
+    if (pos > it->end) it->end = pos;
+}
+
+static bool ends_block(InterCodes *p) {
+    return p->code.kind == IR_GOTO || p->code.kind == IR_RELOP || p->code.kind == IR_RETURN;
+}
+
+static void set_bit(uint64_t *set, int i) {
+    set[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static bool test_bit(uint64_t *set, int i) {
+    return (set[i >> 6] >> (i & 63)) & 1;
+}
+
+static void compute_intervals() {
+    // blocks
+    int nblocks = 0;
+    Block *blocks = (Block*)malloc(sizeof(Block) * (ncodes + 1));
+    for (int i = 0; i < ncodes; i++) {
+        if (i == 0 || codes[i]->code.kind == IR_LABEL || ends_block(codes[i - 1])) {
+            blocks[nblocks].from = i;
+            nblocks++;
+        }
+        blocks[nblocks - 1].to = i;
+        if (codes[i]->code.kind == IR_LABEL) {
+            label_block[codes[i]->code.result.u.label_id] = nblocks - 1;
+        }
+    }
+    for (int b = 0; b < nblocks; b++) {
+        InterCodes *last = codes[blocks[b].to];
+        Block *blk = &blocks[b];
+        blk->nsucc = 0;
+        if (last->code.kind == IR_GOTO || last->code.kind == IR_RELOP) {
+            blk->succ[blk->nsucc++] = label_block[last->code.result.u.label_id];
+        }
+        if (last->code.kind != IR_GOTO && last->code.kind != IR_RETURN && b + 1 < nblocks) {
+            blk->succ[blk->nsucc++] = b + 1;
+        }
+    }
+
+    // liveness
+    int words = (nvregs + 63) / 64;
+    uint64_t *sets = (uint64_t*)calloc((size_t)nblocks * 4 * words + 1, sizeof(uint64_t));
+    for (int b = 0; b < nblocks; b++) {
+        Block *blk = &blocks[b];
+        blk->use = sets + (size_t)b * 4 * words;
+        blk->def = blk->use + words;
+        blk->live_in = blk->def + words;
+        blk->live_out = blk->live_in + words;
+        for (int i = blk->from; i <= blk->to; i++) {
+            Operand uses[3];
+            int n = read_operands(codes[i], uses);
+            for (int k = 0; k < n; k++) {
+                int v = vreg_of(&uses[k]);
+                if (v >= 0 && !test_bit(blk->def, v)) set_bit(blk->use, v);
+            }
+            if (isel_defines(codes[i])) {
+                int v = vreg_of(&codes[i]->code.result);
+                if (v >= 0) set_bit(blk->def, v);
+            }
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = nblocks - 1; b >= 0; b--) {
+            Block *blk = &blocks[b];
+            for (int w = 0; w < words; w++) {
+                uint64_t out = 0;
+                for (int s = 0; s < blk->nsucc; s++) {
+                    out |= blocks[blk->succ[s]].live_in[w];
+                }
+                uint64_t in = blk->use[w] | (out & ~blk->def[w]);
+                if (out != blk->live_out[w] || in != blk->live_in[w]) {
+                    blk->live_out[w] = out;
+                    blk->live_in[w] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // loop depth from backward jumps, as a difference array
+    int *depth = (int*)calloc(ncodes + 1, sizeof(int));
+    for (int i = 0; i < ncodes; i++) {
+        InterCodes *p = codes[i];
+        if (p->code.kind != IR_GOTO && p->code.kind != IR_RELOP) continue;
+        int head = blocks[label_block[p->code.result.u.label_id]].from;
+        if (head <= i) {
+            depth[head]++;
+            depth[i + 1]--;
+        }
+    }
+
+    // hull of every value: its occurrences and the block boundaries it is live across
+    int d = 0;
+    for (int b = 0; b < nblocks; b++) {
+        Block *blk = &blocks[b];
+        for (int i = blk->from; i <= blk->to; i++) {
+            d += depth[i];
+            double w = 1;
+            for (int k = 0; k < d && k < 5; k++) w *= 10;
+            Operand uses[3];
+            int n = read_operands(codes[i], uses);
+            for (int k = 0; k < n; k++) {
+                int v = vreg_of(&uses[k]);
+                if (v < 0) continue;
+                extend(&intervals[v], i);
+                intervals[v].weight += w;
+            }
+            if (isel_defines(codes[i])) {
+                int v = vreg_of(&codes[i]->code.result);
+                if (v >= 0) {
+                    extend(&intervals[v], i);
+                    intervals[v].weight += w;
+                }
+            }
+        }
+        for (int w = 0; w < words; w++) {
+            for (uint64_t bits = blk->live_in[w]; bits != 0; bits &= bits - 1) {
+                extend(&intervals[w * 64 + __builtin_ctzll(bits)], blk->from);
+            }
+            for (uint64_t bits = blk->live_out[w]; bits != 0; bits &= bits - 1) {
+                extend(&intervals[w * 64 + __builtin_ctzll(bits)], blk->to);
+            }
+        }
+    }
+
+    free(depth);
+    free(sets);
+    free(blocks);
+}
+
+static int by_start(const void *a, const void *b) {
+    const Interval *x = &intervals[*(const int*)a], *y = &intervals[*(const int*)b];
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+// lower is a better spill candidate: few weighted uses over a long range
+static double spill_priority(Interval *it) {
+    return it->weight / (it->end - it->start + 1);
+}
+
+static void linear_scan() {
+    // number of calls before each position; $t registers do not survive a call
+    int *calls = (int*)calloc(ncodes + 1, sizeof(int));
+    for (int i = 0; i < ncodes; i++) {
+        calls[i + 1] = calls[i] + (codes[i]->code.kind == IR_CALL);
+    }
+
+    int *order = (int*)malloc(sizeof(int) * (nvregs + 1));
+    int norder = 0;
+    for (int v = 0; v < nvregs; v++) {
+        if (!intervals[v].in_memory && intervals[v].end >= 0) order[norder++] = v;
+    }
+    qsort(order, norder, sizeof(int), by_start);
+
+    int active[RA_NUM_REGS], nactive = 0;     // sorted by end
+    bool reg_free[RA_NUM_REGS];
+    for (int r = 0; r < RA_NUM_REGS; r++) reg_free[r] = true;
+
+    for (int k = 0; k < norder; k++) {
+        Interval *cur = &intervals[order[k]];
+        // a value defined by a call and one dying at its ARGs do not cross it
+        bool crosses_call = calls[cur->end] - calls[cur->start + 1] > 0;
+
+        int expired = 0;
+        while (expired < nactive && intervals[active[expired]].end < cur->start) {
+            reg_free[intervals[active[expired]].reg] = true;
+            expired++;
+        }
+        memmove(active, active + expired, sizeof(int) * (nactive - expired));
+        nactive -= expired;
+
+        int reg = RA_NO_REG;
+        for (int r = crosses_call ? RA_NUM_TEMP_REGS : 0; r < RA_NUM_REGS && reg == RA_NO_REG; r++) {
+            if (reg_free[r]) reg = r;
+        }
+        if (reg == RA_NO_REG) {
+            // take the register of the cheapest active value, if cheaper than cur
+            int victim = -1;
+            double best = spill_priority(cur);
+            for (int a = 0; a < nactive; a++) {
+                Interval *it = &intervals[active[a]];
+                if (crosses_call && !is_saved_reg(it->reg)) continue;
+                if (spill_priority(it) < best) {
+                    best = spill_priority(it);
+                    victim = a;
+                }
+            }
+            if (victim < 0) continue;
+            reg = intervals[active[victim]].reg;
+            intervals[active[victim]].reg = RA_NO_REG;
+            memmove(active + victim, active + victim + 1, sizeof(int) * (nactive - victim - 1));
+            nactive--;
+        }
+
+        cur->reg = reg;
+        reg_free[reg] = false;
+        if (is_saved_reg(reg)) saved_used |= 1u << (reg - RA_NUM_TEMP_REGS);
+        int pos = nactive;
+        while (pos > 0 && intervals[active[pos - 1]].end > cur->end) {
+            active[pos] = active[pos - 1];
+            pos--;
+        }
+        active[pos] = order[k];
+        nactive++;
+    }
+
+    free(order);
+    free(calls);
+}
+
+void ra_allocate(InterCodes *func, bool allocate) {
+    assert(func->code.kind == IR_FUNC);
+    free(codes);
+    free(intervals);
+    free(slot_key);
+    free(slot_vreg);
+    saved_used = 0;
+
+    ncodes = 0;
+    for (InterCodes *p = func->next; p != NULL && p->code.kind != IR_FUNC; p = p->next) {
+        ncodes++;
+    }
+    codes = (InterCodes**)malloc(sizeof(InterCodes*) * (ncodes + 1));
+    ncodes = 0;
+    for (InterCodes *p = func->next; p != NULL && p->code.kind != IR_FUNC; p = p->next) {
+        codes[ncodes++] = p;
+        if (p->code.kind == IR_LABEL && p->code.result.u.label_id >= label_capacity) {
+            label_capacity = p->code.result.u.label_id * 2 + 1;
+            label_block = (int*)realloc(label_block, sizeof(int) * label_capacity);
+        }
+    }
+
+    // every instruction has at most three operands
+    slot_capacity = 16;
+    while (slot_capacity < ncodes * 6 + 2) slot_capacity *= 2;
+    slot_key = (uintptr_t*)calloc(slot_capacity, sizeof(uintptr_t));
+    slot_vreg = (int*)malloc(sizeof(int) * slot_capacity);
+    intervals = (Interval*)malloc(sizeof(Interval) * (ncodes * 3 + 1));
+    nvregs = 0;
+
+    for (int i = 0; i < ncodes; i++) {
+        InterCodes *p = codes[i];
+        Operand uses[3];
+        int n = read_operands(p, uses);
+        for (int k = 0; k < n; k++) vreg_of(&uses[k]);
+        if (isel_defines(p)) vreg_of(&p->code.result);
+        if (p->code.kind == IR_DEC) {
+            intervals[vreg_of(&p->code.result)].in_memory = true;
+        } else if (p->code.kind == IR_ADDR) {
+            int v = vreg_of(&p->code.arg1);
+            if (v >= 0) intervals[v].in_memory = true;
+        }
+    }
+
+    if (ncodes > 0) {
+        compute_intervals();
+        if (allocate) linear_scan();
+    }
+}
+
+int ra_share_slots(const bool *want, int *slot) {
+    int *order = (int*)malloc(sizeof(int) * (nvregs + 1));
+    int norder = 0, nslots = 0;
+    for (int v = 0; v < nvregs; v++) {
+        slot[v] = -1;
+        if (!want[v]) continue;
+        if (intervals[v].in_memory) {
+            // its address may be used anywhere, so it keeps a slot of its own
+            slot[v] = nslots++;
+        } else {
+            order[norder++] = v;
+        }
+    }
+    qsort(order, norder, sizeof(int), by_start);
+
+    // the same scan as for registers, but there are always more slots
+    int *active = (int*)malloc(sizeof(int) * (norder + 1));   // sorted by end
+    int *free_slots = (int*)malloc(sizeof(int) * (norder + 1));
+    int nactive = 0, nfree = 0;
+    for (int k = 0; k < norder; k++) {
+        Interval *cur = &intervals[order[k]];
+        int expired = 0;
+        while (expired < nactive && intervals[active[expired]].end < cur->start) {
+            free_slots[nfree++] = slot[active[expired]];
+            expired++;
+        }
+        memmove(active, active + expired, sizeof(int) * (nactive - expired));
+        nactive -= expired;
+
+        slot[order[k]] = nfree > 0 ? free_slots[--nfree] : nslots++;
+        int pos = nactive;
+        while (pos > 0 && intervals[active[pos - 1]].end > cur->end) {
+            active[pos] = active[pos - 1];
+            pos--;
+        }
+        active[pos] = order[k];
+        nactive++;
+    }
+
+    free(free_slots);
+    free(active);
+    free(order);
+    return nslots;
+}
@@ -0,0 +1,97 @@
+// Runs a program in the IR format printed by gen_ir, without the GUI of
+// ir-simulator/irsim.py. READ takes integers from the input file or stdin,
+// WRITE prints one integer per line, and the number of executed
+// instructions is reported on stderr.
+//
+// usage: run_ir [-i input-file] [-q] [-L] [-p profile-file] [-P block-count-file] path-to-ir-file
+//   -L  the instructions executed for each source line, for IR from gen_ir -g
+//   -p  write the profile (functions, call graph, hot blocks and the
+//       annotated IR) to profile-file
+//   -P  write the executions of each basic block, for IR from
+//       gen_ir -fprofile-generate, to block-count-file for -fprofile-use
+#include <stdio.h>
+#include <string.h>
+#include "interp.h"
+
+// basic blocks in the profile
+#define PROFILE_BLOCKS 20
+
+static char out_buf[1 << 16];
+
+int main(int argc, char **argv) {
+    const char *ir_path = NULL, *input_path = NULL, *profile_path = NULL, *block_count_path = NULL;
+    bool quiet = false, lines = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            lines = true;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            block_count_path = argv[++i];
+        } else if (argv[i][0] != '-' && ir_path == NULL) {
+            ir_path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [-i input-file] [-q] [-L] [-p profile-file] [-P block-count-file] path-to-ir-file\n", argv[0]);
+            return 1;
+        }
+    }
+    if (ir_path == NULL) {
+        fprintf(stderr, "usage: %s [-i input-file] [-q] [-L] [-p profile-file] [-P block-count-file] path-to-ir-file\n", argv[0]);
+        return 1;
+    }
+
+    FILE *fin = fopen(ir_path, "r");
+    if (!fin) {
+        perror(ir_path);
+        return 1;
+    }
+    IrProgram *prog = interp_load(fin, ir_path);
+    fclose(fin);
+    if (prog == NULL) return 1;
+
+    FILE *input = stdin;
+    if (input_path != NULL && (input = fopen(input_path, "r")) == NULL) {
+        perror(input_path);
+        interp_free(prog);
+        return 1;
+    }
+
+    if (lines || profile_path != NULL || block_count_path != NULL) interp_profile(prog);
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+    InterpStats stats;
+    int status = interp_run(prog, input, stdout, &stats);
+    fflush(stdout);
+    if (!quiet) {
+        fprintf(stderr, "instructions: %lld, loads: %lld, stores: %lld, calls: %lld, max call depth: %d\n",
+            stats.instructions, stats.loads, stats.stores, stats.calls, stats.max_depth);
+    }
+    if (lines) interp_report_lines(prog, stderr);
+    if (profile_path != NULL) {
+        FILE *profile = fopen(profile_path, "w");
+        if (profile == NULL) {
+            perror(profile_path);
+            status = 1;
+        } else {
+            interp_report_profile(prog, profile, PROFILE_BLOCKS);
+            fclose(profile);
+        }
+    }
+    if (block_count_path != NULL) {
+        FILE *block_counts = fopen(block_count_path, "w");
+        if (block_counts == NULL) {
+            perror(block_count_path);
+            status = 1;
+        } else {
+            interp_write_block_counts(prog, block_counts);
+            fclose(block_counts);
+        }
+    }
+
+    if (input != stdin) fclose(input);
+    interp_free(prog);
+    return status;
+}
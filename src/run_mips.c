@@ -0,0 +1,81 @@
+// Runs the MIPS assembly printed by gen_oc without SPIM or MARS and reports
+// dynamic instruction counts by class and a cycle estimate on stderr.
+// syscall 5 takes integers from the input file or stdin.
+//
+// usage: run_mips [-i input-file] [-q] [-n] [-L] [-l max-steps] path-to-asm-file
+//   -q  no statistics
+//   -L  the instructions and cycles of each source line, for gen_oc -g output
+//   -n  do not print the strings of syscall 4 (prompt and newlines), only
+//       the integers, one per line, as run_ir prints them
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mipssim.h"
+
+static char out_buf[1 << 16];
+
+static int usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-i input-file] [-q] [-n] [-L] [-l max-steps] path-to-asm-file\n", prog);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *asm_path = NULL, *input_path = NULL;
+    bool quiet = false;
+    MipsSimOptions options = { .print_strings = true, .max_steps = 0, .profile = false };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            options.max_steps = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            options.print_strings = false;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            options.profile = true;
+        } else if (argv[i][0] != '-' && asm_path == NULL) {
+            asm_path = argv[i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (asm_path == NULL) return usage(argv[0]);
+
+    FILE *fin = fopen(asm_path, "r");
+    if (!fin) {
+        perror(asm_path);
+        return 1;
+    }
+    MipsProgram *prog = mipssim_load(fin, asm_path);
+    fclose(fin);
+    if (prog == NULL) return 1;
+
+    FILE *input = stdin;
+    if (input_path != NULL && (input = fopen(input_path, "r")) == NULL) {
+        perror(input_path);
+        mipssim_free(prog);
+        return 1;
+    }
+
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+    MipsSimStats stats;
+    int status = mipssim_run(prog, input, stdout, &options, &stats);
+    fflush(stdout);
+    if (!quiet) {
+        fprintf(stderr, "instructions: %lld (", stats.instructions);
+        for (int c = 0; c < MC_NUM; c++) {
+            fprintf(stderr, "%s%s %lld", c > 0 ? ", " : "", mipssim_class_names[c], stats.by_class[c]);
+        }
+        fprintf(stderr, "), taken branches: %lld\n", stats.taken_branches);
+        fprintf(stderr, "loads: %lld, stores: %lld, calls: %lld\n",
+            stats.by_class[MC_LOAD], stats.by_class[MC_STORE], stats.calls);
+        fprintf(stderr, "cycles: %lld (stalls %lld, branch bubbles %lld)\n",
+            stats.cycles, stats.stalls, stats.bubbles);
+    }
+    if (options.profile) mipssim_report_lines(prog, stderr);
+
+    if (input != stdin) fclose(input);
+    mipssim_free(prog);
+    return status;
+}
@@ -0,0 +1,172 @@
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+
+// longer straight-line runs are scheduled in pieces of this size
+#define SCHED_MAX_REGION 64
+// how far before a branch an instruction for its delay slot is looked for
+#define SCHED_MAX_SLOT_DISTANCE 6
+
+static bool is_memory(MipsIns *ins) {
+    return ins->op == MI_LW || ins->op == MI_SW;
+}
+
+static bool writes_hilo(MipsIns *ins) {
+    return ins->op == MI_MULT || ins->op == MI_DIV;
+}
+
+static bool reads_hilo(MipsIns *ins) {
+    return ins->op == MI_MFHI || ins->op == MI_MFLO;
+}
+
+// cycles b must issue after a when b comes after a in the program, or -1
+// when they are independent
+static int dependence(MipsIns *a, MipsIns *b) {
+    unsigned da = mips_defs(a), ua = mips_uses(a), db = mips_defs(b), ub = mips_uses(b);
+    if (da & ub) return mips_ops[a->op].latency;
+    if (writes_hilo(a) && reads_hilo(b)) return mips_ops[a->op].latency;
+    if ((ua & db) || (da & db)) return 1;
+    if ((reads_hilo(a) || writes_hilo(a)) && writes_hilo(b)) return 1;
+    // the frame and the stack arguments may alias anything a pointer reaches
+    if (is_memory(a) && is_memory(b) && (a->op == MI_SW || b->op == MI_SW)) return 1;
+    // nothing in the frame may be accessed while it is below $sp
+    if ((is_memory(a) && (db & (1u << MR_SP))) || ((da & (1u << MR_SP)) && is_memory(b))) return 1;
+    return -1;
+}
+
+static void schedule_region(MipsIns **ins, int n) {
+    static int lat[SCHED_MAX_REGION][SCHED_MAX_REGION];
+    int height[SCHED_MAX_REGION], npred[SCHED_MAX_REGION], earliest[SCHED_MAX_REGION];
+    bool done[SCHED_MAX_REGION];
+    for (int i = n - 1; i >= 0; i--) {
+        height[i] = mips_ops[ins[i]->op].latency;
+        npred[i] = 0;
+        earliest[i] = 0;
+        done[i] = false;
+        for (int j = i + 1; j < n; j++) {
+            lat[i][j] = dependence(ins[i], ins[j]);
+            if (lat[i][j] >= 0 && lat[i][j] + height[j] > height[i]) height[i] = lat[i][j] + height[j];
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            if (lat[i][j] >= 0) npred[j]++;
+        }
+    }
+
+    MipsIns *order[SCHED_MAX_REGION];
+    int cycle = 0;
+    for (int k = 0; k < n; k++) {
+        // the ready instruction on the longest path, preferring one that
+        // does not stall and then program order
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            if (done[i] || npred[i] > 0) continue;
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+            bool stalls = earliest[i] > cycle, best_stalls = earliest[best] > cycle;
+            if (stalls != best_stalls) {
+                if (!stalls) best = i;
+            } else if (stalls ? earliest[i] < earliest[best] : height[i] > height[best]) {
+                best = i;
+            }
+        }
+        if (earliest[best] > cycle) cycle = earliest[best];
+        done[best] = true;
+        order[k] = ins[best];
+        for (int j = best + 1; j < n; j++) {
+            if (lat[best][j] < 0) continue;
+            npred[j]--;
+            if (cycle + lat[best][j] > earliest[j]) earliest[j] = cycle + lat[best][j];
+        }
+        cycle++;
+    }
+
+    // relink in the new order between the neighbours of the region
+    MipsIns *before = ins[0]->prev;
+    for (int i = 0; i < n; i++) mips_unlink(ins[i]);
+    for (int k = 0; k < n; k++) {
+        mips_insert_after(before, order[k]);
+        before = order[k];
+    }
+}
+
+void mips_schedule() {
+    MipsIns *region[SCHED_MAX_REGION];
+    int n = 0;
+    MipsIns *p = mips_first();
+    while (p != NULL) {
+        MipsIns *next = p->next;
+        if (!mips_is_boundary(p) && p->op != MI_NOP) {
+            region[n++] = p;
+        }
+        if (mips_is_boundary(p) || p->op == MI_NOP || next == NULL || n == SCHED_MAX_REGION) {
+            if (n > 1) schedule_region(region, n);
+            n = 0;
+        }
+        p = next;
+    }
+}
+
+// whether the assembler turns ins into a single machine instruction; la,
+// and li or an immediate that does not fit in 16 bits, become two or more,
+// of which only the first would run in a delay slot
+static bool is_single_word(MipsIns *ins) {
+    switch (ins->op) {
+        case MI_LA: return false;
+        case MI_LI: return ins->imm >= -32768 && ins->imm <= 65535;
+        case MI_XORI: return ins->imm >= 0 && ins->imm <= 65535;
+        case MI_SLL: case MI_SRA: case MI_SRL: return true;
+        default: break;
+    }
+    if (mips_ops[ins->op].format == MF_RRI || mips_ops[ins->op].format == MF_MEM) {
+        return ins->imm >= -32768 && ins->imm <= 32767;
+    }
+    return true;
+}
+
+// x may execute right after the branch or jump j instead of before it
+static bool fits_delay_slot(MipsIns *x, MipsIns *j) {
+    if (mips_is_boundary(x) || x->op == MI_NOP || !is_single_word(x)) return false;
+    // the jump reads its register operands before the slot executes; what it
+    // reads implicitly (arguments, the return value) is only read after it
+    unsigned reads = 0;
+    for (int i = 0; i < 3; i++) {
+        if (mips_ops[j->op].uses & (1u << i)) reads |= 1u << j->r[i];
+    }
+    unsigned defs = mips_defs(x);
+    if (defs & reads) return false;
+    if (j->op == MI_JAL && ((defs | mips_uses(x)) & (1u << MR_RA))) return false;
+    return true;
+}
+
+void mips_fill_delay_slots() {
+    for (MipsIns *j = mips_first(); j != NULL; j = j->next) {
+        if (!mips_has_delay_slot(j)) continue;
+        MipsIns *slot = NULL;
+        MipsIns *x = j->prev;
+        for (int k = 0; x != NULL && k < SCHED_MAX_SLOT_DISTANCE && !mips_is_boundary(x);
+            x = x->prev, k++) {
+            // already in the delay slot of the jump before it
+            if (x->prev != NULL && mips_has_delay_slot(x->prev)) break;
+            if (!fits_delay_slot(x, j)) continue;
+            bool movable = true;
+            for (MipsIns *y = x->next; y != j && movable; y = y->next) {
+                movable = dependence(x, y) < 0;
+            }
+            if (movable) {
+                slot = x;
+                break;
+            }
+        }
+        if (slot != NULL) {
+            mips_unlink(slot);
+        } else {
+            slot = mips_new(MI_NOP, 0, 0, 0, 0, NULL);
+        }
+        mips_insert_after(j, slot);
+        j = slot;
+    }
+}
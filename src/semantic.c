@@ -6,6 +6,7 @@
 #include "debug.h"
 #include "common.h"
 #include "sym_table.h"
+#include "memstat.h"
 
 Symbol cur_func = NULL;
 int struct_env_dep = 0;
@@ -25,7 +26,7 @@ Type getType(ASTNode *specifier) {
         }
     }
     else {
-        type = (Type)malloc(sizeof(struct Type_));
+        type = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
         type->kind = BASIC;
         char *typename = specifier->child->val.c;
         if (strcmp(typename, "int") == 0) type->u.basic = TYPE_INT;
@@ -38,14 +39,14 @@ Type getType(ASTNode *specifier) {
 }
 
 Type buildStructType(ASTNode *structSpecifier) {
-    Type type = (Type)malloc(sizeof(struct Type_));
+    Type type = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
     type->kind = STRUCTURE;
     type->u.structure = NULL;
     ASTNode *optTag = structSpecifier->child->sibling;
     ASTNode *defList = optTag->sibling->sibling;
     type->u.structure = buildFields(type->u.structure, defList);
     if (optTag->subtype != EMPTY) {
-        Symbol sym = (Symbol)malloc(sizeof(struct SymbolList_));
+        Symbol sym = (Symbol)mem_alloc(MEM_SYMBOL, sizeof(struct SymbolList_));
         sym->kind = STRUCT_DEF;
         strcpy(sym->name, optTag->child->val.c);
         sym->u.type = type;
@@ -67,7 +68,7 @@ FieldList buildFields(FieldList structure, ASTNode *defList) {
         if (dec->subtype == INITIALIZE) {
             reportError("15", dec->lineno, "Attemp to initialize field \"%s\"", sym->name);
         }
-        Field field = (Field)malloc(sizeof(struct FieldList_));
+        Field field = (Field)mem_alloc(MEM_TYPE, sizeof(struct FieldList_));
         strcpy(field->name, sym->name);
         field->type = sym->u.type;
         if (structure == NULL) {
@@ -147,7 +148,7 @@ void parseFunDec(Type type, ASTNode *funDec) {
 }
 
 Symbol getSym4VarDec(Type type, ASTNode *varDec) {
-    Symbol sym = (Symbol)malloc(sizeof(struct SymbolList_));
+    Symbol sym = (Symbol)mem_alloc(MEM_SYMBOL, sizeof(struct SymbolList_));
     if (varDec->subtype == TYPE_ARRAY) {
         sym = getSym4VarDecArr(type, varDec->child, varDec->child->sibling->sibling->val.i);
     }
@@ -160,16 +161,16 @@ Symbol getSym4VarDec(Type type, ASTNode *varDec) {
 }
 
 Symbol getSym4VarDecArr(Type type, ASTNode *varDec, int size) {
-    Symbol sym = (Symbol)malloc(sizeof(struct SymbolList_));
+    Symbol sym = (Symbol)mem_alloc(MEM_SYMBOL, sizeof(struct SymbolList_));
     if (varDec->subtype == TYPE_ARRAY) {
-        Type arr = (Type)malloc(sizeof(struct Type_));
+        Type arr = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
         arr->kind = ARRAY;
         arr->u.array.elem = type;
         arr->u.array.size = size;
         sym = getSym4VarDecArr(arr, varDec->child, varDec->child->sibling->sibling->val.i);
     }
     else {
-        Type arr = (Type)malloc(sizeof(struct Type_));
+        Type arr = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
         arr->kind = ARRAY;
         arr->u.array.elem = type;
         arr->u.array.size = size;
@@ -181,10 +182,10 @@ Symbol getSym4VarDecArr(Type type, ASTNode *varDec, int size) {
 }
 
 Symbol getSym4FunDec(Type type, ASTNode *funDec) {
-    Symbol sym = (Symbol)malloc(sizeof(struct SymbolList_));
+    Symbol sym = (Symbol)mem_alloc(MEM_SYMBOL, sizeof(struct SymbolList_));
     sym->kind = FUNC_DEF;
     strcpy(sym->name, funDec->child->val.c);
-    sym->u.func = (Func)malloc(sizeof(struct Func_));
+    sym->u.func = (Func)mem_alloc(MEM_SYMBOL, sizeof(struct Func_));
     sym->u.func->retType = type;
     sym->u.func->argList = NULL;
     sym->u.func->lineno = funDec->lineno;
@@ -205,7 +206,7 @@ FieldList buildArgs(FieldList argList, ASTNode *varList, bool addToSymbolTabel)
     ASTNode *paramDec = varList->child;
     Type type = getType(paramDec->child);
     Symbol sym = getSym4VarDec(type, paramDec->child->sibling);
-    Field field = (Field)malloc(sizeof(struct FieldList_));
+    Field field = (Field)mem_alloc(MEM_TYPE, sizeof(struct FieldList_));
     strcpy(field->name, sym->name);
     field->type = sym->u.type;
     if (argList == NULL) {
@@ -389,7 +390,7 @@ Type checkExpType(ASTNode *exp) {
                             type = NULL;
                         }
                         else {
-                            type = (Type)malloc(sizeof(struct Type_));
+                            type = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
                             type->kind = BASIC;
                             type->u.basic = TYPE_INT;
                         }
@@ -434,12 +435,12 @@ Type checkExpType(ASTNode *exp) {
             }
         }   break;
         case AST_INT: {
-            type = (Type)malloc(sizeof(struct Type_));
+            type = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
             type->kind = BASIC;
             type->u.basic = TYPE_INT;
         }   break;
         case AST_FLOAT: {
-            type = (Type)malloc(sizeof(struct Type_));
+            type = (Type)mem_alloc(MEM_TYPE, sizeof(struct Type_));
             type->kind = BASIC;
             type->u.basic = TYPE_FLOAT;
         }   break;
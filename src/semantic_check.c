@@ -3,6 +3,9 @@
 #include "debug.h"
 #include "semantic.h"
 #include "sym_table.h"
+#include "options.h"
+#include "timer.h"
+#include "memstat.h"
 
 #ifdef YYDEBUG
 extern int yydebug;
@@ -17,8 +20,13 @@ extern int cnt_error;
 
 int main(int argc, char **argv)
 {
+    argc = parse_options(argc, argv);
     if (argc <= 1)
         return 1;
+    if (options.time_report || options.time_report_json)
+        timer_start();
+    if (options.mem_report || options.mem_budget > 0)
+        mem_start(options.mem_budget);
 
     FILE *f = fopen(argv[1], "r");
     if (!f) {
@@ -32,7 +40,10 @@ int main(int argc, char **argv)
     yydebug = 1;
 #endif
 
+    timer_begin("parse");
     yyparse();
+    timer_end();
+    mem_checkpoint("parse");
 
 #ifdef PRINT_AST
     if (cnt_error == 0) {
@@ -47,11 +58,23 @@ int main(int argc, char **argv)
 
     initSymbolTabel();
 
+    timer_begin("semantic");
     semantic_parse(ASTroot);
+    timer_end();
+    mem_checkpoint("semantic");
 
     freeAST(ASTroot);
+    mem_checkpoint("free AST");
 
     fclose(f);
 
+    if (options.time_report)
+        timer_report(stderr);
+    if (options.time_report_json)
+        timer_report_json(stderr);
+    if (options.mem_report)
+        mem_report(stderr);
+    if (mem_over_budget(stderr))
+        return 1;
     return 0;
 }
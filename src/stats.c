@@ -0,0 +1,209 @@
+#include "stats.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    long long before, after, delta;
+    bool seen;
+} FuncCount;
+
+typedef struct {
+    const char *name;
+    const char *counters[STATS_MAX_COUNTERS];
+    long long values[STATS_MAX_COUNTERS];
+    int ncounters;
+    long long runs;             // stats_ir_after calls
+    FuncCount *funcs;           // indexed like func_names, NULL without stats_ir_*
+    int nfuncs;
+} Pass;
+
+static bool started;
+static bool overflow;
+static Pass passes[STATS_MAX_PASSES];
+static int npasses;
+
+// functions in the order they were first seen, with a hash from their
+// symbol to the index
+static const char **func_names;
+static Symbol *func_symbols;
+static int nfuncs, func_capacity;
+static int *func_hash;          // index + 1, 0: empty
+static int hash_size;
+
+// instruction counts of the last stats_ir_before
+static long long *pending;
+static int npending;
+
+static uint32_t hash_symbol(Symbol s) {
+    uintptr_t v = (uintptr_t)s;
+    return (uint32_t)((v >> 4) * 2654435761u);
+}
+
+static void rehash() {
+    free(func_hash);
+    hash_size = hash_size == 0 ? 64 : hash_size * 2;
+    func_hash = (int*)calloc(hash_size, sizeof(int));
+    for (int i = 0; i < nfuncs; i++) {
+        uint32_t h = hash_symbol(func_symbols[i]) & (hash_size - 1);
+        while (func_hash[h] != 0) h = (h + 1) & (hash_size - 1);
+        func_hash[h] = i + 1;
+    }
+}
+
+static int func_index(Symbol s) {
+    if (2 * (nfuncs + 1) > hash_size) rehash();
+    uint32_t h = hash_symbol(s) & (hash_size - 1);
+    while (func_hash[h] != 0) {
+        if (func_symbols[func_hash[h] - 1] == s) return func_hash[h] - 1;
+        h = (h + 1) & (hash_size - 1);
+    }
+    if (nfuncs == func_capacity) {
+        func_capacity = func_capacity == 0 ? 64 : func_capacity * 2;
+        func_names = (const char**)realloc(func_names, sizeof(const char*) * func_capacity);
+        func_symbols = (Symbol*)realloc(func_symbols, sizeof(Symbol) * func_capacity);
+    }
+    func_names[nfuncs] = s->name;
+    func_symbols[nfuncs] = s;
+    func_hash[h] = nfuncs + 1;
+    return nfuncs++;
+}
+
+static Pass* find_pass(const char *name) {
+    for (int i = 0; i < npasses; i++) {
+        if (strcmp(passes[i].name, name) == 0) return &passes[i];
+    }
+    if (npasses == STATS_MAX_PASSES) {
+        overflow = true;
+        return NULL;
+    }
+    passes[npasses].name = name;
+    return &passes[npasses++];
+}
+
+// instructions after each FUNCTION line up to the next one; the counts of
+// functions that are no longer in codes are 0
+static long long* count_functions(InterCodes *codes) {
+    int cur = -1;
+    for (InterCodes *p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_FUNC) func_index(p->code.result.symbol);
+    }
+    long long *counts = (long long*)calloc(nfuncs + 1, sizeof(long long));
+    for (InterCodes *p = codes; p != NULL; p = p->next) {
+        if (p->code.kind == IR_FUNC) {
+            cur = func_index(p->code.result.symbol);
+        } else if (cur >= 0) {
+            counts[cur]++;
+        }
+    }
+    return counts;
+}
+
+void stats_start() {
+    started = true;
+}
+
+void stats_add(const char *pass, const char *counter, long long n) {
+    if (!started) return;
+    Pass *p = find_pass(pass);
+    if (p == NULL) return;
+    int i = 0;
+    while (i < p->ncounters && strcmp(p->counters[i], counter) != 0) i++;
+    if (i == p->ncounters) {
+        if (i == STATS_MAX_COUNTERS) {
+            overflow = true;
+            return;
+        }
+        p->counters[p->ncounters++] = counter;
+    }
+    p->values[i] += n;
+}
+
+void stats_ir_before(InterCodes *codes) {
+    if (!started) return;
+    free(pending);
+    pending = count_functions(codes);
+    npending = nfuncs;
+}
+
+void stats_ir_after(const char *pass, InterCodes *codes) {
+    if (!started) return;
+    Pass *p = find_pass(pass);
+    if (p == NULL) return;
+    long long *counts = count_functions(codes);
+    if (p->nfuncs < nfuncs) {
+        p->funcs = (FuncCount*)realloc(p->funcs, sizeof(FuncCount) * nfuncs);
+        memset(p->funcs + p->nfuncs, 0, sizeof(FuncCount) * (nfuncs - p->nfuncs));
+        p->nfuncs = nfuncs;
+    }
+    for (int i = 0; i < nfuncs; i++) {
+        long long before = i < npending ? pending[i] : 0;
+        FuncCount *f = &p->funcs[i];
+        if (!f->seen) {
+            f->seen = true;
+            f->before = before;
+        }
+        f->after = counts[i];
+        f->delta += counts[i] - before;
+    }
+    p->runs++;
+    free(counts);
+}
+
+static void totals(Pass *p, long long *before, long long *after, long long *delta) {
+    *before = *after = *delta = 0;
+    for (int i = 0; i < p->nfuncs; i++) {
+        *before += p->funcs[i].before;
+        *after += p->funcs[i].after;
+        *delta += p->funcs[i].delta;
+    }
+}
+
+void stats_report(FILE *out) {
+    if (!started) return;
+    fprintf(out, "%-20s %-30s %12s\n", "pass", "counter", "value");
+    for (int i = 0; i < npasses; i++) {
+        Pass *p = &passes[i];
+        for (int c = 0; c < p->ncounters; c++) {
+            fprintf(out, "%-20s %-30s %12lld\n", p->name, p->counters[c], p->values[c]);
+        }
+    }
+    fprintf(out, "\n%-20s %8s %12s %12s %12s\n", "IR instructions", "runs", "before", "after", "by the pass");
+    for (int i = 0; i < npasses; i++) {
+        Pass *p = &passes[i];
+        if (p->runs == 0) continue;
+        long long before, after, delta;
+        totals(p, &before, &after, &delta);
+        fprintf(out, "%-20s %8lld %12lld %12lld %+12lld\n", p->name, p->runs, before, after, delta);
+    }
+    if (overflow) fprintf(out, "(too many passes or counters, some were not recorded)\n");
+}
+
+void stats_report_json(FILE *out) {
+    if (!started) return;
+    fprintf(out, "{\"passes\": [");
+    for (int i = 0; i < npasses; i++) {
+        Pass *p = &passes[i];
+        // pass, counter and function names are identifiers or fixed strings, no escaping needed
+        fprintf(out, "%s\n  {\"name\": \"%s\", \"counters\": {", i > 0 ? "," : "", p->name);
+        for (int c = 0; c < p->ncounters; c++) {
+            fprintf(out, "%s\"%s\": %lld", c > 0 ? ", " : "", p->counters[c], p->values[c]);
+        }
+        fprintf(out, "}");
+        if (p->runs > 0) {
+            long long before, after, delta;
+            totals(p, &before, &after, &delta);
+            fprintf(out, ", \"runs\": %lld, \"instructions\": {\"before\": %lld, \"after\": %lld, \"delta\": %lld}",
+                p->runs, before, after, delta);
+            fprintf(out, ", \"functions\": [");
+            for (int f = 0; f < p->nfuncs; f++) {
+                FuncCount *fc = &p->funcs[f];
+                fprintf(out, "%s\n    {\"name\": \"%s\", \"before\": %lld, \"after\": %lld, \"delta\": %lld}",
+                    f > 0 ? "," : "", func_names[f], fc->before, fc->after, fc->delta);
+            }
+            fprintf(out, "]");
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]}\n");
+}
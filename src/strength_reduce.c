@@ -0,0 +1,223 @@
+#include <stdint.h>
+#include <assert.h>
+#include "strength_reduce.h"
+
+static void sr_emit(SRSeq *seq, int op, enum SR_REG rd, enum SR_REG rs, enum SR_REG rt, int imm) {
+    assert(seq->len < SR_MAX_INS);
+    SRIns *ins = &seq->ins[seq->len++];
+    ins->op = op;
+    ins->rd = rd;
+    ins->rs = rs;
+    ins->rt = rt;
+    ins->imm = imm;
+    switch (op) {
+        case SR_LI: seq->cost += SR_COST_LI; break;
+        case SR_MULT_HI: seq->cost += SR_COST_MULT_HI; break;
+        default: seq->cost += SR_COST_ALU; break;
+    }
+}
+
+static void sr_init(SRSeq *seq) {
+    seq->len = 0;
+    seq->cost = 0;
+}
+
+static bool fits_imm16(int c) {
+    return c >= -32768 && c <= 32767;
+}
+
+// canonical signed digit form of |c|: at most one of every two adjacent
+// digits is non-zero, which minimizes the number of add/sub terms
+static int csd_digits(int64_t c, int shifts[33], int signs[33]) {
+    int n = 0;
+    int sign = c < 0 ? -1 : 1;
+    uint64_t v = c < 0 ? (uint64_t)(-c) : (uint64_t)c;
+    for (int k = 0; v != 0; k++, v >>= 1) {
+        if ((v & 1) == 0) continue;
+        if ((v & 3) == 3) {     // ...0111 -> ...100(-1)
+            shifts[n] = k;
+            signs[n++] = -sign;
+            v += 1;
+        } else {
+            shifts[n] = k;
+            signs[n++] = sign;
+            v -= 1;
+        }
+    }
+    return n;
+}
+
+bool sr_mul_const(int c, SRSeq *seq) {
+    sr_init(seq);
+    if (c == 0) {
+        sr_emit(seq, SR_MOVE, SR_DST, SR_ZERO, SR_ZERO, 0);
+        return true;
+    }
+    if (c == 1) {
+        sr_emit(seq, SR_MOVE, SR_DST, SR_SRC, SR_ZERO, 0);
+        return true;
+    }
+    if (c == -1) {
+        sr_emit(seq, SR_SUBU, SR_DST, SR_ZERO, SR_SRC, 0);
+        return true;
+    }
+
+    int shifts[33], signs[33];
+    int n = csd_digits(c, shifts, signs);
+
+    // start from the highest positive term so the sequence needs no negation
+    int first = -1;
+    for (int i = n - 1; i >= 0; i--) {
+        if (signs[i] > 0) {
+            first = i;
+            break;
+        }
+    }
+
+    enum SR_REG acc;
+    if (n == 1) {
+        if (signs[0] > 0) {
+            sr_emit(seq, SR_SLL, SR_DST, SR_SRC, SR_ZERO, shifts[0]);
+        } else {
+            sr_emit(seq, SR_SLL, SR_TMP1, SR_SRC, SR_ZERO, shifts[0]);
+            sr_emit(seq, SR_SUBU, SR_DST, SR_ZERO, SR_TMP1, 0);
+        }
+    } else {
+        int remain = n;
+        if (first >= 0) {
+            if (shifts[first] == 0) {
+                acc = SR_SRC;
+            } else {
+                sr_emit(seq, SR_SLL, SR_TMP1, SR_SRC, SR_ZERO, shifts[first]);
+                acc = SR_TMP1;
+            }
+        } else {
+            acc = SR_ZERO;
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            if (i == first) continue;
+            remain--;
+            enum SR_REG term = SR_SRC;
+            if (shifts[i] != 0) {
+                sr_emit(seq, SR_SLL, SR_TMP2, SR_SRC, SR_ZERO, shifts[i]);
+                term = SR_TMP2;
+            }
+            enum SR_REG out = (remain == (first >= 0 ? 1 : 0)) ? SR_DST : SR_TMP1;
+            sr_emit(seq, signs[i] > 0 ? SR_ADDU : SR_SUBU, out, acc, term, 0);
+            acc = SR_TMP1;
+        }
+    }
+
+    int generic = SR_COST_MUL + (fits_imm16(c) ? SR_COST_ALU : SR_COST_LI);
+    return seq->cost < generic;
+}
+
+// magic number for signed division, Hacker's Delight figure 10-1;
+// |d| must be at least 2 and not a power of two
+static void div_magic(int d, int *magic, int *shift) {
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d < 0 ? -(uint32_t)d : (uint32_t)d;
+    uint32_t t = two31 + ((uint32_t)d >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    int p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p++;
+        q1 = 2 * q1;
+        r1 = 2 * r1;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = 2 * q2;
+        r2 = 2 * r2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    uint32_t m = q2 + 1;
+    if (d < 0) m = -m;
+    *magic = (int)m;
+    *shift = p - 32;
+}
+
+bool sr_div_const(int d, SRSeq *seq) {
+    sr_init(seq);
+    if (d == 0) {
+        return false;   // leave the trap/undefined behaviour to the hardware div
+    }
+    if (d == 1) {
+        sr_emit(seq, SR_MOVE, SR_DST, SR_SRC, SR_ZERO, 0);
+        return true;
+    }
+    if (d == -1) {
+        sr_emit(seq, SR_SUBU, SR_DST, SR_ZERO, SR_SRC, 0);
+        return true;
+    }
+
+    uint32_t ad = d < 0 ? -(uint32_t)d : (uint32_t)d;
+    if ((ad & (ad - 1)) == 0) {
+        // round towards zero: bias negative dividends by |d| - 1 before the shift
+        int k = 0;
+        while ((1u << k) != ad) k++;
+        if (k == 1) {
+            sr_emit(seq, SR_SRL, SR_TMP1, SR_SRC, SR_ZERO, 31);
+        } else {
+            sr_emit(seq, SR_SRA, SR_TMP1, SR_SRC, SR_ZERO, 31);
+            sr_emit(seq, SR_SRL, SR_TMP1, SR_TMP1, SR_ZERO, 32 - k);
+        }
+        sr_emit(seq, SR_ADDU, SR_TMP1, SR_TMP1, SR_SRC, 0);
+        if (d > 0) {
+            sr_emit(seq, SR_SRA, SR_DST, SR_TMP1, SR_ZERO, k);
+        } else {
+            sr_emit(seq, SR_SRA, SR_TMP1, SR_TMP1, SR_ZERO, k);
+            sr_emit(seq, SR_SUBU, SR_DST, SR_ZERO, SR_TMP1, 0);
+        }
+    } else {
+        int magic, shift;
+        div_magic(d, &magic, &shift);
+        sr_emit(seq, SR_LI, SR_TMP1, SR_ZERO, SR_ZERO, magic);
+        sr_emit(seq, SR_MULT_HI, SR_TMP1, SR_SRC, SR_TMP1, 0);
+        if (d > 0 && magic < 0) {
+            sr_emit(seq, SR_ADDU, SR_TMP1, SR_TMP1, SR_SRC, 0);
+        } else if (d < 0 && magic > 0) {
+            sr_emit(seq, SR_SUBU, SR_TMP1, SR_TMP1, SR_SRC, 0);
+        }
+        if (shift > 0) {
+            sr_emit(seq, SR_SRA, SR_TMP1, SR_TMP1, SR_ZERO, shift);
+        }
+        // the quotient is one too small when it is negative
+        sr_emit(seq, SR_SRL, SR_TMP2, SR_TMP1, SR_ZERO, 31);
+        sr_emit(seq, SR_ADDU, SR_DST, SR_TMP1, SR_TMP2, 0);
+    }
+
+    int generic = SR_COST_DIV + (fits_imm16(d) ? SR_COST_ALU : SR_COST_LI);
+    return seq->cost < generic;
+}
+
+// reference interpreter of a lowered sequence with MIPS 32-bit semantics
+int sr_seq_eval(SRSeq *seq, int x) {
+    uint32_t regs[5] = {0};
+    regs[SR_SRC] = (uint32_t)x;
+    for (int i = 0; i < seq->len; i++) {
+        SRIns *ins = &seq->ins[i];
+        uint32_t rs = regs[ins->rs], rt = regs[ins->rt], v;
+        switch (ins->op) {
+            case SR_LI: v = (uint32_t)ins->imm; break;
+            case SR_MOVE: v = rs; break;
+            case SR_ADDU: v = rs + rt; break;
+            case SR_SUBU: v = rs - rt; break;
+            case SR_SLL: v = rs << ins->imm; break;
+            case SR_SRA: v = (uint32_t)((int32_t)rs >> ins->imm); break;
+            case SR_SRL: v = rs >> ins->imm; break;
+            case SR_MULT_HI: v = (uint32_t)(((int64_t)(int32_t)rs * (int32_t)rt) >> 32); break;
+            default: assert(0);
+        }
+        if (ins->rd != SR_ZERO) regs[ins->rd] = v;
+    }
+    return (int)regs[SR_DST];
+}
@@ -0,0 +1,222 @@
+#include "timer.h"
+#include "memstat.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_NUM };
+static const char *perf_names[PERF_NUM] = { "cycles", "instructions", "cache_misses" };
+
+typedef struct {
+    double wall, cpu;       // seconds
+    long long allocs, bytes;
+    uint64_t perf[PERF_NUM];
+} Sample;
+
+typedef struct {
+    const char *name;
+    int parent, depth;
+    long long calls;
+    Sample total;
+} Phase;
+
+static bool started;
+static int perf_fd = -1;
+static Phase phases[TIMER_MAX_PHASES];
+static int num_phases;
+static int stack[TIMER_MAX_DEPTH];
+static Sample stack_start[TIMER_MAX_DEPTH];
+static int depth;
+static Sample run_start;
+static bool overflow;       // phases beyond TIMER_MAX_PHASES / TIMER_MAX_DEPTH were dropped
+
+static double seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void perf_open() {
+#ifdef __linux__
+    uint64_t configs[PERF_NUM] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < PERF_NUM; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : perf_fd, 0);
+        if (fd < 0) {
+            // not permitted or no PMU: report without hardware counters
+            if (perf_fd >= 0) close(perf_fd);
+            perf_fd = -1;
+            return;
+        }
+        if (i == 0) perf_fd = fd;
+    }
+    ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void sample(Sample *s) {
+    s->wall = seconds(CLOCK_MONOTONIC);
+    s->cpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+    mem_allocations(&s->allocs, &s->bytes);
+    memset(s->perf, 0, sizeof(s->perf));
+    if (perf_fd >= 0) {
+        uint64_t buf[1 + PERF_NUM];
+        if (read(perf_fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf)) {
+            memcpy(s->perf, buf + 1, sizeof(s->perf));
+        }
+    }
+}
+
+static void add_delta(Sample *total, const Sample *from, const Sample *to) {
+    total->wall += to->wall - from->wall;
+    total->cpu += to->cpu - from->cpu;
+    total->allocs += to->allocs - from->allocs;
+    total->bytes += to->bytes - from->bytes;
+    for (int i = 0; i < PERF_NUM; i++) total->perf[i] += to->perf[i] - from->perf[i];
+}
+
+void timer_start() {
+    started = true;
+    perf_open();
+    sample(&run_start);
+}
+
+void timer_begin(const char *name) {
+    if (!started) return;
+    if (depth == TIMER_MAX_DEPTH) {
+        overflow = true;
+        depth++;
+        return;
+    }
+    if (depth > TIMER_MAX_DEPTH) {
+        depth++;
+        return;
+    }
+    int parent = depth == 0 ? -1 : stack[depth - 1];
+    int i = 0;
+    while (i < num_phases && !(phases[i].parent == parent && strcmp(phases[i].name, name) == 0)) i++;
+    if (i == num_phases) {
+        if (num_phases == TIMER_MAX_PHASES) {
+            overflow = true;
+            i = -1;
+        } else {
+            phases[num_phases++] = (Phase){ .name = name, .parent = parent, .depth = depth };
+        }
+    }
+    stack[depth] = i;
+    sample(&stack_start[depth]);
+    depth++;
+}
+
+void timer_end() {
+    if (!started || depth == 0) return;
+    depth--;
+    if (depth >= TIMER_MAX_DEPTH || stack[depth] < 0) return;
+    Sample now;
+    sample(&now);
+    Phase *p = &phases[stack[depth]];
+    p->calls++;
+    add_delta(&p->total, &stack_start[depth], &now);
+}
+
+static void run_total(Sample *total) {
+    Sample now;
+    sample(&now);
+    memset(total, 0, sizeof(*total));
+    add_delta(total, &run_start, &now);
+}
+
+// phases in depth-first order, each after its parent
+static int ordered(int *order) {
+    int n = 0;
+    int todo[TIMER_MAX_PHASES], top = 0;
+    for (int i = num_phases - 1; i >= 0; i--) {
+        if (phases[i].parent == -1) todo[top++] = i;
+    }
+    while (top > 0) {
+        int p = todo[--top];
+        order[n++] = p;
+        for (int i = num_phases - 1; i >= 0; i--) {
+            if (phases[i].parent == p) todo[top++] = i;
+        }
+    }
+    return n;
+}
+
+static void print_row(FILE *out, const char *name, int indent, long long calls, const Sample *s) {
+    fprintf(out, "%*s%-*s %8lld %10.2f %10.2f %10lld %10.1f", 2 * indent, "", 28 - 2 * indent, name,
+        calls, s->wall * 1e3, s->cpu * 1e3, s->allocs, s->bytes / 1024.0);
+    if (perf_fd >= 0) {
+        for (int i = 0; i < PERF_NUM; i++) fprintf(out, " %14llu", (unsigned long long)s->perf[i]);
+    }
+    fprintf(out, "\n");
+}
+
+void timer_report(FILE *out) {
+    if (!started) return;
+    Sample total;
+    run_total(&total);
+    fprintf(out, "%-28s %8s %10s %10s %10s %10s", "phase", "calls", "wall ms", "cpu ms", "allocs", "alloc KB");
+    if (perf_fd >= 0) {
+        for (int i = 0; i < PERF_NUM; i++) fprintf(out, " %14s", perf_names[i]);
+    }
+    fprintf(out, "\n");
+    int order[TIMER_MAX_PHASES];
+    int n = ordered(order);
+    for (int i = 0; i < n; i++) {
+        Phase *p = &phases[order[i]];
+        print_row(out, p->name, p->depth, p->calls, &p->total);
+    }
+    print_row(out, "total", 0, 1, &total);
+    if (perf_fd < 0) fprintf(out, "(hardware counters not available)\n");
+    if (overflow) fprintf(out, "(phases nested too deep or too many phases, some were not recorded)\n");
+}
+
+static void print_json_sample(FILE *out, const Sample *s) {
+    fprintf(out, "\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"allocs\": %lld, \"alloc_bytes\": %lld",
+        s->wall * 1e3, s->cpu * 1e3, s->allocs, s->bytes);
+    if (perf_fd >= 0) {
+        for (int i = 0; i < PERF_NUM; i++) fprintf(out, ", \"%s\": %llu", perf_names[i], (unsigned long long)s->perf[i]);
+    }
+}
+
+void timer_report_json(FILE *out) {
+    if (!started) return;
+    Sample total;
+    run_total(&total);
+    fprintf(out, "{\"hardware_counters\": %s, \"total\": {", perf_fd >= 0 ? "true" : "false");
+    print_json_sample(out, &total);
+    fprintf(out, "}, \"phases\": [");
+    int order[TIMER_MAX_PHASES];
+    int n = ordered(order);
+    for (int i = 0; i < n; i++) {
+        Phase *p = &phases[order[i]];
+        // names are fixed strings in the source, no escaping needed
+        fprintf(out, "%s\n  {\"name\": \"%s\", \"parent\": ", i > 0 ? "," : "", p->name);
+        if (p->parent < 0) {
+            fprintf(out, "null");
+        } else {
+            fprintf(out, "\"%s\"", phases[p->parent].name);
+        }
+        fprintf(out, ", \"depth\": %d, \"calls\": %lld, ", p->depth, p->calls);
+        print_json_sample(out, &p->total);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]}\n");
+}
@@ -0,0 +1,85 @@
+// Checks that the flat profile of run_ir attributes every instruction the
+// run counts: its total must equal InterpStats.instructions.
+//
+// usage: interp_profile_test
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interp.h"
+
+static int failures = 0;
+
+static void expect_same_total(const char *name, const char *ir, const char *input) {
+    FILE *in = fmemopen((void *)ir, strlen(ir), "r");
+    IrProgram *prog = interp_load(in, name);
+    fclose(in);
+    if (prog == NULL) {
+        failures++;
+        printf("FAIL: %s does not load\n", name);
+        return;
+    }
+    interp_profile(prog);
+    FILE *input_file = fmemopen((void *)input, strlen(input), "r");
+    FILE *output = fopen("/dev/null", "w");
+    InterpStats stats;
+    interp_run(prog, input_file, output, &stats);
+    fclose(input_file);
+    fclose(output);
+
+    char *report;
+    size_t len;
+    FILE *out = open_memstream(&report, &len);
+    interp_report_profile(prog, out, 0);
+    fclose(out);
+    long long total = -1;
+    sscanf(report, "flat profile: %lld instructions", &total);
+    if (total != stats.instructions) {
+        failures++;
+        printf("FAIL: %s: flat profile %lld, executed %lld\n", name, total, stats.instructions);
+    }
+    free(report);
+    interp_free(prog);
+}
+
+int main() {
+    expect_same_total("straight line",
+        "FUNCTION main :\n"
+        "a := #1\n"
+        "WRITE a\n"
+        "RETURN #0\n", "");
+
+    // a loop, with a label reached both by falling through and by jumps
+    expect_same_total("loop",
+        "FUNCTION main :\n"
+        "READ n\n"
+        "i := #0\n"
+        "LABEL l1 :\n"
+        "IF i >= n GOTO l2\n"
+        "i := i + #1\n"
+        "GOTO l1\n"
+        "LABEL l2 :\n"
+        "WRITE i\n"
+        "RETURN #0\n", "10\n");
+
+    // calls, recursion and a function defined before main
+    expect_same_total("recursion",
+        "FUNCTION fact :\n"
+        "PARAM n\n"
+        "IF n > #1 GOTO l1\n"
+        "RETURN #1\n"
+        "LABEL l1 :\n"
+        "m := n - #1\n"
+        "ARG m\n"
+        "r := CALL fact\n"
+        "s := n * r\n"
+        "RETURN s\n"
+        "FUNCTION main :\n"
+        "READ n\n"
+        "ARG n\n"
+        "r := CALL fact\n"
+        "WRITE r\n"
+        "RETURN #0\n", "6\n");
+
+    if (failures == 0) printf("interp profile: totals agree\n");
+    return failures != 0;
+}
@@ -0,0 +1,97 @@
+// Checks each peephole rule on a small hand-written instruction sequence.
+//
+// usage: peephole_test
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mips.h"
+
+static int failures = 0;
+
+static void expect(const char *name, const char *want) {
+    char *got;
+    size_t len;
+    FILE *out = open_memstream(&got, &len);
+    mips_peephole();
+    mips_flush(out);
+    fclose(out);
+    if (strcmp(got, want) != 0) {
+        failures++;
+        printf("FAIL: %s\n--- want\n%s--- got\n%s", name, want, got);
+    }
+    free(got);
+}
+
+#define T(n) (MR_T0 + (n))
+
+int main() {
+    // the spill of $t0 is read back right away
+    mips_emit_label(MI_ENTRY, "f");
+    mips_rrr(MI_ADD, T(0), MR_A0, MR_A0);
+    mips_mem(MI_SW, T(0), -8, MR_FP);
+    mips_mem(MI_LW, T(1), -8, MR_FP);
+    mips_rr(MI_MOVE, MR_V0, T(1));
+    mips_r(MI_JR, MR_RA);
+    expect("store then load",
+        "\nf:\n  add $t0, $a0, $a0\n  sw $t0, -8($fp)\n  move $v0, $t0\n  jr $ra\n");
+
+    // a copy chain collapses into the instruction that computes the value
+    mips_emit_label(MI_ENTRY, "f");
+    mips_ri(MI_LI, T(0), 3);
+    mips_rr(MI_MOVE, T(1), T(0));
+    mips_rr(MI_MOVE, MR_V0, T(1));
+    mips_r(MI_JR, MR_RA);
+    expect("move chain", "\nf:\n  li $v0, 3\n  jr $ra\n");
+
+    // the second li of the same constant is dropped
+    mips_emit_label(MI_ENTRY, "f");
+    mips_ri(MI_LI, T(7), 1);
+    mips_rrr(MI_ADD, MR_S0, MR_S0, T(7));
+    mips_ri(MI_LI, T(7), 1);
+    mips_rrr(MI_ADD, MR_S0 + 1, MR_S0 + 1, T(7));
+    mips_r(MI_JR, MR_RA);
+    expect("repeated li",
+        "\nf:\n  li $t7, 1\n  add $s0, $s0, $t7\n  add $s1, $s1, $t7\n  jr $ra\n");
+
+    // a branch over a jump is inverted
+    mips_emit_label(MI_ENTRY, "f");
+    mips_emit(MI_BLT, MR_A0, MR_A0 + 1, 0, 0, "label2");
+    mips_emit_label(MI_J, "label3");
+    mips_emit_label(MI_LABEL, "label2");
+    mips_rr(MI_MOVE, MR_V0, MR_A0);
+    mips_emit_label(MI_LABEL, "label3");
+    mips_r(MI_JR, MR_RA);
+    expect("branch over jump",
+        "\nf:\n  bge $a0, $a1, label3\nlabel2:\n  move $v0, $a0\nlabel3:\n  jr $ra\n");
+
+    // stack adjustments are merged, and cancel out here
+    mips_emit_label(MI_ENTRY, "f");
+    mips_rri(MI_ADDI, MR_SP, MR_SP, -4);
+    mips_rri(MI_ADDI, MR_SP, MR_SP, -4);
+    mips_rri(MI_ADDI, MR_SP, MR_SP, 8);
+    mips_r(MI_JR, MR_RA);
+    expect("stack adjustments", "\nf:\n  jr $ra\n");
+
+    // wrapping adds are merged with each other, not with trapping ones
+    mips_emit_label(MI_ENTRY, "f");
+    mips_rri(MI_ADDIU, MR_V0, MR_V0, 7);
+    mips_rri(MI_ADDIU, MR_V0, MR_V0, -3);
+    mips_rri(MI_ADDI, MR_V0, MR_V0, 1);
+    mips_r(MI_JR, MR_RA);
+    expect("wrapping adds", "\nf:\n  addiu $v0, $v0, 4\n  addi $v0, $v0, 1\n  jr $ra\n");
+
+    // a value live around a loop is kept
+    mips_emit_label(MI_ENTRY, "f");
+    mips_ri(MI_LI, T(0), 0);
+    mips_emit_label(MI_LABEL, "label1");
+    mips_rri(MI_ADDI, T(0), T(0), 1);
+    mips_emit(MI_BLT, T(0), MR_A0, 0, 0, "label1");
+    mips_rr(MI_MOVE, MR_V0, T(0));
+    mips_r(MI_JR, MR_RA);
+    expect("loop",
+        "\nf:\n  li $t0, 0\nlabel1:\n  addi $t0, $t0, 1\n  blt $t0, $a0, label1\n"
+        "  move $v0, $t0\n  jr $ra\n");
+
+    if (failures == 0) printf("peephole: all rules ok\n");
+    return failures != 0;
+}
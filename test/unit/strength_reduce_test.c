@@ -0,0 +1,114 @@
+// Randomized check of the constant multiply/divide lowering against C
+// reference semantics (wrapping multiply, truncating division).
+//
+// usage: strength_reduce_test [seed]
+//        strength_reduce_test --exhaustive constant   (all 2^32 dividends)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include "strength_reduce.h"
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint32_t rng() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)rng_state;
+}
+
+static int ref_mul(int x, int c) {
+    return (int)((uint32_t)x * (uint32_t)c);
+}
+
+static int ref_div(int x, int d) {
+    if (x == INT_MIN && d == -1) return INT_MIN;   // wraps on MIPS
+    return x / d;
+}
+
+static int failures = 0;
+
+static void check(int c, int x) {
+    SRSeq seq;
+    sr_mul_const(c, &seq);
+    int got = sr_seq_eval(&seq, x);
+    if (got != ref_mul(x, c)) {
+        if (failures++ < 20)
+            printf("FAIL: %d * %d = %d, lowered to %d\n", x, c, ref_mul(x, c), got);
+    }
+    if (c != 0 && sr_div_const(c, &seq)) {
+        got = sr_seq_eval(&seq, x);
+        if (got != ref_div(x, c)) {
+            if (failures++ < 20)
+                printf("FAIL: %d / %d = %d, lowered to %d\n", x, c, ref_div(x, c), got);
+        }
+    }
+}
+
+static void check_constant(int c, int samples) {
+    static const int edges[] = {
+        0, 1, -1, 2, -2, 3, -3, 7, -7, 100, -100,
+        INT_MAX, INT_MAX - 1, INT_MIN, INT_MIN + 1, INT_MAX / 2, INT_MIN / 2
+    };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        check(c, edges[i]);
+    }
+    // dividends around multiples of the divisor, where rounding goes wrong
+    for (int k = -3; k <= 3; k++) {
+        int64_t m = (int64_t)c * k;
+        for (int64_t x = m - 1; x <= m + 1; x++) {
+            if (x >= INT_MIN && x <= INT_MAX) check(c, (int)x);
+        }
+        m = (c != 0) ? ((int64_t)INT_MAX / c) * c : 0;
+        check(c, (int)m);
+        check(c, (int)-m);
+    }
+    for (int i = 0; i < samples; i++) {
+        check(c, (int)rng());
+        check(c, (int)(rng() >> (rng() % 32)));
+    }
+}
+
+static void run_exhaustive(int c) {
+    SRSeq mul, div;
+    sr_mul_const(c, &mul);
+    bool has_div = c != 0 && sr_div_const(c, &div);
+    uint32_t x = 0;
+    do {
+        if (sr_seq_eval(&mul, (int)x) != ref_mul((int)x, c)) failures++;
+        if (has_div && sr_seq_eval(&div, (int)x) != ref_div((int)x, c)) failures++;
+    } while (++x != 0);
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--exhaustive") == 0) {
+        int c = atoi(argv[2]);
+        run_exhaustive(c);
+        printf("%s: exhaustive check of constant %d\n", failures ? "FAIL" : "pass", c);
+        return failures != 0;
+    }
+    if (argc == 2) {
+        rng_state = strtoull(argv[1], NULL, 10) | 1;
+    }
+
+    for (int c = -1100; c <= 1100; c++) {
+        check_constant(c, 200);
+    }
+    for (int k = 0; k < 31; k++) {
+        for (int delta = -1; delta <= 1; delta++) {
+            check_constant((1 << k) + delta, 500);
+            check_constant(-(1 << k) + delta, 500);
+        }
+    }
+    check_constant(INT_MIN, 2000);
+    check_constant(INT_MAX, 2000);
+    for (int i = 0; i < 3000; i++) {
+        check_constant((int)rng(), 200);
+        check_constant((int)(rng() >> (rng() % 32)), 200);
+    }
+
+    printf("%s: strength reduction (%d failures)\n", failures ? "FAIL" : "pass", failures);
+    return failures != 0;
+}